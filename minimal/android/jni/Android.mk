@@ -28,10 +28,16 @@ LOCAL_PATH := $(call my-dir)
 include $(CLEAR_VARS)
 
 LOCAL_MODULE    := minimal-vulkan
-LOCAL_SRC_FILES := main.c vk_minimal.c vulkan_dlfcn/vulkan_dlfcn.c
+LOCAL_SRC_FILES := main.c vk_minimal.c vk_minimal_alloc.c vk_minimal_batch.c vk_minimal_capture.c vk_minimal_damage.c vk_minimal_fill.c vk_minimal_pool.c vk_minimal_prof.c vk_minimal_render.c vulkan_dlfcn/vulkan_dlfcn.c
 LOCAL_LDLIBS    := -llog -landroid
 LOCAL_STATIC_LIBRARIES := android_native_app_glue
 
 include $(BUILD_SHARED_LIBRARY)
 
+# Embedded SPIR-V for the compute grid, regenerated when the shader changes
+$(LOCAL_PATH)/vk_minimal_grid.comp.h: $(LOCAL_PATH)/vk_minimal_grid.comp
+	glslangValidator -V --vn vk_minimal_grid_comp $< -o $@
+
+$(LOCAL_PATH)/vk_minimal.c: $(LOCAL_PATH)/vk_minimal_grid.comp.h
+
 $(call import-module,android/native_app_glue)
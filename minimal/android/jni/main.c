@@ -26,22 +26,220 @@ For more information, please refer to <http://unlicense.org>
 */
 
 #include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if __ANDROID__
 
 #include <android/log.h>
 #include <android/window.h>
 #include <android_native_app_glue.h>
 
-#include "vulkan_dlfcn/vulkan_dlfcn.h"
-#include "vk_minimal.h"
-
 #define LOG_TAG "minimal_vulkan"
 
 #define LOGI(...) ((void)__android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__))
 #define LOGW(...) ((void)__android_log_print(ANDROID_LOG_WARN, LOG_TAG, __VA_ARGS__))
 
+#else
 
-static void handle_cmd(struct android_app* app, int32_t cmd)
+#include <stdio.h>
+#include <time.h>
+
+#define LOGI(...) ((void)printf(__VA_ARGS__))
+#define LOGW(...) ((void)printf(__VA_ARGS__))
+
+#endif
+
+#include "vulkan_dlfcn/vulkan_dlfcn.h"
+#include "vk_minimal.h"
+#include "vk_minimal_render.h"
+#include "soloader.h"
+
+// Longest frame() waits, a new build is looked for between two frames
+#define FRAME_WAIT_MS 100
+
+// Owned by the event thread and kept across reloads. The instance, device
+// and surface outlive every copy of the module. The context is set up by
+// each copy's load() and initialized by its render thread, as the fill
+// workers and the capture writer it starts run the copy's code.
+struct app_state {
+	// NULL on the host, which renders offscreen
+	struct android_app *app;
+	VkInstance instance;
+	VkSurfaceKHR surface;
+	// Created with the first surface, there is nothing to present to before
+	struct vk_minimal_device dev;
+	VkBool32 has_dev;
+
+	// What the render thread was told, told again to the next copy's
+	VkBool32 has_target;
+	VkExtent2D extent;
+	VkBool32 paused;
+
+	struct vk_minimal_context actx;
+	struct vk_minimal_render render;
+};
+
+static void send_op(struct app_state *st, enum vk_minimal_render_op op)
+{
+	struct vk_minimal_render_cmd cmd;
+	memset(&cmd, 0, sizeof(cmd));
+	cmd.op = op;
+	vk_minimal_render_send(&st->render, cmd);
+}
+
+static void send_target(struct app_state *st)
+{
+	struct vk_minimal_render_cmd cmd;
+	memset(&cmd, 0, sizeof(cmd));
+
+	if (st->extent.width && st->extent.height)
+	{
+		cmd.op = VK_MINIMAL_RENDER_RESIZE;
+		cmd.extent = st->extent;
+		vk_minimal_render_send(&st->render, cmd);
+	}
+	cmd.op = VK_MINIMAL_RENDER_SURFACE_CREATED;
+	cmd.surface = st->surface;
+	vk_minimal_render_send(&st->render, cmd);
+}
+
+static void log_stats(struct app_state *st)
+{
+	uint64_t count = atomic_load(&st->render.stats.latency_count);
+
+	LOGI("%llu frames, input to present %.3f ms (avg %.3f ms, max %.3f ms)\n",
+	     (unsigned long long)atomic_load(&st->render.stats.frames),
+	     atomic_load(&st->render.stats.latency_ns) * 1e-6,
+	     count ? atomic_load(&st->render.stats.latency_total_ns) * 1e-6 / count : 0.0,
+	     atomic_load(&st->render.stats.latency_max_ns) * 1e-6);
+}
+
+static void *create(void *app)
+{
+	struct app_state *st = calloc(1, sizeof(*st));
+	assert(st);
+	st->app = app;
+
+	// Load libvulkan.so, load() does it again for every later copy
+	vulkan_dlfcn_init();
+
+#if __ANDROID__
+	// Turns out that this is quite essential to make the swapchain work properly
+	ANativeActivity_setWindowFlags(st->app->activity, AWINDOW_FLAG_FULLSCREEN, 0);
+#endif
+
+	VkResult err;
+	VkApplicationInfo app_info;
+	app_info.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+	app_info.pNext = NULL;
+	app_info.pApplicationName = NULL;
+	app_info.applicationVersion = 0;
+	app_info.pEngineName = NULL;
+	app_info.engineVersion = 0;
+	app_info.apiVersion = VK_MAKE_VERSION (1,0,2);
+
+#if __ANDROID__
+	const char *iextensions[] = {
+	  "VK_KHR_surface",
+	  "VK_KHR_android_surface"
+	};
+#endif
+
+	VkInstanceCreateInfo inst_info;
+	memset(&inst_info, 0, sizeof(inst_info));
+	inst_info.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+	inst_info.pNext = NULL;
+	inst_info.pApplicationInfo = &app_info;
+	inst_info.enabledLayerCount = 0;
+	inst_info.ppEnabledLayerNames = NULL;
+#if __ANDROID__
+	inst_info.enabledExtensionCount = sizeof(iextensions)/sizeof(iextensions[0]);
+	inst_info.ppEnabledExtensionNames = iextensions;
+#endif
+
+	err = vkCreateInstance(&inst_info, NULL, &st->instance);
+	assert(err == VK_SUCCESS);
+
+	// Without a window the host draws into offscreen images from the start
+	if (!st->app)
+	{
+		vk_minimal_device_init(&st->dev, st->instance, VK_NULL_HANDLE, 0, VK_FALSE, VK_FALSE);
+		st->has_dev = VK_TRUE;
+		st->has_target = VK_TRUE;
+	}
+	return st;
+}
+
+static void destroy(void *p)
+{
+	struct app_state *st = p;
+
+	if (st->has_dev)
+		vk_minimal_device_destroy(&st->dev);
+	if (st->surface != VK_NULL_HANDLE)
+		vkDestroySurfaceKHR(st->instance, st->surface, NULL);
+	vkDestroyInstance(st->instance, NULL);
+	free(st);
+}
+
+static void load(void *p)
 {
+	struct app_state *st = p;
+
+	// This copy's globals start out empty, the device has tables of its own
+	vulkan_dlfcn_init();
+
+	memset(&st->actx, 0, sizeof(st->actx));
+	st->actx.instance = st->instance;
+	// Used once the first surface created the device
+	st->actx.dev = &st->dev;
+
+	// Draws continuously once it has a target, picking up where the render
+	// thread of the previous copy stopped
+	vk_minimal_render_start(&st->render, &st->actx);
+	if (st->paused)
+		send_op(st, VK_MINIMAL_RENDER_PAUSE);
+	if (st->has_target)
+		send_target(st);
+}
+
+static void unload(void *p)
+{
+	struct app_state *st = p;
+
+	log_stats(st);
+	// Destroys the swapchain, canvases and threads with the context, the
+	// device and surface stay
+	vk_minimal_render_stop(&st->render);
+}
+
+static int frame(void *p)
+{
+	struct app_state *st = p;
+
+	// Frames come from the render thread. This waits for the next event
+	// without taking it, the loop that called it handles the event.
+#if __ANDROID__
+	(void)st;
+	ALooper_pollOnce(FRAME_WAIT_MS, NULL, NULL, NULL);
+#else
+	const struct timespec ts = {0, FRAME_WAIT_MS * 1000000};
+	(void)st;
+	nanosleep(&ts, NULL);
+#endif
+	return 1;
+}
+
+#if __ANDROID__
+
+static void app_cmd(void *p, int32_t cmd)
+{
+	struct app_state *st = p;
+	struct android_app *app = st->app;
+	struct vk_minimal_render_cmd rcmd;
+	memset(&rcmd, 0, sizeof(rcmd));
+
 	switch (cmd)
 	{
 		case APP_CMD_SAVE_STATE:
@@ -51,22 +249,54 @@ static void handle_cmd(struct android_app* app, int32_t cmd)
 		if (app->window != NULL)
 		{
 			VkResult err;
-			struct vk_minimal_context *actx = app->userData;
 			VkAndroidSurfaceCreateInfoKHR asci;
 			asci.sType = VK_STRUCTURE_TYPE_ANDROID_SURFACE_CREATE_INFO_KHR;
 			asci.pNext = NULL;
 			asci.flags = 0;
 			asci.window = app->window;
 
-			VkSurfaceKHR surface;
-			err = vkCreateAndroidSurfaceKHR(actx->instance, &asci, NULL, &actx->surface);
+			err = vkCreateAndroidSurfaceKHR(st->instance, &asci, NULL, &st->surface);
 			assert(err == VK_SUCCESS);
 
-			vk_minimal_init(actx);
+			if (!st->has_dev)
+			{
+				vk_minimal_device_init(&st->dev, st->instance, st->surface, 0, VK_FALSE, VK_FALSE);
+				st->has_dev = VK_TRUE;
+			}
+			st->has_target = VK_TRUE;
+			send_target(st);
 		}
 		break;
 		case APP_CMD_TERM_WINDOW:
-		// The window is being hidden or closed, clean it up.
+		// The window is being hidden or closed, clean it up. The window is
+		// gone once this returns so the swapchain has to go first.
+		if (st->surface != VK_NULL_HANDLE)
+		{
+			rcmd.op = VK_MINIMAL_RENDER_SURFACE_LOST;
+			vk_minimal_render_send_sync(&st->render, rcmd);
+			vkDestroySurfaceKHR(st->instance, st->surface, NULL);
+			st->surface = VK_NULL_HANDLE;
+			st->has_target = VK_FALSE;
+		}
+		break;
+		case APP_CMD_WINDOW_RESIZED:
+		case APP_CMD_CONFIG_CHANGED:
+		if (app->window != NULL)
+		{
+			st->extent.width = ANativeWindow_getWidth(app->window);
+			st->extent.height = ANativeWindow_getHeight(app->window);
+			rcmd.op = VK_MINIMAL_RENDER_RESIZE;
+			rcmd.extent = st->extent;
+			vk_minimal_render_send(&st->render, rcmd);
+		}
+		break;
+		case APP_CMD_RESUME:
+		st->paused = VK_FALSE;
+		send_op(st, VK_MINIMAL_RENDER_RESUME);
+		break;
+		case APP_CMD_PAUSE:
+		st->paused = VK_TRUE;
+		send_op(st, VK_MINIMAL_RENDER_PAUSE);
 		break;
 		case APP_CMD_GAINED_FOCUS:
 		// Start animation
@@ -77,55 +307,64 @@ static void handle_cmd(struct android_app* app, int32_t cmd)
 	}
 }
 
-void android_main(struct android_app* state)
+static int32_t input(void *p, void *event)
 {
-	// Make sure glue isn't stripped.
-	app_dummy();
+	struct app_state *st = p;
 
-	// Load libvulkan.so
-	vulkan_dlfcn_init();
-
-	// Turns out that this is quite essential to make the swapchain work properly
-	ANativeActivity_setWindowFlags(state->activity, AWINDOW_FLAG_FULLSCREEN, 0);
+	// Stands in for input that changes what is drawn, times it to the screen
+	if (AInputEvent_getType(event) == AINPUT_EVENT_TYPE_MOTION)
+	{
+		send_op(st, VK_MINIMAL_RENDER_REDRAW);
+		return 1;
+	}
+	return 0;
+}
 
-	struct vk_minimal_context actx;
-	memset(&actx, 0, sizeof(actx));
+#endif
 
-	state->userData = &actx;
+static const struct soloader_module module = {
+	.version = SOLOADER_VERSION,
+	.create = create,
+	.destroy = destroy,
+	.unload = unload,
+	.load = load,
+	.frame = frame,
+#if __ANDROID__
+	.app_cmd = app_cmd,
+	.input = input,
+#endif
+};
 
-	VkResult err;
-	VkApplicationInfo app;
-	app.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
-	app.pNext = NULL;
-	app.pApplicationName = NULL;
-	app.applicationVersion = 0;
-	app.pEngineName = NULL;
-	app.engineVersion = 0;
-	app.apiVersion = VK_MAKE_VERSION (1,0,2);
+// Swapped in between two frames by the loader whenever it is rebuilt
+const struct soloader_module *soloader_get_module(void)
+{
+	return &module;
+}
 
-	const char *iextensions[] = {
-	  "VK_KHR_surface",
-	  "VK_KHR_android_surface"
-	};
+#if __ANDROID__
 
-	VkInstanceCreateInfo inst_info;
-	memset(&inst_info, 0, sizeof(inst_info));
-	inst_info.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
-	inst_info.pNext = NULL;
-	inst_info.pApplicationInfo = &app;
-	inst_info.enabledLayerCount = 0;
-	inst_info.ppEnabledLayerNames = NULL;
-	inst_info.enabledExtensionCount = sizeof(iextensions)/sizeof(iextensions[0]);
-	inst_info.ppEnabledExtensionNames = iextensions;
+static void handle_cmd(struct android_app* app, int32_t cmd)
+{
+	app_cmd(app->userData, cmd);
+}
 
-	err = vkCreateInstance(&inst_info, NULL, &actx.instance);
-	assert(err == VK_SUCCESS);
+static int32_t handle_input(struct android_app* app, AInputEvent* event)
+{
+	return input(app->userData, event);
+}
 
-	if (state->savedState != NULL)
-	{
-	}
+// Started on its own rather than by the loader, runs the module without
+// reloads
+void android_main(struct android_app* state)
+{
+	// Make sure glue isn't stripped.
+	app_dummy();
 
+	void *st = create(state);
+	load(st);
+	state->userData = st;
 	state->onAppCmd = handle_cmd;
+	state->onInputEvent = handle_input;
 
 	while (1)
 	{
@@ -133,7 +372,7 @@ void android_main(struct android_app* state)
 		int events;
 		struct android_poll_source* source;
 
-		while ((ident=ALooper_pollAll(0, NULL, &events, (void**)&source)) != ALOOPER_POLL_ERROR)
+		while ((ident=ALooper_pollAll(0, NULL, &events, (void**)&source)) >= 0)
 		{
 			if (source != NULL)
 			{
@@ -142,13 +381,18 @@ void android_main(struct android_app* state)
 
 			if (state->destroyRequested != 0)
 			{
-				return;
-			}
-
-			if (actx.device != VK_NULL_HANDLE)
-			{
-				vk_minimal_draw(&actx);
+				break;
 			}
 		}
+
+		if (state->destroyRequested != 0 || !frame(st))
+			break;
 	}
+
+	unload(st);
+	destroy(st);
+	state->onAppCmd = NULL;
+	state->onInputEvent = NULL;
 }
+
+#endif
@@ -0,0 +1 @@
+../../../soloader/jni/soloader.h
\ No newline at end of file
@@ -0,0 +1 @@
+../../vk_minimal_alloc.c
\ No newline at end of file
@@ -0,0 +1 @@
+../../vk_minimal_alloc.h
\ No newline at end of file
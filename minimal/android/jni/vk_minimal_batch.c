@@ -0,0 +1 @@
+../../vk_minimal_batch.c
\ No newline at end of file
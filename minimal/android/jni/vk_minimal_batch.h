@@ -0,0 +1 @@
+../../vk_minimal_batch.h
\ No newline at end of file
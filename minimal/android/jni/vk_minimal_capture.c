@@ -0,0 +1 @@
+../../vk_minimal_capture.c
\ No newline at end of file
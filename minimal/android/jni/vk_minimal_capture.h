@@ -0,0 +1 @@
+../../vk_minimal_capture.h
\ No newline at end of file
@@ -0,0 +1 @@
+../../vk_minimal_damage.c
\ No newline at end of file
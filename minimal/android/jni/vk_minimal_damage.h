@@ -0,0 +1 @@
+../../vk_minimal_damage.h
\ No newline at end of file
@@ -0,0 +1 @@
+../../vk_minimal_fill.c
\ No newline at end of file
@@ -0,0 +1 @@
+../../vk_minimal_fill.h
\ No newline at end of file
@@ -0,0 +1 @@
+../../vk_minimal_pool.c
\ No newline at end of file
@@ -0,0 +1 @@
+../../vk_minimal_pool.h
\ No newline at end of file
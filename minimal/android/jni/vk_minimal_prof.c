@@ -0,0 +1 @@
+../../vk_minimal_prof.c
\ No newline at end of file
@@ -0,0 +1 @@
+../../vk_minimal_prof.h
\ No newline at end of file
@@ -0,0 +1 @@
+../../vk_minimal_render.c
\ No newline at end of file
@@ -0,0 +1 @@
+../../vk_minimal_render.h
\ No newline at end of file
@@ -0,0 +1,285 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "vulkan_dlfcn/vulkan_dlfcn.h"
+#include "vk_minimal_alloc.h"
+
+#define LOGI(...) ((void)printf(__VA_ARGS__))
+
+// Checks the sub-allocator and the arenas on the host, with device memory
+// stood in for by malloc(), then times allocating and freeing. No Vulkan
+// driver is loaded.
+
+#define GRANULARITY 4096
+#define ATOM_SIZE 64
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static uint32_t next(uint32_t *seed)
+{
+	*seed = *seed * 1664525u + 1013904223u;
+	return *seed >> 8;
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL fake_allocate(VkDevice device, const VkMemoryAllocateInfo *mai, const VkAllocationCallbacks *cb, VkDeviceMemory *memory)
+{
+	(void)device;
+	(void)cb;
+	void *data = malloc(mai->allocationSize);
+	if (!data)
+		return VK_ERROR_OUT_OF_HOST_MEMORY;
+	*memory = (VkDeviceMemory)(uintptr_t)data;
+	return VK_SUCCESS;
+}
+
+static VKAPI_ATTR void VKAPI_CALL fake_free(VkDevice device, VkDeviceMemory memory, const VkAllocationCallbacks *cb)
+{
+	(void)device;
+	(void)cb;
+	free((void *)(uintptr_t)memory);
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL fake_map(VkDevice device, VkDeviceMemory memory, VkDeviceSize offset, VkDeviceSize size, VkMemoryMapFlags flags, void **data)
+{
+	(void)device;
+	(void)size;
+	(void)flags;
+	*data = (uint8_t *)(uintptr_t)memory + offset;
+	return VK_SUCCESS;
+}
+
+static VKAPI_ATTR void VKAPI_CALL fake_unmap(VkDevice device, VkDeviceMemory memory)
+{
+	(void)device;
+	(void)memory;
+}
+
+static void init_allocator(struct vk_minimal_allocator *a, struct vulkan_dlfcn_device *vkd)
+{
+	VkPhysicalDeviceMemoryProperties props;
+	VkPhysicalDeviceLimits limits;
+
+	memset(vkd, 0, sizeof(*vkd));
+	vkd->vkAllocateMemory = fake_allocate;
+	vkd->vkFreeMemory = fake_free;
+	vkd->vkMapMemory = fake_map;
+	vkd->vkUnmapMemory = fake_unmap;
+
+	memset(&props, 0, sizeof(props));
+	props.memoryTypeCount = 1;
+	props.memoryTypes[0].propertyFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	props.memoryTypes[0].heapIndex = 0;
+	props.memoryHeapCount = 1;
+	props.memoryHeaps[0].size = 1ull << 30;
+
+	memset(&limits, 0, sizeof(limits));
+	limits.bufferImageGranularity = GRANULARITY;
+	limits.nonCoherentAtomSize = ATOM_SIZE;
+
+	vk_minimal_alloc_init(a, vkd, VK_NULL_HANDLE, &props, &limits);
+}
+
+static int check(const char *name, int ok)
+{
+	LOGI("%s: %s\n", name, ok ? "ok" : "FAILED");
+	return ok;
+}
+
+// Random sizes, alignments and kinds, freed in random order. No two
+// allocations overlap, none shares a granularity page with one of the other
+// kind, and once everything is freed each block is one free range again.
+static int check_alloc_free(void)
+{
+	struct vulkan_dlfcn_device vkd;
+	struct vk_minimal_allocator a;
+	struct vk_minimal_alloc_stats stats;
+	enum { COUNT = 2000 };
+	struct vk_minimal_allocation *allocs = calloc(COUNT, sizeof(allocs[0]));
+	enum vk_minimal_alloc_kind *kinds = calloc(COUNT, sizeof(kinds[0]));
+	uint32_t seed = 1;
+	uint32_t i, j;
+	int ok = 1;
+
+	init_allocator(&a, &vkd);
+	for (i = 0; i < COUNT; i++)
+	{
+		VkMemoryRequirements mr;
+		mr.size = 1 + next(&seed) % 200000;
+		mr.alignment = 1ull << (next(&seed) % 17);
+		mr.memoryTypeBits = 1;
+		kinds[i] = next(&seed) % 3 == 0 ? VK_MINIMAL_ALLOC_OPTIMAL : VK_MINIMAL_ALLOC_LINEAR;
+		if (vk_minimal_alloc(&a, 0, &mr, kinds[i], &allocs[i]) != VK_SUCCESS)
+			return check("alloc", 0);
+		ok = ok && allocs[i].offset % mr.alignment == 0 && allocs[i].size >= mr.size;
+		ok = ok && allocs[i].data == (uint8_t *)(uintptr_t)allocs[i].memory + allocs[i].offset;
+	}
+
+	for (i = 0; i < COUNT && ok; i++)
+	{
+		VkDeviceSize a0 = allocs[i].offset, a1 = a0 + allocs[i].size;
+		for (j = i + 1; j < COUNT && ok; j++)
+		{
+			VkDeviceSize b0 = allocs[j].offset, b1 = b0 + allocs[j].size;
+			if (allocs[i].memory != allocs[j].memory)
+				continue;
+			ok = a1 <= b0 || b1 <= a0;
+			if (ok && kinds[i] != kinds[j])
+				ok = (a1 - 1) / GRANULARITY < b0 / GRANULARITY || (b1 - 1) / GRANULARITY < a0 / GRANULARITY;
+		}
+	}
+	check("alloc: aligned, disjoint, granularity pages of one kind", ok);
+
+	// Free every other allocation, then the rest
+	for (j = 0; j < 2; j++)
+	{
+		for (i = j; i < COUNT; i += 2)
+		{
+			vk_minimal_free(&a, &allocs[(i * 7919) % COUNT]);
+		}
+	}
+	vk_minimal_alloc_get_stats(&a, &stats);
+	int merged = stats.allocations == 0 && stats.used == 0 && stats.free_ranges == stats.blocks;
+	for (i = 0; i < a.block_count; i++)
+	{
+		if (a.blocks[i].memory)
+			merged = merged && a.blocks[i].free_count == 1 && a.blocks[i].free[0].offset == 0 && a.blocks[i].free[0].size == a.blocks[i].size;
+	}
+	check("free: neighbours merged back into whole blocks", merged);
+
+	vk_minimal_alloc_destroy(&a);
+	free(kinds);
+	free(allocs);
+	return ok && merged;
+}
+
+// The arena starts behind a small allocation so its base is only 256
+// aligned, the pushes still have to be aligned within the memory
+static int check_arena(void)
+{
+	struct vulkan_dlfcn_device vkd;
+	struct vk_minimal_allocator a;
+	struct vk_minimal_allocation before;
+	struct vk_minimal_arena arena;
+	const VkDeviceSize size = 1 << 20;
+	VkDeviceSize prev_end = 0;
+	uint32_t seed = 7;
+	uint32_t i;
+	int ok = 1;
+
+	init_allocator(&a, &vkd);
+	VkMemoryRequirements mr = {100, 1, 1};
+	vk_minimal_alloc(&a, 0, &mr, VK_MINIMAL_ALLOC_LINEAR, &before);
+	if (vk_minimal_arena_init(&a, &arena, 0, size) != VK_SUCCESS)
+		return check("arena", 0);
+	ok = arena.alloc.offset % 65536 != 0;
+
+	for (i = 0; i < 64; i++)
+	{
+		VkDeviceSize alignment = 1ull << (next(&seed) % 17);
+		VkDeviceSize offset = vk_minimal_arena_push(&arena, 1 + next(&seed) % 4096, alignment);
+		if (offset == VK_WHOLE_SIZE)
+			break;
+		ok = ok && (arena.alloc.offset + offset) % alignment == 0 && offset >= prev_end;
+		prev_end = arena.head;
+	}
+	check("arena: pushes aligned within the memory", ok);
+
+	int full = vk_minimal_arena_push(&arena, size, 1) == VK_WHOLE_SIZE;
+	vk_minimal_arena_reset(&arena);
+	int reset = arena.head == 0 && vk_minimal_arena_push(&arena, size, 1) == 0 && vk_minimal_arena_push(&arena, 1, 1) == VK_WHOLE_SIZE;
+	check("arena: full push refused, reset starts over", full && reset);
+
+	vk_minimal_arena_destroy(&a, &arena);
+	vk_minimal_free(&a, &before);
+	vk_minimal_alloc_destroy(&a);
+	return ok && full && reset;
+}
+
+static void bench_alloc_free(uint32_t rounds)
+{
+	struct vulkan_dlfcn_device vkd;
+	struct vk_minimal_allocator a;
+	enum { LIVE = 512 };
+	struct vk_minimal_allocation allocs[LIVE];
+	uint32_t seed = 3;
+	uint32_t i;
+
+	init_allocator(&a, &vkd);
+	memset(allocs, 0, sizeof(allocs));
+
+	double t0 = now();
+	for (i = 0; i < rounds; i++)
+	{
+		struct vk_minimal_allocation *alloc = &allocs[next(&seed) % LIVE];
+		VkMemoryRequirements mr;
+		mr.size = 256 + next(&seed) % 65536;
+		mr.alignment = 256;
+		mr.memoryTypeBits = 1;
+
+		vk_minimal_free(&a, alloc);
+		VkResult err = vk_minimal_alloc(&a, 0, &mr, next(&seed) % 3 ? VK_MINIMAL_ALLOC_LINEAR : VK_MINIMAL_ALLOC_OPTIMAL, alloc);
+		assert(err == VK_SUCCESS);
+	}
+	double secs = now() - t0;
+
+	struct vk_minimal_alloc_stats stats;
+	vk_minimal_alloc_get_stats(&a, &stats);
+	LOGI("%u alloc/free pairs with %u live: %.1f ns per pair, %u blocks, %u free ranges, fragmentation %.3f\n",
+	     rounds, LIVE, secs * 1e9 / rounds, stats.blocks, stats.free_ranges, stats.fragmentation);
+
+	for (i = 0; i < LIVE; i++)
+	{
+		vk_minimal_free(&a, &allocs[i]);
+	}
+	vk_minimal_alloc_destroy(&a);
+}
+
+int main(int argc, char **argv)
+{
+	// Optional argument selects the number of alloc/free pairs timed
+	uint32_t rounds = 1000000;
+	if (argc > 1)
+		rounds = atoi(argv[1]);
+
+	int ok = check_alloc_free();
+	ok = check_arena() && ok;
+	bench_alloc_free(rounds);
+
+	return ok ? 0 : 1;
+}
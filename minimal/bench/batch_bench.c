@@ -0,0 +1,401 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "vk_minimal_batch.h"
+#include "vk_minimal_fill.h"
+#include "vk_minimal_pool.h"
+
+#define LOGI(...) ((void)printf(__VA_ARGS__))
+
+#define SPRITE_SIZE 64
+#define GLYPH_WIDTH 8
+#define GLYPH_HEIGHT 16
+#define GLYPH_COUNT 16
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static uint32_t sprite[SPRITE_SIZE * SPRITE_SIZE];
+static uint8_t coverage[GLYPH_HEIGHT * GLYPH_WIDTH * GLYPH_COUNT];
+static struct vk_minimal_rect glyph_rects[GLYPH_COUNT];
+static const struct vk_minimal_atlas atlas = {coverage, GLYPH_WIDTH * GLYPH_COUNT, glyph_rects, GLYPH_COUNT};
+
+// Alpha ramps with transparent and opaque runs, so the vector paths take
+// every branch
+static void build_sources(void)
+{
+	uint32_t x, y;
+
+	for (y = 0; y < SPRITE_SIZE; y++)
+	{
+		for (x = 0; x < SPRITE_SIZE; x++)
+		{
+			uint32_t a = x < 8 ? 0 : x >= 56 ? 255 : (x * 4 + y) & 0xff;
+			sprite[y * SPRITE_SIZE + x] = a << 24 | (x * 4) << 16 | (y * 4) << 8 | ((x ^ y) & 0xff);
+		}
+	}
+	for (x = 0; x < GLYPH_COUNT; x++)
+	{
+		glyph_rects[x].x0 = x * GLYPH_WIDTH;
+		glyph_rects[x].y0 = 0;
+		glyph_rects[x].x1 = (x + 1) * GLYPH_WIDTH;
+		glyph_rects[x].y1 = GLYPH_HEIGHT;
+	}
+	for (y = 0; y < GLYPH_HEIGHT; y++)
+	{
+		for (x = 0; x < GLYPH_WIDTH * GLYPH_COUNT; x++)
+			coverage[y * GLYPH_WIDTH * GLYPH_COUNT + x] = (x * 37 + y * 11) % 5 == 0 ? 0 : (x * 37 + y * 11) & 0xff;
+	}
+}
+
+static uint32_t next(uint32_t *seed)
+{
+	*seed = *seed * 1103515245 + 12345;
+	return *seed >> 8;
+}
+
+// The same pseudo random overlay every time, partly off the canvas
+static void queue_overlay(struct vk_minimal_batch *batch, uint32_t count)
+{
+	uint32_t seed = 1, i;
+
+	for (i = 0; i < count; i++)
+	{
+		int32_t x = (int32_t)(next(&seed) % (batch->width + 64)) - 32;
+		int32_t y = (int32_t)(next(&seed) % (batch->height + 64)) - 32;
+		uint32_t color = next(&seed) | 0x80000000;
+
+		switch (i % 6)
+		{
+			case 0: vk_minimal_batch_fill_rect(batch, x, y, next(&seed) % 200, next(&seed) % 100, color); break;
+			case 1: vk_minimal_batch_hline(batch, x, y, next(&seed) % 300, color); break;
+			case 2: vk_minimal_batch_vline(batch, x, y, next(&seed) % 300, color); break;
+			case 3: vk_minimal_batch_line(batch, x, y, x + (int32_t)(next(&seed) % 600) - 300, y + (int32_t)(next(&seed) % 600) - 300, color); break;
+			case 4: vk_minimal_batch_blend(batch, x, y, sprite, SPRITE_SIZE * sizeof(uint32_t), SPRITE_SIZE, SPRITE_SIZE); break;
+			case 5: vk_minimal_batch_glyph(batch, x, y, &atlas, next(&seed) % GLYPH_COUNT, color); break;
+		}
+	}
+}
+
+static void draw(enum vk_minimal_fill_path path, enum vk_minimal_fill_format format, struct vk_minimal_pool *pool,
+                 uint32_t width, uint32_t height, uint32_t count, void *data, size_t row_pitch)
+{
+	const struct vk_minimal_rect full = {0, 0, width, height};
+	struct vk_minimal_damage damage;
+	struct vk_minimal_fill fill;
+	struct vk_minimal_batch batch;
+
+	vk_minimal_fill_init(&fill, path, format, width);
+	vk_minimal_batch_init(&batch, width, height);
+	vk_minimal_fill_grid_prepare(&fill, 0x5a5a5a5a);
+	vk_minimal_damage_clear(&damage);
+	vk_minimal_damage_add(&damage, full);
+	queue_overlay(&batch, count);
+	vk_minimal_batch_draw(&batch, &fill, pool, &damage, data, row_pitch);
+	vk_minimal_batch_destroy(&batch);
+	vk_minimal_fill_destroy(&fill);
+}
+
+// Every path has to match the scalar one bit for bit
+static int check_path(enum vk_minimal_fill_path path, enum vk_minimal_fill_format format, uint32_t width, uint32_t height)
+{
+	const size_t row_pitch = width * vk_minimal_fill_format_bpp(format) + 12;
+	uint8_t *ref = calloc(height, row_pitch);
+	uint8_t *out = calloc(height, row_pitch);
+
+	draw(VK_MINIMAL_FILL_SCALAR, format, NULL, width, height, 500, ref, row_pitch);
+	draw(path, format, NULL, width, height, 500, out, row_pitch);
+	int ok = memcmp(ref, out, height * row_pitch) == 0;
+
+	free(ref);
+	free(out);
+	return ok;
+}
+
+// Lines against stepping along the major axis, rather than solving for the
+// span of each row like the batch does
+static int check_lines(uint32_t width, uint32_t height)
+{
+	const size_t row_pitch = width * sizeof(uint32_t);
+	uint32_t *ref = calloc(height, row_pitch);
+	uint32_t *out = calloc(height, row_pitch);
+	const struct vk_minimal_rect full = {0, 0, width, height};
+	struct vk_minimal_damage none;
+	struct vk_minimal_fill fill;
+	struct vk_minimal_batch batch;
+	uint32_t seed = 7, i;
+	int64_t t;
+
+	vk_minimal_damage_clear(&none);
+
+	vk_minimal_fill_init(&fill, VK_MINIMAL_FILL_SCALAR, VK_MINIMAL_FILL_8888, width);
+	vk_minimal_batch_init(&batch, width, height);
+	vk_minimal_fill_grid(&fill, NULL, out, row_pitch, &full, 1);
+
+	for (i = 0; i < 1000; i++)
+	{
+		int32_t x0, y0, x1, y1;
+		x0 = (int32_t)(next(&seed) % (width + 200)) - 100;
+		y0 = (int32_t)(next(&seed) % (height + 200)) - 100;
+		x1 = x0 + (int32_t)(next(&seed) % 401) - 200;
+		y1 = y0 + (int32_t)(next(&seed) % 401) - 200;
+		vk_minimal_batch_line(&batch, x0, y0, x1, y1, 0xff000000 | i);
+
+		if (y0 > y1)
+		{
+			int32_t tx = x0, ty = y0;
+			x0 = x1;
+			y0 = y1;
+			x1 = tx;
+			y1 = ty;
+		}
+		const int64_t dx = x1 - x0, adx = dx < 0 ? -dx : dx, dy = y1 - y0, sx = dx < 0 ? -1 : 1;
+		const int64_t major = adx > dy ? adx : dy;
+		for (t = 0; t <= major; t++)
+		{
+			int64_t x, y;
+			if (adx > dy)
+			{
+				x = x0 + sx * t;
+				y = y0 + (2 * t * dy + adx) / (2 * adx);
+			}
+			else
+			{
+				x = x0 + sx * ((2 * t * adx + dy) / (2 * dy));
+				y = y0 + t;
+			}
+			if (x >= 0 && y >= 0 && x < width && y < height)
+				ref[y * width + x] = 0xff000000 | i;
+		}
+	}
+	vk_minimal_batch_draw(&batch, &fill, NULL, &none, out, row_pitch);
+
+	// Only the line pixels are compared, the background is the grid in out
+	int ok = 1;
+	for (i = 0; i < width * height; i++)
+	{
+		if (ref[i] && ref[i] != out[i])
+			ok = 0;
+	}
+
+	vk_minimal_batch_destroy(&batch);
+	vk_minimal_fill_destroy(&fill);
+	free(ref);
+	free(out);
+	return ok;
+}
+
+static int rect_has(const struct vk_minimal_rect *r, uint32_t x, uint32_t y)
+{
+	return x >= r->x0 && x < r->x1 && y >= r->y0 && y < r->y1;
+}
+
+// Grid lines and a few blocks damaged on a canvas of garbage. Wherever the
+// grid is damaged or the overlay draws the result has to match a full grid
+// fill with the overlay on top, and rows the overlay does not touch have to
+// keep their garbage outside the damage.
+static int check_damage(uint32_t width, uint32_t height)
+{
+	const size_t row_pitch = width * sizeof(uint32_t);
+	const uint32_t garbage = 0xcdcdcdcd;
+	uint32_t *ref = calloc(height, row_pitch);
+	uint32_t *out = malloc(height * row_pitch);
+	const struct vk_minimal_rect full = {0, 0, width, height};
+	struct vk_minimal_damage none, damage, drawn;
+	struct vk_minimal_fill fill;
+	struct vk_minimal_batch batch;
+	uint32_t seed = 11, i, x, y;
+	int ok = 1;
+
+	vk_minimal_fill_init(&fill, VK_MINIMAL_FILL_SCALAR, VK_MINIMAL_FILL_8888, width);
+	vk_minimal_batch_init(&batch, width, height);
+	vk_minimal_fill_grid_prepare(&fill, 0x5a5a5a5a);
+	vk_minimal_damage_clear(&none);
+	vk_minimal_fill_grid(&fill, NULL, ref, row_pitch, &full, 1);
+	queue_overlay(&batch, 100);
+	vk_minimal_batch_draw(&batch, &fill, NULL, &none, ref, row_pitch);
+
+	vk_minimal_damage_clear(&damage);
+	for (y = 0; y < height; y += 64)
+	{
+		struct vk_minimal_rect r = {0, y, width, y + 1};
+		vk_minimal_damage_add(&damage, r);
+	}
+	for (x = 0; x < width; x += 64)
+	{
+		struct vk_minimal_rect r = {x, 0, x + 1, height};
+		vk_minimal_damage_add(&damage, r);
+	}
+	for (i = 0; i < 8; i++)
+	{
+		struct vk_minimal_rect r;
+		r.x0 = next(&seed) % width;
+		r.y0 = next(&seed) % height;
+		r.x1 = r.x0 + 1 + next(&seed) % (width - r.x0);
+		r.y1 = r.y0 + 1 + next(&seed) % (height - r.y0);
+		vk_minimal_damage_add(&damage, r);
+	}
+
+	for (i = 0; i < width * height; i++)
+		out[i] = garbage;
+	queue_overlay(&batch, 100);
+	vk_minimal_batch_draw(&batch, &fill, NULL, &damage, out, row_pitch);
+	// Few enough commands that none of their rects were merged
+	drawn = batch.drawn;
+
+	for (y = 0; y < height && ok; y++)
+	{
+		int touched = 0;
+		for (i = 0; i < drawn.count; i++)
+			touched |= y >= drawn.rects[i].y0 && y < drawn.rects[i].y1;
+
+		for (x = 0; x < width && ok; x++)
+		{
+			int restored = 0;
+			for (i = 0; i < damage.count; i++)
+				restored |= rect_has(&damage.rects[i], x, y);
+			for (i = 0; i < drawn.count; i++)
+				restored |= rect_has(&drawn.rects[i], x, y);
+
+			if (restored)
+				ok = out[y * width + x] == ref[y * width + x];
+			else if (!touched)
+				ok = out[y * width + x] == garbage;
+		}
+	}
+
+	vk_minimal_batch_destroy(&batch);
+	vk_minimal_fill_destroy(&fill);
+	free(ref);
+	free(out);
+	return ok;
+}
+
+// Time to compose and stream one overlay, the grid fill is not included
+static double bench_batch(enum vk_minimal_fill_path path, enum vk_minimal_fill_format format, uint32_t threads,
+                          uint32_t width, uint32_t height, uint32_t count, uint32_t iterations)
+{
+	const size_t row_pitch = width * vk_minimal_fill_format_bpp(format);
+	const struct vk_minimal_rect full = {0, 0, width, height};
+	struct vk_minimal_damage none;
+	struct vk_minimal_fill fill;
+	struct vk_minimal_batch batch;
+	struct vk_minimal_pool pool;
+	double t = 0.0;
+	void *data;
+	uint32_t i;
+
+	int res = posix_memalign(&data, 64, height * row_pitch);
+	assert(res == 0);
+
+	vk_minimal_fill_init(&fill, path, format, width);
+	vk_minimal_batch_init(&batch, width, height);
+	vk_minimal_pool_init(&pool, threads);
+	vk_minimal_fill_grid(&fill, &pool, data, row_pitch, &full, 1);
+	vk_minimal_damage_clear(&none);
+
+	for (i = 0; i < iterations; i++)
+	{
+		queue_overlay(&batch, count);
+		double t0 = now();
+		vk_minimal_batch_draw(&batch, &fill, &pool, &none, data, row_pitch);
+		t += now() - t0;
+	}
+
+	vk_minimal_pool_destroy(&pool);
+	vk_minimal_batch_destroy(&batch);
+	vk_minimal_fill_destroy(&fill);
+	free(data);
+
+	return t / iterations * 1e3;
+}
+
+int main(int argc, char **argv)
+{
+	const uint32_t width = 1920, height = 1080;
+	uint32_t iterations = 100, count = 2000, max_threads = 0;
+	enum vk_minimal_fill_format format;
+	enum vk_minimal_fill_path path;
+	uint32_t threads;
+	int failed = 0;
+
+	if (argc > 1)
+		iterations = atoi(argv[1]);
+	if (argc > 2)
+		count = atoi(argv[2]);
+	if (argc > 3)
+		max_threads = atoi(argv[3]);
+	if (max_threads == 0)
+	{
+		long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		max_threads = cpus > 0 ? cpus : 1;
+	}
+
+	build_sources();
+
+	int ok = check_lines(width, height);
+	LOGI("lines %s\n", ok ? "ok" : "FAIL");
+	failed |= !ok;
+	ok = check_damage(width, height);
+	LOGI("damage %s\n", ok ? "ok" : "FAIL");
+	failed |= !ok;
+
+	LOGI("canvas %ux%u, %u commands, %u iterations\n", width, height, count, iterations);
+	for (format = VK_MINIMAL_FILL_8888; format < VK_MINIMAL_FILL_FORMAT_COUNT; format++)
+	{
+		LOGI(" %s\n", vk_minimal_fill_format_name(format));
+		for (path = VK_MINIMAL_FILL_SCALAR; path < VK_MINIMAL_FILL_PATH_COUNT; path++)
+		{
+			if (!vk_minimal_fill_path_supported(path))
+				continue;
+
+			ok = check_path(path, format, width, height);
+			double ms = bench_batch(path, format, 1, width, height, count, iterations);
+			LOGI("  %-8s %s %8.3f ms\n", vk_minimal_fill_path_name(path), ok ? "ok  " : "FAIL", ms);
+			failed |= !ok;
+		}
+	}
+
+	for (threads = 1; threads <= max_threads; threads++)
+	{
+		double ms = bench_batch(VK_MINIMAL_FILL_AUTO, VK_MINIMAL_FILL_8888, threads, width, height, count, iterations);
+		LOGI("  %2u threads  %8.3f ms\n", threads, ms);
+	}
+
+	return failed;
+}
@@ -0,0 +1,221 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "vulkan_dlfcn/vulkan_dlfcn.h"
+#include "vk_minimal.h"
+
+#define LOGI(...) ((void)printf(__VA_ARGS__))
+
+// Cost of capturing every frame at 1920x1080 and 60 frames/s, offscreen so
+// nothing but the bench paces the frames. Runs once without capture and
+// once per container and prints one CSV line per run, with the CPU time and
+// the wall time of vk_minimal_draw() against the run without capture. A
+// capture that stalls the render loop shows in the draw time and in the
+// frames that missed their slot. Only built headless.
+
+#define CAPTURE_WIDTH 1920
+#define CAPTURE_HEIGHT 1080
+#define CAPTURE_FPS 60
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void sleep_until(double t)
+{
+	struct timespec ts;
+	ts.tv_sec = (time_t)t;
+	ts.tv_nsec = (long)((t - ts.tv_sec) * 1e9);
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) != 0)
+		;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *)a;
+	double y = *(const double *)b;
+	return (x > y) - (x < y);
+}
+
+// Nearest rank on sorted samples
+static double percentile(const double *sorted, uint32_t count, double p)
+{
+	uint32_t rank = (uint32_t)(p * count + 0.999999);
+	if (rank == 0)
+		rank = 1;
+	if (rank > count)
+		rank = count;
+	return sorted[rank - 1];
+}
+
+struct result {
+	double cpu_ms;
+	double draw_ms;
+	double draw_p99_ms;
+	uint32_t late;
+	uint64_t captured;
+	uint64_t dropped;
+	uint64_t written;
+	double write_ms;
+	double write_max_ms;
+	double mb_per_s;
+};
+
+static void run(VkInstance instance, enum vk_minimal_capture_container container, const char *path, uint32_t frames, struct result *res)
+{
+	struct vk_minimal_context actx;
+	double *times = malloc(sizeof(times[0]) * frames);
+	const double period = 1.0 / CAPTURE_FPS;
+	uint64_t cpu_ns = 0;
+	uint32_t i;
+
+	memset(&actx, 0, sizeof(actx));
+	actx.instance = instance;
+	actx.surface = VK_NULL_HANDLE;
+	actx.extent.width = CAPTURE_WIDTH;
+	actx.extent.height = CAPTURE_HEIGHT;
+	actx.capture_container = container;
+	actx.capture_path = path;
+	vk_minimal_init(&actx);
+
+	memset(res, 0, sizeof(*res));
+	double t0 = now();
+	for (i = 0; i < frames; i++)
+	{
+		double deadline = t0 + i * period;
+		sleep_until(deadline);
+
+		double t = now();
+		vk_minimal_draw(&actx);
+		double end = now();
+		times[i] = (end - t) * 1e3;
+		cpu_ns += actx.stats.cpu_ns;
+		if (end > deadline + period)
+			res->late++;
+	}
+	double secs = now() - t0;
+
+	double sum = 0.0;
+	for (i = 0; i < frames; i++)
+	{
+		sum += times[i];
+	}
+	qsort(times, frames, sizeof(times[0]), cmp_double);
+
+	res->cpu_ms = cpu_ns * 1e-6 / frames;
+	res->draw_ms = sum / frames;
+	res->draw_p99_ms = percentile(times, frames, 0.99);
+	res->captured = actx.stats.captured;
+	res->dropped = actx.stats.capture_dropped;
+	if (container)
+	{
+		// What the writer kept up with while the frames were drawn
+		uint64_t written = atomic_load(&actx.capture.stats.frames);
+		res->written = written;
+		res->write_ms = written ? atomic_load(&actx.capture.stats.write_ns) * 1e-6 / written : 0.0;
+		res->write_max_ms = atomic_load(&actx.capture.stats.write_max_ns) * 1e-6;
+		res->mb_per_s = atomic_load(&actx.capture.stats.bytes) / secs / 1e6;
+	}
+
+	vk_minimal_destroy(&actx);
+	free(times);
+}
+
+int main(int argc, char **argv)
+{
+	// Load libvulkan.so
+	vulkan_dlfcn_init();
+
+	// Optional arguments select the path the captures are written to, with
+	// the container name appended, and the number of frames per run
+	const char *prefix = "/tmp/vk_minimal_capture";
+	uint32_t frames = 600;
+	if (argc > 1)
+		prefix = argv[1];
+	if (argc > 2)
+		frames = atoi(argv[2]);
+	assert(frames > 0);
+
+	VkResult err;
+	VkApplicationInfo app;
+	app.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+	app.pNext = NULL;
+	app.pApplicationName = NULL;
+	app.applicationVersion = 0;
+	app.pEngineName = NULL;
+	app.engineVersion = 0;
+	app.apiVersion = VK_API_VERSION_1_0;
+
+	VkInstanceCreateInfo inst_info;
+	inst_info.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+	inst_info.pNext = NULL;
+	inst_info.flags = 0;
+	inst_info.pApplicationInfo = &app;
+	inst_info.enabledLayerCount = 0;
+	inst_info.ppEnabledLayerNames = NULL;
+	inst_info.enabledExtensionCount = 0;
+	inst_info.ppEnabledExtensionNames = NULL;
+
+	VkInstance instance;
+	err = vkCreateInstance(&inst_info, NULL, &instance);
+	assert(err == VK_SUCCESS);
+
+	LOGI("capture,width,height,fps,frames,captured,dropped,written,cpu_ms,draw_ms,draw_p99_ms,late,"
+	     "cpu_overhead_ms,draw_overhead_ms,write_ms,write_max_ms,mb_per_s\n");
+
+	struct result base;
+	enum vk_minimal_capture_container container;
+	for (container = VK_MINIMAL_CAPTURE_OFF; container < VK_MINIMAL_CAPTURE_CONTAINER_COUNT; container++)
+	{
+		char path[4096];
+		struct result res;
+
+		snprintf(path, sizeof(path), "%s.%s", prefix, vk_minimal_capture_container_name(container));
+		run(instance, container, path, frames, &res);
+		if (container == VK_MINIMAL_CAPTURE_OFF)
+			base = res;
+
+		LOGI("%s,%u,%u,%u,%u,%llu,%llu,%llu,%.4f,%.4f,%.4f,%u,%.4f,%.4f,%.4f,%.4f,%.1f\n",
+		     vk_minimal_capture_container_name(container), CAPTURE_WIDTH, CAPTURE_HEIGHT, CAPTURE_FPS, frames,
+		     (unsigned long long)res.captured, (unsigned long long)res.dropped, (unsigned long long)res.written,
+		     res.cpu_ms, res.draw_ms, res.draw_p99_ms, res.late, res.cpu_ms - base.cpu_ms, res.draw_ms - base.draw_ms,
+		     res.write_ms, res.write_max_ms, res.mb_per_s);
+	}
+
+	vkDestroyInstance(instance, NULL);
+
+	return 0;
+}
@@ -0,0 +1,170 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "vulkan_dlfcn/vulkan_dlfcn.h"
+#include "vk_minimal.h"
+
+#define LOGI(...) ((void)printf(__VA_ARGS__))
+
+// Per call cost of the dlsym'd loader globals against the dispatch tables
+// filled by vk_minimal_init(), for a command buffer call and a device call.
+// Only built headless, no surface is needed to reach the device.
+
+#define BATCH 10000
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Records batches of vkCmdSetLineWidth, only the recording itself is timed
+static double bench_cmd(PFN_vkBeginCommandBuffer begin, PFN_vkEndCommandBuffer end, PFN_vkCmdSetLineWidth set_line_width,
+                        VkCommandBuffer cmd, uint32_t batches)
+{
+	VkResult err;
+	double secs = 0.0;
+	uint32_t b, i;
+
+	VkCommandBufferBeginInfo cbbi;
+	memset(&cbbi, 0, sizeof(cbbi));
+	cbbi.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	cbbi.pNext = NULL;
+	cbbi.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	cbbi.pInheritanceInfo = NULL;
+
+	for (b = 0; b < batches; b++)
+	{
+		err = begin(cmd, &cbbi);
+		assert(err == VK_SUCCESS);
+
+		double t0 = now();
+		for (i = 0; i < BATCH; i++)
+		{
+			set_line_width(cmd, 1.0f);
+		}
+		secs += now() - t0;
+
+		err = end(cmd);
+		assert(err == VK_SUCCESS);
+	}
+
+	return secs * 1e9 / ((double)batches * BATCH);
+}
+
+static double bench_device(PFN_vkGetFenceStatus get_fence_status, VkDevice device, VkFence fence, uint32_t batches)
+{
+	uint32_t b, i;
+
+	double t0 = now();
+	for (b = 0; b < batches; b++)
+	{
+		for (i = 0; i < BATCH; i++)
+		{
+			get_fence_status(device, fence);
+		}
+	}
+
+	return (now() - t0) * 1e9 / ((double)batches * BATCH);
+}
+
+int main(int argc, char **argv)
+{
+	// Load libvulkan.so
+	vulkan_dlfcn_init();
+
+	uint32_t batches = 100;
+	if (argc > 1)
+		batches = atoi(argv[1]);
+	assert(batches > 0);
+
+	VkResult err;
+	VkApplicationInfo app;
+	app.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+	app.pNext = NULL;
+	app.pApplicationName = NULL;
+	app.applicationVersion = 0;
+	app.pEngineName = NULL;
+	app.engineVersion = 0;
+	app.apiVersion = VK_API_VERSION_1_0;
+
+	VkInstanceCreateInfo inst_info;
+	inst_info.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+	inst_info.pNext = NULL;
+	inst_info.flags = 0;
+	inst_info.pApplicationInfo = &app;
+	inst_info.enabledLayerCount = 0;
+	inst_info.ppEnabledLayerNames = NULL;
+	inst_info.enabledExtensionCount = 0;
+	inst_info.ppEnabledExtensionNames = NULL;
+
+	struct vk_minimal_context actx;
+	memset(&actx, 0, sizeof(actx));
+	err = vkCreateInstance(&inst_info, NULL, &actx.instance);
+	assert(err == VK_SUCCESS);
+
+	actx.surface = VK_NULL_HANDLE;
+	vk_minimal_init(&actx);
+
+	VkCommandBufferAllocateInfo cbai;
+	memset(&cbai, 0, sizeof(cbai));
+	cbai.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	cbai.pNext = NULL;
+	cbai.commandPool = actx.cmd_pool;
+	cbai.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	cbai.commandBufferCount = 1;
+
+	VkCommandBuffer cmd;
+	err = actx.dev->vkd.vkAllocateCommandBuffers(actx.dev->device, &cbai, &cmd);
+	assert(err == VK_SUCCESS);
+
+	// Created signaled and never submitted here, the query just reads it
+	VkFence fence = actx.dev->fences[0];
+
+	LOGI("call,dispatch,calls,ns_per_call\n");
+	LOGI("vkCmdSetLineWidth,loader,%u,%.2f\n", batches * BATCH,
+	     bench_cmd(vkBeginCommandBuffer, vkEndCommandBuffer, vkCmdSetLineWidth, cmd, batches));
+	LOGI("vkCmdSetLineWidth,table,%u,%.2f\n", batches * BATCH,
+	     bench_cmd(actx.dev->vkd.vkBeginCommandBuffer, actx.dev->vkd.vkEndCommandBuffer, actx.dev->vkd.vkCmdSetLineWidth, cmd, batches));
+	LOGI("vkGetFenceStatus,loader,%u,%.2f\n", batches * BATCH,
+	     bench_device(vkGetFenceStatus, actx.dev->device, fence, batches));
+	LOGI("vkGetFenceStatus,table,%u,%.2f\n", batches * BATCH,
+	     bench_device(actx.dev->vkd.vkGetFenceStatus, actx.dev->device, fence, batches));
+
+	actx.dev->vkd.vkFreeCommandBuffers(actx.dev->device, actx.cmd_pool, 1, &cmd);
+	vk_minimal_destroy(&actx);
+	vkDestroyInstance(actx.instance, NULL);
+
+	return 0;
+}
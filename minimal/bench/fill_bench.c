@@ -0,0 +1,179 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "vk_minimal_fill.h"
+#include "vk_minimal_pool.h"
+
+#define LOGI(...) ((void)printf(__VA_ARGS__))
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Compare a fast path against the scalar reference, using a row pitch that
+// leaves every row start misaligned to exercise the head and tail handling.
+// A partial rectangle is filled on top to check the clipped path as well.
+static int check_path(enum vk_minimal_fill_path path, enum vk_minimal_fill_format format, uint32_t width, uint32_t height)
+{
+	const uint32_t bpp = vk_minimal_fill_format_bpp(format);
+	const size_t row_pitch = width * bpp + 12;
+	uint8_t *ref = calloc(height, row_pitch);
+	uint8_t *tmp = calloc(height, row_pitch);
+	uint8_t *out = calloc(height, row_pitch);
+	struct vk_minimal_rect full = {0, 0, width, height};
+	struct vk_minimal_rect part = {width / 3 + 1, height / 5 + 3, width - 7, height / 2};
+	struct vk_minimal_fill fill;
+	uint32_t y;
+	int ok;
+
+	vk_minimal_fill_init(&fill, path, format, width);
+	vk_minimal_fill_grid_prepare(&fill, 0x5a5a5a5a);
+	vk_minimal_fill_grid(&fill, NULL, out + 4, row_pitch, &full, 1);
+	vk_minimal_fill_grid_prepare(&fill, 0xa5a5a5a5);
+	vk_minimal_fill_grid_rect(&fill, out + 4, row_pitch, &part);
+
+	vk_minimal_fill_grid_ref(format, 0x5a5a5a5a, ref + 4, row_pitch, width, 0, height);
+	vk_minimal_fill_grid_ref(format, 0xa5a5a5a5, tmp + 4, row_pitch, width, 0, height);
+	for (y = part.y0; y < part.y1; y++)
+	{
+		size_t offset = 4 + y * row_pitch + part.x0 * bpp;
+		memcpy(ref + offset, tmp + offset, (part.x1 - part.x0) * bpp);
+	}
+
+	ok = memcmp(ref, out, height * row_pitch) == 0;
+	vk_minimal_fill_destroy(&fill);
+
+	free(ref);
+	free(tmp);
+	free(out);
+	return ok;
+}
+
+static double bench_fill(enum vk_minimal_fill_path path, enum vk_minimal_fill_format format, uint32_t threads,
+                         uint32_t width, uint32_t height, uint32_t iterations)
+{
+	const size_t row_pitch = width * vk_minimal_fill_format_bpp(format);
+	const struct vk_minimal_rect full = {0, 0, width, height};
+	struct vk_minimal_fill fill;
+	struct vk_minimal_pool pool;
+	void *data;
+	uint32_t i;
+	double t0, t1;
+
+	int res = posix_memalign(&data, 64, height * row_pitch);
+	assert(res == 0);
+
+	vk_minimal_fill_init(&fill, path, format, width);
+	vk_minimal_pool_init(&pool, threads);
+
+	t0 = now();
+	for (i = 0; i < iterations; i++)
+	{
+		if (path == VK_MINIMAL_FILL_SCALAR)
+		{
+			vk_minimal_fill_grid_ref(format, 0x01010101 * (i & 0xff), data, row_pitch, width, 0, height);
+		}
+		else
+		{
+			vk_minimal_fill_grid_prepare(&fill, 0x01010101 * (i & 0xff));
+			vk_minimal_fill_grid(&fill, &pool, data, row_pitch, &full, 1);
+		}
+	}
+	t1 = now();
+
+	vk_minimal_pool_destroy(&pool);
+	vk_minimal_fill_destroy(&fill);
+	free(data);
+
+	return (double)height * row_pitch * iterations / (t1 - t0) / 1e9;
+}
+
+int main(int argc, char **argv)
+{
+	static const uint32_t sizes[][2] = {
+		{1920, 1080},
+		{3840, 2160}
+	};
+	uint32_t iterations = 100, max_threads = 0;
+	enum vk_minimal_fill_format format;
+	enum vk_minimal_fill_path path;
+	uint32_t i, threads;
+	int failed = 0;
+
+	if (argc > 1)
+		iterations = atoi(argv[1]);
+	if (argc > 2)
+		max_threads = atoi(argv[2]);
+	if (max_threads == 0)
+	{
+		long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		max_threads = cpus > 0 ? cpus : 1;
+	}
+
+	for (i = 0; i < sizeof(sizes)/sizeof(sizes[0]); i++)
+	{
+		const uint32_t width = sizes[i][0], height = sizes[i][1];
+
+		LOGI("canvas %ux%u, %u iterations\n", width, height, iterations);
+		// The 16 bit layouts halve the bytes written per frame, the expanded
+		// ones write as much as 8888 and show what the CPU fallback costs
+		for (format = VK_MINIMAL_FILL_8888; format < VK_MINIMAL_FILL_FORMAT_COUNT; format++)
+		{
+			LOGI(" %s, %.2f MB per frame\n", vk_minimal_fill_format_name(format),
+			     (double)width * height * vk_minimal_fill_format_bpp(format) / 1e6);
+			for (path = VK_MINIMAL_FILL_SCALAR; path < VK_MINIMAL_FILL_PATH_COUNT; path++)
+			{
+				if (!vk_minimal_fill_path_supported(path))
+					continue;
+
+				int ok = check_path(path, format, width, height);
+				double gbps = bench_fill(path, format, 1, width, height, iterations);
+				LOGI("  %-8s %s %8.2f GB/s %8.1f frames/s\n", vk_minimal_fill_path_name(path), ok ? "ok  " : "FAIL", gbps,
+				     gbps * 1e9 / ((double)width * height * vk_minimal_fill_format_bpp(format)));
+				failed |= !ok;
+			}
+		}
+
+		for (threads = 1; threads <= max_threads; threads++)
+		{
+			double gbps = bench_fill(VK_MINIMAL_FILL_AUTO, VK_MINIMAL_FILL_8888, threads, width, height, iterations);
+			LOGI("  %2u threads  %8.2f GB/s\n", threads, gbps);
+		}
+	}
+
+	return failed;
+}
@@ -0,0 +1,374 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifndef VULKAN_DLFCN_HEADLESS
+#include <xcb/xcb.h>
+#endif
+
+#include "vulkan_dlfcn/vulkan_dlfcn.h"
+#include "vk_minimal.h"
+
+#define LOGI(...) ((void)printf(__VA_ARGS__))
+
+// Runs vk_minimal_draw() a fixed number of times for every combination of
+// resolution, present mode, upload mode and canvas format and prints one CSV
+// line per run.
+// With "policy" as third argument the present policies are iterated instead
+// of the present modes. Built with VULKAN_DLFCN_HEADLESS it renders offscreen
+// and the present mode column reads "none".
+
+struct resolution {
+	uint32_t width;
+	uint32_t height;
+};
+
+static const struct resolution resolutions[] = {
+	{1280, 720},
+	{1920, 1080},
+	{3840, 2160}
+};
+
+#ifndef VULKAN_DLFCN_HEADLESS
+static const VkPresentModeKHR present_modes[] = {
+	VK_PRESENT_MODE_FIFO_KHR,
+	VK_PRESENT_MODE_MAILBOX_KHR,
+	VK_PRESENT_MODE_IMMEDIATE_KHR
+};
+#endif
+
+struct result {
+	uint32_t frames;
+	double fps;
+	double mean_ms;
+	double p50_ms;
+	double p95_ms;
+	double p99_ms;
+	double bytes_per_s;
+	// Present to acquire latency of the swapchain images, 0 when headless
+	double p2a_mean_ms;
+	double p2a_p99_ms;
+};
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *)a;
+	double y = *(const double *)b;
+	return (x > y) - (x < y);
+}
+
+// Nearest rank on sorted samples
+static double percentile(const double *sorted, uint32_t count, double p)
+{
+	uint32_t rank = (uint32_t)(p * count + 0.999999);
+	if (rank == 0)
+		rank = 1;
+	if (rank > count)
+		rank = count;
+	return sorted[rank - 1];
+}
+
+#ifndef VULKAN_DLFCN_HEADLESS
+static int present_mode_supported(VkInstance instance, VkSurfaceKHR surface, VkPresentModeKHR mode)
+{
+	VkResult err;
+	uint32_t gpu_count = 1;
+	VkPhysicalDevice gpu;
+	err = vkEnumeratePhysicalDevices(instance, &gpu_count, &gpu);
+	assert((err == VK_SUCCESS || err == VK_INCOMPLETE) && gpu_count > 0);
+
+	uint32_t count;
+	err = vkGetPhysicalDeviceSurfacePresentModesKHR(gpu, surface, &count, NULL);
+	assert(err == VK_SUCCESS);
+	VkPresentModeKHR modes[count];
+	err = vkGetPhysicalDeviceSurfacePresentModesKHR(gpu, surface, &count, modes);
+	assert(err == VK_SUCCESS);
+
+	uint32_t i;
+	for (i = 0; i < count; i++)
+	{
+		if (modes[i] == mode)
+			return 1;
+	}
+	return 0;
+}
+#endif
+
+static void run(struct vk_minimal_context *actx, uint32_t frames, uint32_t warmup, struct result *res)
+{
+	VkResult err;
+	double *times = malloc(sizeof(times[0]) * frames);
+	double *p2a = malloc(sizeof(p2a[0]) * frames);
+	uint32_t p2a_count = 0;
+	uint64_t bytes = 0;
+	uint32_t i;
+
+	vk_minimal_init(actx);
+
+	for (i = 0; i < warmup; i++)
+	{
+		vk_minimal_draw(actx);
+	}
+
+	double t0 = now();
+	double prev = t0;
+	for (i = 0; i < frames; i++)
+	{
+		vk_minimal_draw(actx);
+		double t = now();
+		times[i] = (t - prev) * 1e3;
+		prev = t;
+		bytes += actx->stats.transfer_bytes;
+		if (actx->stats.present_to_acquire_ns)
+			p2a[p2a_count++] = actx->stats.present_to_acquire_ns * 1e-6;
+	}
+
+	// Include the frames still in flight in the throughput
+	err = actx->dev->vkd.vkDeviceWaitIdle(actx->dev->device);
+	assert(err == VK_SUCCESS);
+	double secs = now() - t0;
+
+	double sum = 0.0;
+	for (i = 0; i < frames; i++)
+	{
+		sum += times[i];
+	}
+	qsort(times, frames, sizeof(times[0]), cmp_double);
+
+	res->frames = frames;
+	res->fps = frames / secs;
+	res->mean_ms = sum / frames;
+	res->p50_ms = percentile(times, frames, 0.50);
+	res->p95_ms = percentile(times, frames, 0.95);
+	res->p99_ms = percentile(times, frames, 0.99);
+	res->bytes_per_s = bytes / secs;
+
+	res->p2a_mean_ms = 0.0;
+	res->p2a_p99_ms = 0.0;
+	if (p2a_count > 0)
+	{
+		sum = 0.0;
+		for (i = 0; i < p2a_count; i++)
+		{
+			sum += p2a[i];
+		}
+		qsort(p2a, p2a_count, sizeof(p2a[0]), cmp_double);
+		res->p2a_mean_ms = sum / p2a_count;
+		res->p2a_p99_ms = percentile(p2a, p2a_count, 0.99);
+	}
+
+	free(p2a);
+	free(times);
+}
+
+static void print_result(const struct vk_minimal_context *actx, const char *policy, const char *present_mode, const struct result *res)
+{
+	LOGI("%u,%u,%s,%s,%s,%s,%s,%u,%.2f,%.4f,%.4f,%.4f,%.4f,%.0f,%.4f,%.4f\n",
+	     actx->extent.width, actx->extent.height, policy, present_mode, vk_minimal_upload_name(actx->upload),
+	     vk_minimal_canvas_format_name(actx->canvas_format),
+	     actx->upload == VK_MINIMAL_UPLOAD_COMPUTE ? "none" : vk_minimal_fill_format_name(actx->canvas.fill_format),
+	     res->frames, res->fps, res->mean_ms, res->p50_ms, res->p95_ms, res->p99_ms, res->bytes_per_s,
+	     res->p2a_mean_ms, res->p2a_p99_ms);
+}
+
+int main(int argc, char **argv)
+{
+	// Load libvulkan.so
+	vulkan_dlfcn_init();
+
+	// Optional arguments select the number of measured and warmup frames and
+	// whether present policies rather than present modes are compared
+	uint32_t frames = 500;
+	uint32_t warmup = 50;
+	int by_policy = 0;
+	if (argc > 1)
+		frames = atoi(argv[1]);
+	if (argc > 2)
+		warmup = atoi(argv[2]);
+	if (argc > 3)
+		by_policy = strcmp(argv[3], "policy") == 0;
+	assert(frames > 0);
+
+	VkResult err;
+	VkApplicationInfo app;
+	app.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+	app.pNext = NULL;
+	app.pApplicationName = NULL;
+	app.applicationVersion = 0;
+	app.pEngineName = NULL;
+	app.engineVersion = 0;
+	app.apiVersion = VK_API_VERSION_1_0;
+
+#ifndef VULKAN_DLFCN_HEADLESS
+	const char *iextensions[] = {
+	  "VK_KHR_surface",
+	  "VK_KHR_xcb_surface"
+	};
+#endif
+
+	VkInstanceCreateInfo inst_info;
+	inst_info.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+	inst_info.pNext = NULL;
+	inst_info.flags = 0;
+	inst_info.pApplicationInfo = &app;
+	inst_info.enabledLayerCount = 0;
+	inst_info.ppEnabledLayerNames = NULL;
+#ifndef VULKAN_DLFCN_HEADLESS
+	inst_info.enabledExtensionCount = sizeof(iextensions)/sizeof(iextensions[0]);
+	inst_info.ppEnabledExtensionNames = iextensions;
+#else
+	inst_info.enabledExtensionCount = 0;
+	inst_info.ppEnabledExtensionNames = NULL;
+#endif
+
+	VkInstance instance;
+	err = vkCreateInstance(&inst_info, NULL, &instance);
+	assert(err == VK_SUCCESS);
+
+#ifndef VULKAN_DLFCN_HEADLESS
+	xcb_connection_t *connection;
+	const xcb_setup_t *setup;
+	xcb_screen_iterator_t iter;
+	int scr;
+
+	connection = xcb_connect(NULL, &scr);
+	assert(connection);
+
+	setup = xcb_get_setup(connection);
+	iter = xcb_setup_roots_iterator(setup);
+	while (scr-- > 0)
+		xcb_screen_next(&iter);
+
+	xcb_screen_t *screen = iter.data;
+#endif
+
+	LOGI("width,height,policy,present_mode,upload,canvas,canvas_layout,frames,fps,mean_ms,p50_ms,p95_ms,p99_ms,upload_bytes_per_s,"
+	     "present_to_acquire_mean_ms,present_to_acquire_p99_ms\n");
+
+	uint32_t r, p, u, c;
+	for (r = 0; r < sizeof(resolutions)/sizeof(resolutions[0]); r++)
+	{
+#ifndef VULKAN_DLFCN_HEADLESS
+		xcb_window_t window = xcb_generate_id(connection);
+		uint32_t value_list[] = {screen->black_pixel};
+
+		xcb_create_window(connection, XCB_COPY_FROM_PARENT, window,
+		                  screen->root, 0, 0, resolutions[r].width, resolutions[r].height, 0,
+		                  XCB_WINDOW_CLASS_INPUT_OUTPUT, screen->root_visual,
+		                  XCB_CW_BACK_PIXEL, value_list);
+		xcb_map_window(connection, window);
+		xcb_flush(connection);
+
+		VkXcbSurfaceCreateInfoKHR asci;
+		asci.sType = VK_STRUCTURE_TYPE_XCB_SURFACE_CREATE_INFO_KHR;
+		asci.pNext = NULL;
+		asci.flags = 0;
+		asci.window = window;
+		asci.connection = connection;
+
+		VkSurfaceKHR surface;
+		err = vkCreateXcbSurfaceKHR(instance, &asci, NULL, &surface);
+		assert(err == VK_SUCCESS);
+
+		uint32_t present_count = by_policy ? VK_MINIMAL_PRESENT_POLICY_COUNT : sizeof(present_modes)/sizeof(present_modes[0]);
+		for (p = 0; p < present_count; p++)
+		{
+			if (!by_policy && !present_mode_supported(instance, surface, present_modes[p]))
+				continue;
+#else
+		(void)by_policy;
+		for (p = 0; p < 1; p++)
+		{
+#endif
+			for (u = 0; u < VK_MINIMAL_UPLOAD_COUNT; u++)
+			{
+				// The compute shader doesn't use a canvas
+				uint32_t canvas_count = u == VK_MINIMAL_UPLOAD_COMPUTE ? 1 : VK_MINIMAL_CANVAS_FORMAT_COUNT;
+				for (c = 0; c < canvas_count; c++)
+				{
+					struct vk_minimal_context actx;
+					struct result res;
+					memset(&actx, 0, sizeof(actx));
+					actx.instance = instance;
+					actx.upload = u;
+					actx.canvas_format = c;
+#ifndef VULKAN_DLFCN_HEADLESS
+					actx.surface = surface;
+					if (by_policy)
+					{
+						actx.present_policy = p;
+					}
+					else
+					{
+						actx.present_mode_override = VK_TRUE;
+						actx.present_mode = present_modes[p];
+					}
+#else
+					actx.surface = VK_NULL_HANDLE;
+					actx.extent.width = resolutions[r].width;
+					actx.extent.height = resolutions[r].height;
+#endif
+
+					run(&actx, frames, warmup, &res);
+#ifndef VULKAN_DLFCN_HEADLESS
+					print_result(&actx, by_policy ? vk_minimal_present_policy_name(p) : "override",
+					             vk_minimal_present_mode_name(actx.present_mode), &res);
+#else
+					print_result(&actx, "none", "none", &res);
+#endif
+					fflush(stdout);
+
+					vk_minimal_destroy(&actx);
+				}
+			}
+		}
+
+#ifndef VULKAN_DLFCN_HEADLESS
+		vkDestroySurfaceKHR(instance, surface, NULL);
+		xcb_destroy_window(connection, window);
+		xcb_flush(connection);
+#endif
+	}
+
+#ifndef VULKAN_DLFCN_HEADLESS
+	xcb_disconnect(connection);
+#endif
+	vkDestroyInstance(instance, NULL);
+
+	return 0;
+}
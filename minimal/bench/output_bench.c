@@ -0,0 +1,240 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifndef VULKAN_DLFCN_HEADLESS
+#include <xcb/xcb.h>
+#endif
+
+#include "vulkan_dlfcn/vulkan_dlfcn.h"
+#include "vk_minimal.h"
+
+#define LOGI(...) ((void)printf(__VA_ARGS__))
+
+// Drives 1, 2, 4, ... outputs from one shared device and prints one CSV line
+// per output count, once with all outputs going out in one submit and
+// present and once with a vk_minimal_draw() per output. Built with
+// VULKAN_DLFCN_HEADLESS the outputs render offscreen.
+
+#define OUTPUT_WIDTH 640
+#define OUTPUT_HEIGHT 360
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Returns the wall time of one round through all outputs in ms
+static double run(struct vk_minimal_context **actxs, uint32_t outputs, uint32_t frames, int batched, double *cpu_ms)
+{
+	VkResult err;
+	uint64_t cpu_ns = 0;
+	uint32_t i, j;
+
+	double t0 = now();
+	for (i = 0; i < frames; i++)
+	{
+		if (batched)
+		{
+			vk_minimal_draw_many(actxs, outputs);
+		}
+		else
+		{
+			for (j = 0; j < outputs; j++)
+			{
+				vk_minimal_draw(actxs[j]);
+			}
+		}
+		for (j = 0; j < outputs; j++)
+		{
+			cpu_ns += actxs[j]->stats.cpu_ns;
+		}
+	}
+
+	// Include the frames still in flight
+	err = actxs[0]->dev->vkd.vkDeviceWaitIdle(actxs[0]->dev->device);
+	assert(err == VK_SUCCESS);
+
+	*cpu_ms = cpu_ns * 1e-6 / frames;
+	return (now() - t0) * 1e3 / frames;
+}
+
+int main(int argc, char **argv)
+{
+	// Load libvulkan.so
+	vulkan_dlfcn_init();
+
+	// Optional arguments select the largest number of outputs and the number
+	// of measured frames
+	uint32_t max_outputs = 8;
+	uint32_t frames = 300;
+	if (argc > 1)
+		max_outputs = atoi(argv[1]);
+	if (argc > 2)
+		frames = atoi(argv[2]);
+	assert(max_outputs > 0 && frames > 0);
+
+	VkResult err;
+	VkApplicationInfo app;
+	app.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+	app.pNext = NULL;
+	app.pApplicationName = NULL;
+	app.applicationVersion = 0;
+	app.pEngineName = NULL;
+	app.engineVersion = 0;
+	app.apiVersion = VK_API_VERSION_1_0;
+
+#ifndef VULKAN_DLFCN_HEADLESS
+	const char *iextensions[] = {
+	  "VK_KHR_surface",
+	  "VK_KHR_xcb_surface"
+	};
+#endif
+
+	VkInstanceCreateInfo inst_info;
+	inst_info.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+	inst_info.pNext = NULL;
+	inst_info.flags = 0;
+	inst_info.pApplicationInfo = &app;
+	inst_info.enabledLayerCount = 0;
+	inst_info.ppEnabledLayerNames = NULL;
+#ifndef VULKAN_DLFCN_HEADLESS
+	inst_info.enabledExtensionCount = sizeof(iextensions)/sizeof(iextensions[0]);
+	inst_info.ppEnabledExtensionNames = iextensions;
+#else
+	inst_info.enabledExtensionCount = 0;
+	inst_info.ppEnabledExtensionNames = NULL;
+#endif
+
+	VkInstance instance;
+	err = vkCreateInstance(&inst_info, NULL, &instance);
+	assert(err == VK_SUCCESS);
+
+	VkSurfaceKHR *surfaces = calloc(max_outputs, sizeof(surfaces[0]));
+	uint32_t i, outputs;
+
+#ifndef VULKAN_DLFCN_HEADLESS
+	xcb_connection_t *connection;
+	const xcb_setup_t *setup;
+	xcb_screen_iterator_t iter;
+	int scr;
+
+	connection = xcb_connect(NULL, &scr);
+	assert(connection);
+
+	setup = xcb_get_setup(connection);
+	iter = xcb_setup_roots_iterator(setup);
+	while (scr-- > 0)
+		xcb_screen_next(&iter);
+
+	xcb_screen_t *screen = iter.data;
+
+	// One window per output, tiled so they don't cover each other
+	for (i = 0; i < max_outputs; i++)
+	{
+		xcb_window_t window = xcb_generate_id(connection);
+		uint32_t value_list[] = {screen->black_pixel};
+
+		xcb_create_window(connection, XCB_COPY_FROM_PARENT, window,
+		                  screen->root, (i % 4) * OUTPUT_WIDTH, (i / 4) * OUTPUT_HEIGHT, OUTPUT_WIDTH, OUTPUT_HEIGHT, 0,
+		                  XCB_WINDOW_CLASS_INPUT_OUTPUT, screen->root_visual,
+		                  XCB_CW_BACK_PIXEL, value_list);
+		xcb_map_window(connection, window);
+
+		VkXcbSurfaceCreateInfoKHR asci;
+		asci.sType = VK_STRUCTURE_TYPE_XCB_SURFACE_CREATE_INFO_KHR;
+		asci.pNext = NULL;
+		asci.flags = 0;
+		asci.window = window;
+		asci.connection = connection;
+
+		err = vkCreateXcbSurfaceKHR(instance, &asci, NULL, &surfaces[i]);
+		assert(err == VK_SUCCESS);
+	}
+	xcb_flush(connection);
+#endif
+
+	struct vk_minimal_device dev;
+	vk_minimal_device_init(&dev, instance, surfaces[0], 0, VK_FALSE, VK_FALSE);
+
+	struct vk_minimal_context *ctxs = calloc(max_outputs, sizeof(ctxs[0]));
+	struct vk_minimal_context **actxs = calloc(max_outputs, sizeof(actxs[0]));
+
+	LOGI("outputs,submit,frames,round_ms,per_output_ms,cpu_ms\n");
+
+	for (outputs = 1; outputs <= max_outputs; outputs *= 2)
+	{
+		for (i = 0; i < outputs; i++)
+		{
+			struct vk_minimal_context *actx = &ctxs[i];
+			memset(actx, 0, sizeof(*actx));
+			actx->dev = &dev;
+			actx->surface = surfaces[i];
+			actx->extent.width = OUTPUT_WIDTH;
+			actx->extent.height = OUTPUT_HEIGHT;
+			actx->fill_threads = 1;
+			vk_minimal_init(actx);
+			actxs[i] = actx;
+		}
+
+		int batched;
+		for (batched = 1; batched >= 0; batched--)
+		{
+			double cpu_ms;
+
+			// Warm up, the first round through the images records every buffer
+			run(actxs, outputs, 50, batched, &cpu_ms);
+			double round_ms = run(actxs, outputs, frames, batched, &cpu_ms);
+			LOGI("%u,%s,%u,%.4f,%.4f,%.4f\n", outputs, batched ? "batched" : "separate", frames,
+			     round_ms, round_ms / outputs, cpu_ms);
+		}
+
+		for (i = 0; i < outputs; i++)
+		{
+			vk_minimal_destroy(actxs[i]);
+		}
+	}
+
+	vk_minimal_device_destroy(&dev);
+	for (i = 0; i < max_outputs; i++)
+	{
+		if (surfaces[i])
+			vkDestroySurfaceKHR(instance, surfaces[i], NULL);
+	}
+	vkDestroyInstance(instance, NULL);
+	free(actxs);
+	free(ctxs);
+	free(surfaces);
+
+	return 0;
+}
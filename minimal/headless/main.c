@@ -0,0 +1,206 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "vulkan_dlfcn/vulkan_dlfcn.h"
+#include "vk_minimal.h"
+
+#define LOGI(...) ((void)printf(__VA_ARGS__))
+
+static int cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a;
+	uint64_t y = *(const uint64_t *)b;
+	return (x > y) - (x < y);
+}
+
+// Nearest rank on sorted samples
+static uint64_t percentile(const uint64_t *sorted, uint32_t count, double p)
+{
+	uint32_t rank = (uint32_t)(p * count + 0.999999);
+	if (rank == 0)
+		rank = 1;
+	if (rank > count)
+		rank = count;
+	return sorted[rank - 1];
+}
+
+// Runs the same init/draw pipeline as the windowed front-ends but without
+// a surface, for machines that have no display (e.g. lavapipe on a server).
+int main(int argc, char **argv)
+{
+	struct timespec t0, t1;
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+
+	// Load libvulkan.so
+	vulkan_dlfcn_init();
+
+	struct vk_minimal_context actx;
+	memset(&actx, 0, sizeof(actx));
+
+	// Optional arguments select the number of frames, upload mode, extent, a
+	// file for the per frame timings, JSON if it ends in .json and CSV
+	// otherwise, and a file to capture the frames to, PPM if it ends in .ppm,
+	// raw if in .raw and indexed otherwise
+	uint32_t count = 1000;
+	if (argc > 1)
+		count = atoi(argv[1]);
+	if (argc > 2)
+		actx.upload = atoi(argv[2]);
+	if (argc > 4)
+	{
+		actx.extent.width = atoi(argv[3]);
+		actx.extent.height = atoi(argv[4]);
+	}
+
+	FILE *prof_file = NULL;
+	int prof_json = 0;
+	if (argc > 5)
+	{
+		size_t len = strlen(argv[5]);
+		prof_file = fopen(argv[5], "w");
+		assert(prof_file);
+		prof_json = len > 5 && strcmp(argv[5] + len - 5, ".json") == 0;
+		if (!prof_json)
+			vk_minimal_prof_write_csv(prof_file, NULL, 0, 1);
+	}
+	if (argc > 6)
+	{
+		size_t len = strlen(argv[6]);
+		actx.capture_path = argv[6];
+		if (len > 4 && strcmp(argv[6] + len - 4, ".ppm") == 0)
+			actx.capture_container = VK_MINIMAL_CAPTURE_PPM;
+		else if (len > 4 && strcmp(argv[6] + len - 4, ".raw") == 0)
+			actx.capture_container = VK_MINIMAL_CAPTURE_RAW;
+		else
+			actx.capture_container = VK_MINIMAL_CAPTURE_INDEXED;
+	}
+
+	VkResult err;
+	VkApplicationInfo app;
+	app.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+	app.pNext = NULL;
+	app.pApplicationName = NULL;
+	app.applicationVersion = 0;
+	app.pEngineName = NULL;
+	app.engineVersion = 0;
+	app.apiVersion = VK_API_VERSION_1_0;
+
+	VkInstanceCreateInfo inst_info;
+	inst_info.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+	inst_info.pNext = NULL;
+	inst_info.flags = 0;
+	inst_info.pApplicationInfo = &app;
+	inst_info.enabledLayerCount = 0;
+	inst_info.ppEnabledLayerNames = NULL;
+	inst_info.enabledExtensionCount = 0;
+	inst_info.ppEnabledExtensionNames = NULL;
+
+	err = vkCreateInstance(&inst_info, NULL, &actx.instance);
+	assert(err == VK_SUCCESS);
+
+	actx.surface = VK_NULL_HANDLE;
+	vk_minimal_init(&actx);
+
+	// Symbol lookup, instance and device creation, with lazy lookup only
+	// what was called so far has been resolved
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+#ifdef VULKAN_DLFCN_LAZY
+	const char *lookup = "lazy";
+#else
+	const char *lookup = "eager";
+#endif
+	LOGI("startup: %.3f ms with %s symbol lookup\n", (t1.tv_sec - t0.tv_sec) * 1e3 + (t1.tv_nsec - t0.tv_nsec) * 1e-6, lookup);
+
+	uint32_t frames;
+	// CPU time of every frame that was submitted, dropped ones leave the
+	// stats as they were
+	uint64_t *cpu_ns = malloc(sizeof(cpu_ns[0]) * (count ? count : 1));
+	uint64_t cpu_total_ns = 0;
+	uint32_t cpu_count = 0;
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+
+	for (frames = 0; frames < count; frames++)
+	{
+		uint64_t submitted = actx.frame_count;
+		vk_minimal_draw(&actx);
+		if (actx.frame_count != submitted)
+		{
+			cpu_ns[cpu_count++] = actx.stats.cpu_ns;
+			cpu_total_ns += actx.stats.cpu_ns;
+		}
+
+		if (prof_file)
+		{
+			struct vk_minimal_prof_sample samples[VK_MINIMAL_PROF_RING_SIZE];
+			uint32_t n = vk_minimal_prof_drain(&actx.prof, samples, VK_MINIMAL_PROF_RING_SIZE);
+			if (prof_json)
+				vk_minimal_prof_write_json(prof_file, samples, n);
+			else
+				vk_minimal_prof_write_csv(prof_file, samples, n, 0);
+		}
+	}
+
+	err = actx.dev->vkd.vkDeviceWaitIdle(actx.dev->device);
+	assert(err == VK_SUCCESS);
+
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	double secs = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) * 1e-9;
+	qsort(cpu_ns, cpu_count, sizeof(cpu_ns[0]), cmp_u64);
+	LOGI("%s, %ux%u, %u frames in %.3f s: %.1f frames/s, %llu command buffers recorded, %llu bytes transferred in total\n",
+	     vk_minimal_upload_name(actx.upload), actx.extent.width, actx.extent.height, frames, secs, frames / secs,
+	     (unsigned long long)actx.stats.recordings, (unsigned long long)actx.stats.transfer_bytes_total);
+	if (cpu_count > 0)
+		LOGI("CPU per frame: %.3f ms mean, %.3f ms p50, %.3f ms p99, %.3f ms max over %u frames\n",
+		     cpu_total_ns * 1e-6 / cpu_count, percentile(cpu_ns, cpu_count, 0.50) * 1e-6, percentile(cpu_ns, cpu_count, 0.99) * 1e-6,
+		     cpu_ns[cpu_count - 1] * 1e-6, cpu_count);
+	free(cpu_ns);
+
+	struct vk_minimal_alloc_stats mem;
+	vk_minimal_alloc_get_stats(&actx.dev->allocator, &mem);
+	LOGI("memory: %u blocks, %u allocations, %.1f MiB reserved, %.1f MiB used, %u free ranges, fragmentation %.3f\n",
+	     mem.blocks, mem.allocations, mem.reserved / 1048576.0, mem.used / 1048576.0, mem.free_ranges, mem.fragmentation);
+
+	if (actx.capture_container)
+	{
+		// Destroying writes out what is still in flight
+		uint64_t captured = actx.stats.captured;
+		uint64_t dropped = actx.stats.capture_dropped;
+		vk_minimal_destroy(&actx);
+		LOGI("capture: %llu frames captured, %llu dropped\n", (unsigned long long)captured, (unsigned long long)dropped);
+	}
+
+	if (prof_file)
+		fclose(prof_file);
+
+	return 0;
+}
@@ -27,27 +27,110 @@ For more information, please refer to <http://unlicense.org>
 
 #include "vk_minimal.h"
 #include <assert.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include "vulkan_dlfcn/vulkan_dlfcn.h"
 
+// SPIR-V generated from vk_minimal_grid.comp by the build
+#include "vk_minimal_grid.comp.h"
+
+#if __ANDROID__
+
+#include <android/log.h>
+#define  LOG_TAG    "vk-minimal"
+#define  LOGI(...)  __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
+
+#else
+
+#include <stdio.h>
+#define  LOGI(...) printf("I:"__VA_ARGS__)
+
+#endif
+
 static VkExtent3D extent_2d_to_3d(VkExtent2D e)
 {
 	VkExtent3D e3 = {e.width, e.height, 1};
 	return e3;
 }
 
-static uint32_t get_memory_type_idx(VkPhysicalDevice device, uint32_t typebits, VkFlags properties)
+static uint32_t popcount(uint32_t v)
+{
+	return __builtin_popcount(v);
+}
+
+// Higher is better. Explicitly preferred and avoided flags weigh more than
+// what the access pattern suggests, a larger heap breaks ties.
+static int64_t score_memory_type(const VkPhysicalDeviceMemoryProperties *pdmp, uint32_t idx,
+                                 VkMemoryPropertyFlags preferred, VkMemoryPropertyFlags avoided, enum vk_minimal_mem_access access)
+{
+	static const VkMemoryPropertyFlags access_preferred[VK_MINIMAL_MEM_ACCESS_COUNT] = {
+		// Device local host visible memory (resizable BAR) saves the GPU a trip over the bus
+		[VK_MINIMAL_MEM_GPU_ONLY] = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		[VK_MINIMAL_MEM_SEQUENTIAL_WRITE] = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		[VK_MINIMAL_MEM_RANDOM_READ] = VK_MEMORY_PROPERTY_HOST_CACHED_BIT,
+		[VK_MINIMAL_MEM_READBACK] = VK_MEMORY_PROPERTY_HOST_CACHED_BIT
+	};
+	static const VkMemoryPropertyFlags access_avoided[VK_MINIMAL_MEM_ACCESS_COUNT] = {
+		// Leave the host visible types to the resources that need them
+		[VK_MINIMAL_MEM_GPU_ONLY] = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+		// Streaming stores go through write combining, caching only adds snooping
+		[VK_MINIMAL_MEM_SEQUENTIAL_WRITE] = VK_MEMORY_PROPERTY_HOST_CACHED_BIT,
+		[VK_MINIMAL_MEM_RANDOM_READ] = 0,
+		// Host reads from device memory are slow
+		[VK_MINIMAL_MEM_READBACK] = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+	};
+	VkMemoryPropertyFlags flags = pdmp->memoryTypes[idx].propertyFlags;
+	VkDeviceSize heap_size = pdmp->memoryHeaps[pdmp->memoryTypes[idx].heapIndex].size;
+
+	int64_t score = 0;
+	score += 8 * (int64_t)popcount(flags & preferred);
+	score -= 8 * (int64_t)popcount(flags & avoided);
+	score += 4 * (int64_t)popcount(flags & access_preferred[access]);
+	score -= 4 * (int64_t)popcount(flags & access_avoided[access]);
+
+	return (score << 40) + (int64_t)(heap_size >> 24);
+}
+
+// Sub-allocates from the best ranked memory type that has the required
+// flags, falling back to the next one when a heap is exhausted (e.g. a small BAR)
+static uint32_t allocate_memory(struct vk_minimal_context *actx, const VkMemoryRequirements *mr,
+                                VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred, VkMemoryPropertyFlags avoided,
+                                enum vk_minimal_mem_access access, enum vk_minimal_alloc_kind kind, struct vk_minimal_allocation *out)
 {
-	VkPhysicalDeviceMemoryProperties pdmp;
-	vkGetPhysicalDeviceMemoryProperties(device, &pdmp);
+	const VkPhysicalDeviceMemoryProperties *pdmp = &actx->dev->mem_props;
+	uint32_t candidates = 0;
 	uint32_t i;
-	for (i = 0; i < pdmp.memoryTypeCount; i++)
+
+	assert(access < VK_MINIMAL_MEM_ACCESS_COUNT);
+	for (i = 0; i < pdmp->memoryTypeCount; i++)
+	{
+		if ((mr->memoryTypeBits & (1 << i)) && (pdmp->memoryTypes[i].propertyFlags & required) == required)
+			candidates |= 1 << i;
+	}
+
+	while (candidates)
 	{
-		if ((typebits & (1 << i)) && (pdmp.memoryTypes[i].propertyFlags & properties) == properties)
+		uint32_t best = 0;
+		int64_t best_score = INT64_MIN;
+		for (i = 0; i < pdmp->memoryTypeCount; i++)
 		{
-			return i;
+			if (!(candidates & (1 << i)))
+				continue;
+			int64_t score = score_memory_type(pdmp, i, preferred, avoided, access);
+			if (score > best_score)
+			{
+				best = i;
+				best_score = score;
+			}
 		}
+
+		VkResult err = vk_minimal_alloc(&actx->dev->allocator, best, mr, kind, out);
+		if (err == VK_SUCCESS)
+			return best;
+		assert(err == VK_ERROR_OUT_OF_DEVICE_MEMORY || err == VK_ERROR_OUT_OF_HOST_MEMORY || err == VK_ERROR_TOO_MANY_OBJECTS);
+		candidates &= ~(1 << best);
 	}
 
 	assert(0 && "requested memory not found");
@@ -55,328 +138,2012 @@ static uint32_t get_memory_type_idx(VkPhysicalDevice device, uint32_t typebits,
 	return 0;
 }
 
-static void draw_grid(struct vk_minimal_context *actx, VkSubresourceLayout *layout, void *rgba_data)
+static struct vk_minimal_rect full_rect(struct vk_minimal_context *actx)
+{
+	struct vk_minimal_rect r = {0, 0, actx->extent.width, actx->extent.height};
+	return r;
+}
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static uint32_t grid_color(uint32_t cntr)
+{
+	return 0x01010101 * (0xff & cntr);
+}
+
+static void damage_grid_lines(struct vk_minimal_context *actx)
 {
-	uint32_t color = 0x01010101 * (0xff & actx->cntr++);
 	uint32_t x, y;
 
-	rgba_data += layout->offset;
-	for (y = 0; y < actx->extent.height; y++)
+	// Only the lines change with the color, the background stays black
+	for (y = 0; y < actx->extent.height; y += VK_MINIMAL_GRID_SPACING)
 	{
-		for (x = 0; x < actx->extent.width; x++)
-		{
-			((uint32_t *)rgba_data)[x] = (x % 100 == 0 || y % 100 == 0) ? color : 0x0;
-		}
-		rgba_data += layout->rowPitch;
+		struct vk_minimal_rect r = {0, y, actx->extent.width, y + 1};
+		vk_minimal_damage_add(&actx->damage, r);
+	}
+	for (x = 0; x < actx->extent.width; x += VK_MINIMAL_GRID_SPACING)
+	{
+		struct vk_minimal_rect r = {x, 0, x + 1, actx->extent.height};
+		vk_minimal_damage_add(&actx->damage, r);
 	}
 }
 
-void vk_minimal_init(struct vk_minimal_context *actx)
+static void draw_grid(struct vk_minimal_context *actx, struct vk_minimal_frame *frame)
 {
-	VkResult err;
-	uint32_t gpu_count;
-	err = vkEnumeratePhysicalDevices(actx->instance, &gpu_count, NULL);
-	assert(err == VK_SUCCESS && gpu_count > 0);
+	uint32_t color = grid_color(actx->cntr++);
+
+	if (color != actx->fill.color)
+		damage_grid_lines(actx);
+	vk_minimal_fill_grid_prepare(&actx->fill, color);
+
+	// The grid comes back where the last frame drew over it, unless that is
+	// drawn again
+	vk_minimal_damage_union(&actx->damage, &actx->batch.drawn);
+	vk_minimal_damage_union(&actx->damage, &actx->batch.damage);
+
+	// Repaint what this canvas missed together with what changed now, the
+	// batch composes the grid on the rows it draws so no pixel is written
+	// twice. Returns only once every band is written, before the copy is
+	// recorded.
+	vk_minimal_damage_union(&frame->damage, &actx->damage);
+	vk_minimal_batch_draw(&actx->batch, &actx->fill, &actx->pool, &frame->damage,
+	                      frame->canvas.data + frame->canvas.layout.offset, frame->canvas.row_pitch);
+}
 
-	VkPhysicalDevice physical_devices[gpu_count];
-	err = vkEnumeratePhysicalDevices(actx->instance, &gpu_count, physical_devices);
-	assert(err == VK_SUCCESS);
-	const VkPhysicalDevice gpu = physical_devices[0];
+static void compute_grid(struct vk_minimal_context *actx)
+{
+	// The whole storage image is regenerated on the GPU, only the lines are
+	// copied on to the swapchain images
+	if (grid_color(actx->cntr) != grid_color(actx->compute.cntr))
+		damage_grid_lines(actx);
+	actx->compute.cntr = actx->cntr++;
+}
 
-	uint32_t queue_count;
-	vkGetPhysicalDeviceQueueFamilyProperties(gpu, &queue_count, NULL);
-	assert(queue_count > 0);
+// Picks the format the canvases are held in. Copies need the same size class
+// on both ends, converting from a 16 bit canvas takes a blit, and blits need
+// an image to read from and a queue with graphics.
+static void choose_canvas(struct vk_minimal_context *actx)
+{
+	// B4G4R4A4 rather than R4G4B4A4, it is the one with mandatory blit support
+	static const VkFormat formats[VK_MINIMAL_CANVAS_FORMAT_COUNT] = {
+		VK_FORMAT_UNDEFINED,
+		VK_FORMAT_R5G6B5_UNORM_PACK16,
+		VK_FORMAT_B4G4R4A4_UNORM_PACK16
+	};
+	static const enum vk_minimal_fill_format packed[VK_MINIMAL_CANVAS_FORMAT_COUNT] = {
+		VK_MINIMAL_FILL_8888,
+		VK_MINIMAL_FILL_565,
+		VK_MINIMAL_FILL_4444
+	};
+	static const enum vk_minimal_fill_format expanded[VK_MINIMAL_CANVAS_FORMAT_COUNT] = {
+		VK_MINIMAL_FILL_8888,
+		VK_MINIMAL_FILL_565_AS_8888,
+		VK_MINIMAL_FILL_4444_AS_8888
+	};
+	VkFormatProperties src, dst;
+	VkFormatFeatureFlags src_features = 0;
+
+	assert(actx->canvas_format < VK_MINIMAL_CANVAS_FORMAT_COUNT);
+	actx->canvas.format = actx->swapchain.format;
+	actx->canvas.bpp = sizeof(uint32_t);
+	actx->canvas.blit = VK_FALSE;
+	actx->canvas.fill_format = expanded[actx->canvas_format];
+	if (actx->canvas_format == VK_MINIMAL_CANVAS_NATIVE || actx->upload == VK_MINIMAL_UPLOAD_COMPUTE)
+		return;
+
+	actx->dev->vki.vkGetPhysicalDeviceFormatProperties(actx->dev->gpu, formats[actx->canvas_format], &src);
+	actx->dev->vki.vkGetPhysicalDeviceFormatProperties(actx->dev->gpu, actx->swapchain.format, &dst);
+	switch (actx->upload)
+	{
+		case VK_MINIMAL_UPLOAD_LINEAR_IMAGE:
+		src_features = src.linearTilingFeatures;
+		break;
 
-	VkQueueFamilyProperties queue_props[queue_count];
-	vkGetPhysicalDeviceQueueFamilyProperties(gpu, &queue_count, queue_props);
-	assert(queue_props[0].queueFlags & VK_QUEUE_GRAPHICS_BIT);
-	if (vkGetPhysicalDeviceSurfaceSupportKHR)
+		case VK_MINIMAL_UPLOAD_BUFFER_OPTIMAL:
+		src_features = src.optimalTilingFeatures;
+		break;
+
+		default:
+		// Nothing to blit from, the buffer is copied straight into the swapchain
+		break;
+	}
+
+	if ((src_features & VK_FORMAT_FEATURE_BLIT_SRC_BIT) && (dst.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_DST_BIT) &&
+	    (actx->dev->upload_flags & VK_QUEUE_GRAPHICS_BIT))
 	{
-		VkBool32 supported;
-		vkGetPhysicalDeviceSurfaceSupportKHR(gpu, 0, actx->surface, &supported);
-		assert(supported);
+		actx->canvas.format = formats[actx->canvas_format];
+		actx->canvas.bpp = sizeof(uint16_t);
+		actx->canvas.blit = VK_TRUE;
+		actx->canvas.fill_format = packed[actx->canvas_format];
 	}
 
-	float queue_priorities[] = {1.0};
-	VkDeviceQueueCreateInfo dqci;
-	memset(&dqci, 0, sizeof(dqci));
-	dqci.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-	dqci.pNext = NULL;
-	dqci.queueFamilyIndex = 0;
-	dqci.queueCount = 1;
-	dqci.pQueuePriorities = queue_priorities;
+	LOGI("Canvas %s, %s\n", vk_minimal_canvas_format_name(actx->canvas_format),
+	     actx->canvas.blit ? "blitted to the swapchain" : "converted on the CPU");
+}
 
-	const char *dextensions[] = {
-	  "VK_KHR_swapchain"
-	};
+static void create_canvas(struct vk_minimal_context *actx, VkFormat format, struct vk_minimal_frame *frame)
+{
+	VkResult err;
+	VkMemoryRequirements mr;
 
-	VkDeviceCreateInfo dci;
-	memset(&dci, 0, sizeof(dci));
-	dci.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-	dci.pNext = NULL;
-	dci.queueCreateInfoCount = 1;
-	dci.pQueueCreateInfos = &dqci;
-	dci.enabledLayerCount = 0;
-	dci.ppEnabledLayerNames = NULL;
-	dci.enabledExtensionCount = sizeof(dextensions)/sizeof(dextensions[0]);
-	dci.ppEnabledExtensionNames = dextensions;
-	dci.pEnabledFeatures = NULL;
+	if (actx->upload == VK_MINIMAL_UPLOAD_LINEAR_IMAGE)
+	{
+		VkImageCreateInfo ici;
+		memset(&ici, 0, sizeof(ici));
+		ici.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		ici.pNext = NULL;
+		ici.imageType = VK_IMAGE_TYPE_2D;
+		ici.format = format;
+		ici.extent = extent_2d_to_3d(actx->extent);
+		ici.mipLevels = 1;
+		ici.arrayLayers = 1;
+		ici.samples = VK_SAMPLE_COUNT_1_BIT;
+		ici.tiling = VK_IMAGE_TILING_LINEAR;
+		ici.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+		ici.flags = 0;
+		ici.initialLayout = VK_IMAGE_LAYOUT_PREINITIALIZED;
+
+		err = actx->dev->vkd.vkCreateImage(actx->dev->device, &ici, NULL, &frame->canvas.image);
+		assert(err == VK_SUCCESS);
 
-	err = vkCreateDevice(gpu, &dci, NULL, &actx->device);
-	assert(err == VK_SUCCESS);
+		actx->dev->vkd.vkGetImageMemoryRequirements(actx->dev->device, frame->canvas.image, &mr);
+	}
+	else
+	{
+		// Rows are padded to what the device copies from most efficiently
+		VkDeviceSize align = actx->dev->props.limits.optimalBufferCopyRowPitchAlignment;
+		if (align < actx->canvas.bpp)
+			align = actx->canvas.bpp;
+
+		memset(&frame->canvas.layout, 0, sizeof(frame->canvas.layout));
+		frame->canvas.layout.offset = 0;
+		frame->canvas.layout.rowPitch = (actx->extent.width * actx->canvas.bpp + align - 1) / align * align;
+		frame->canvas.layout.size = frame->canvas.layout.rowPitch * actx->extent.height;
+
+		VkBufferCreateInfo bci;
+		memset(&bci, 0, sizeof(bci));
+		bci.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bci.pNext = NULL;
+		bci.flags = 0;
+		bci.size = frame->canvas.layout.size;
+		bci.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+		bci.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		err = actx->dev->vkd.vkCreateBuffer(actx->dev->device, &bci, NULL, &frame->canvas.buffer);
+		assert(err == VK_SUCCESS);
 
-	vkGetDeviceQueue(actx->device, 0, 0, &actx->queue);
+		actx->dev->vkd.vkGetBufferMemoryRequirements(actx->dev->device, frame->canvas.buffer, &mr);
+	}
 
-	VkSurfaceCapabilitiesKHR surf_cap;
-	err = vkGetPhysicalDeviceSurfaceCapabilitiesKHR(gpu, actx->surface, &surf_cap);
-	assert(err == VK_SUCCESS);
-	assert(surf_cap.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT);
-	actx->extent = surf_cap.currentExtent;
+	// Only ever written by the fill, with streaming stores
+	frame->canvas.size = mr.size;
+	uint32_t type = allocate_memory(actx, &mr, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, 0, 0, VK_MINIMAL_MEM_SEQUENTIAL_WRITE,
+	                                VK_MINIMAL_ALLOC_LINEAR, &frame->canvas.mem);
 
-	uint32_t formatCount;
-	err = vkGetPhysicalDeviceSurfaceFormatsKHR(gpu, actx->surface, &formatCount, NULL);
-	assert(err == VK_SUCCESS && formatCount > 0);
-	VkSurfaceFormatKHR surfFormats[formatCount];
-	err = vkGetPhysicalDeviceSurfaceFormatsKHR(gpu, actx->surface, &formatCount, surfFormats);
-	assert(err == VK_SUCCESS);
+	if (frame->canvas.image)
+	{
+		err = actx->dev->vkd.vkBindImageMemory(actx->dev->device, frame->canvas.image, frame->canvas.mem.memory, frame->canvas.mem.offset);
+		assert(err == VK_SUCCESS);
 
-	uint32_t presentModeCount;
-	err = vkGetPhysicalDeviceSurfacePresentModesKHR(gpu, actx->surface, &presentModeCount, NULL);
-	assert(err == VK_SUCCESS && presentModeCount > 0);
-	VkPresentModeKHR presentModes[presentModeCount];
-	err = vkGetPhysicalDeviceSurfacePresentModesKHR(gpu, actx->surface, &presentModeCount, presentModes);
+		VkImageSubresource is;
+		memset(&is, 0, sizeof(is));
+		is.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		is.mipLevel = 0;
+		is.arrayLayer = 0;
+
+		actx->dev->vkd.vkGetImageSubresourceLayout(actx->dev->device, frame->canvas.image, &is, &frame->canvas.layout);
+	}
+	else
+	{
+		err = actx->dev->vkd.vkBindBufferMemory(actx->dev->device, frame->canvas.buffer, frame->canvas.mem.memory, frame->canvas.mem.offset);
+		assert(err == VK_SUCCESS);
+	}
+	frame->canvas.row_pitch = frame->canvas.layout.rowPitch;
+
+	frame->canvas.coherent = (actx->dev->mem_props.memoryTypes[type].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+
+	// The block the canvas lives in is mapped for as long as it exists
+	frame->canvas.data = frame->canvas.mem.data;
+	assert(frame->canvas.data);
+}
+
+static void create_optimal(struct vk_minimal_context *actx, VkFormat format)
+{
+	VkResult err;
+	VkImageCreateInfo ici;
+	memset(&ici, 0, sizeof(ici));
+	ici.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	ici.pNext = NULL;
+	ici.imageType = VK_IMAGE_TYPE_2D;
+	ici.format = format;
+	ici.extent = extent_2d_to_3d(actx->extent);
+	ici.mipLevels = 1;
+	ici.arrayLayers = 1;
+	ici.samples = VK_SAMPLE_COUNT_1_BIT;
+	ici.tiling = VK_IMAGE_TILING_OPTIMAL;
+	ici.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	ici.flags = 0;
+	ici.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+	err = actx->dev->vkd.vkCreateImage(actx->dev->device, &ici, NULL, &actx->optimal.image);
 	assert(err == VK_SUCCESS);
 
-	VkSwapchainCreateInfoKHR sci;
-	memset(&sci, 0, sizeof(sci));
-	sci.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
-	sci.pNext = NULL;
-	sci.surface = actx->surface;
-	sci.minImageCount = 3;
-	sci.imageFormat = surfFormats[0].format;
-	sci.imageColorSpace = surfFormats[0].colorSpace;
-	sci.imageExtent = actx->extent;
-	sci.imageUsage = VK_IMAGE_USAGE_TRANSFER_DST_BIT;
-	sci.preTransform = surf_cap.currentTransform;
-	sci.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
-	sci.imageArrayLayers = 1;
-	sci.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
-	sci.queueFamilyIndexCount = 0;
-	sci.pQueueFamilyIndices = NULL;
-	sci.presentMode = presentModes[0];
-	sci.oldSwapchain = VK_NULL_HANDLE;
-	sci.clipped = VK_TRUE;
+	VkMemoryRequirements mr;
+	actx->dev->vkd.vkGetImageMemoryRequirements(actx->dev->device, actx->optimal.image, &mr);
+
+	allocate_memory(actx, &mr, 0, 0, 0, VK_MINIMAL_MEM_GPU_ONLY, VK_MINIMAL_ALLOC_OPTIMAL, &actx->optimal.mem);
 
-	err = vkCreateSwapchainKHR(actx->device, &sci, NULL, &actx->swapchain.swapchain);
+	err = actx->dev->vkd.vkBindImageMemory(actx->dev->device, actx->optimal.image, actx->optimal.mem.memory, actx->optimal.mem.offset);
 	assert(err == VK_SUCCESS);
 
-	uint32_t count;
-	vkGetSwapchainImagesKHR(actx->device, actx->swapchain.swapchain, &count, NULL);
-	actx->swapchain.images = malloc(sizeof(actx->swapchain.images[0])*count);
-	vkGetSwapchainImagesKHR(actx->device, actx->swapchain.swapchain, &count, actx->swapchain.images);
+	actx->optimal.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+	vk_minimal_damage_clear(&actx->optimal.damage);
+	vk_minimal_damage_add(&actx->optimal.damage, full_rect(actx));
+}
+
+static void create_compute(struct vk_minimal_context *actx)
+{
+	VkResult err;
 
+	// Storage support for R8G8B8A8 is mandatory, unlike for the B8G8R8A8 that
+	// surfaces usually have. Both are in the same size class so the result is
+	// still copied rather than blitted, which is fine as the grid is gray.
 	VkImageCreateInfo ici;
 	memset(&ici, 0, sizeof(ici));
 	ici.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
 	ici.pNext = NULL;
 	ici.imageType = VK_IMAGE_TYPE_2D;
-	ici.format = surfFormats[0].format;
+	ici.format = VK_FORMAT_R8G8B8A8_UNORM;
 	ici.extent = extent_2d_to_3d(actx->extent);
 	ici.mipLevels = 1;
 	ici.arrayLayers = 1;
 	ici.samples = VK_SAMPLE_COUNT_1_BIT;
-	ici.tiling = VK_IMAGE_TILING_LINEAR;
-	ici.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+	ici.tiling = VK_IMAGE_TILING_OPTIMAL;
+	ici.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
 	ici.flags = 0;
-	ici.initialLayout = VK_IMAGE_LAYOUT_PREINITIALIZED;
+	ici.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 
-	err = vkCreateImage(actx->device, &ici, NULL, &actx->canvas.image);
+	err = actx->dev->vkd.vkCreateImage(actx->dev->device, &ici, NULL, &actx->compute.image);
 	assert(err == VK_SUCCESS);
 
 	VkMemoryRequirements mr;
-	vkGetImageMemoryRequirements(actx->device, actx->canvas.image, &mr);
+	actx->dev->vkd.vkGetImageMemoryRequirements(actx->dev->device, actx->compute.image, &mr);
 
-	VkMemoryAllocateInfo mai;
-	memset(&mai, 0, sizeof(mai));
-	mai.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	mai.pNext = NULL;
-	mai.allocationSize = actx->canvas.size = mr.size;
-	mai.memoryTypeIndex = get_memory_type_idx(gpu, mr.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+	allocate_memory(actx, &mr, 0, 0, 0, VK_MINIMAL_MEM_GPU_ONLY, VK_MINIMAL_ALLOC_OPTIMAL, &actx->compute.mem);
 
-	err = vkAllocateMemory(actx->device, &mai, NULL, &actx->canvas.dm);
+	err = actx->dev->vkd.vkBindImageMemory(actx->dev->device, actx->compute.image, actx->compute.mem.memory, actx->compute.mem.offset);
 	assert(err == VK_SUCCESS);
 
-	err = vkBindImageMemory(actx->device, actx->canvas.image, actx->canvas.dm, 0);
+	actx->compute.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+	VkImageViewCreateInfo ivci;
+	memset(&ivci, 0, sizeof(ivci));
+	ivci.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	ivci.pNext = NULL;
+	ivci.flags = 0;
+	ivci.image = actx->compute.image;
+	ivci.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	ivci.format = ici.format;
+	ivci.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
+	ivci.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
+	ivci.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
+	ivci.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
+	ivci.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	ivci.subresourceRange.baseMipLevel = 0;
+	ivci.subresourceRange.levelCount = 1;
+	ivci.subresourceRange.baseArrayLayer = 0;
+	ivci.subresourceRange.layerCount = 1;
+
+	err = actx->dev->vkd.vkCreateImageView(actx->dev->device, &ivci, NULL, &actx->compute.view);
 	assert(err == VK_SUCCESS);
 
-	VkCommandPoolCreateInfo cpci;
-	memset(&cpci, 0, sizeof(cpci));
-	cpci.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-	cpci.pNext = NULL;
-	cpci.queueFamilyIndex = 0;
-	cpci.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+	VkShaderModuleCreateInfo smci;
+	memset(&smci, 0, sizeof(smci));
+	smci.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+	smci.pNext = NULL;
+	smci.flags = 0;
+	smci.codeSize = sizeof(vk_minimal_grid_comp);
+	smci.pCode = vk_minimal_grid_comp;
 
-	VkCommandPool cmd_pool;
-	err = vkCreateCommandPool(actx->device, &cpci, NULL, &cmd_pool);
+	err = actx->dev->vkd.vkCreateShaderModule(actx->dev->device, &smci, NULL, &actx->compute.module);
 	assert(err == VK_SUCCESS);
 
-	VkCommandBufferAllocateInfo cbai;
-	memset(&cbai, 0, sizeof(cbai));
-	cbai.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-	cbai.pNext = NULL;
-	cbai.commandPool = cmd_pool;
-	cbai.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-	cbai.commandBufferCount = 1;
-
-	err = vkAllocateCommandBuffers(actx->device, &cbai, &actx->cmd);
+	VkDescriptorSetLayoutBinding dslb;
+	memset(&dslb, 0, sizeof(dslb));
+	dslb.binding = 0;
+	dslb.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	dslb.descriptorCount = 1;
+	dslb.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	dslb.pImmutableSamplers = NULL;
+
+	VkDescriptorSetLayoutCreateInfo dslci;
+	memset(&dslci, 0, sizeof(dslci));
+	dslci.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	dslci.pNext = NULL;
+	dslci.flags = 0;
+	dslci.bindingCount = 1;
+	dslci.pBindings = &dslb;
+
+	err = actx->dev->vkd.vkCreateDescriptorSetLayout(actx->dev->device, &dslci, NULL, &actx->compute.set_layout);
 	assert(err == VK_SUCCESS);
-}
 
-void vk_minimal_imb(struct vk_minimal_context *actx,
-                    VkImage image,
-                    VkAccessFlags srcAccessMask,
-                    VkAccessFlags dstAccessMask,
-                    VkImageLayout oldLayout,
-                    VkImageLayout newLayout)
-{
-	VkImageMemoryBarrier imb;
-	memset(&imb, 0, sizeof(imb));
-	imb.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-	imb.pNext = NULL;
-	imb.srcAccessMask = srcAccessMask;
-	imb.dstAccessMask = dstAccessMask;
-	imb.oldLayout = oldLayout;
-	imb.newLayout = newLayout;
-	imb.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-	imb.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-	imb.image = image;
-	imb.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	imb.subresourceRange.baseMipLevel = 0;
-	imb.subresourceRange.levelCount = 1;
-	imb.subresourceRange.baseArrayLayer = 0;
-	imb.subresourceRange.layerCount = 1;
+	VkPushConstantRange pcr;
+	memset(&pcr, 0, sizeof(pcr));
+	pcr.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pcr.offset = 0;
+	pcr.size = sizeof(actx->compute.cntr);
+
+	VkPipelineLayoutCreateInfo plci;
+	memset(&plci, 0, sizeof(plci));
+	plci.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	plci.pNext = NULL;
+	plci.flags = 0;
+	plci.setLayoutCount = 1;
+	plci.pSetLayouts = &actx->compute.set_layout;
+	plci.pushConstantRangeCount = 1;
+	plci.pPushConstantRanges = &pcr;
+
+	err = actx->dev->vkd.vkCreatePipelineLayout(actx->dev->device, &plci, NULL, &actx->compute.pipeline_layout);
+	assert(err == VK_SUCCESS);
 
-	vkCmdPipelineBarrier(actx->cmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, NULL, 0, NULL, 1, &imb);
-}
+	VkComputePipelineCreateInfo cpci;
+	memset(&cpci, 0, sizeof(cpci));
+	cpci.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	cpci.pNext = NULL;
+	cpci.flags = 0;
+	cpci.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	cpci.stage.pNext = NULL;
+	cpci.stage.flags = 0;
+	cpci.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	cpci.stage.module = actx->compute.module;
+	cpci.stage.pName = "main";
+	cpci.stage.pSpecializationInfo = NULL;
+	cpci.layout = actx->compute.pipeline_layout;
+	cpci.basePipelineHandle = VK_NULL_HANDLE;
+	cpci.basePipelineIndex = -1;
+
+	err = actx->dev->vkd.vkCreateComputePipelines(actx->dev->device, VK_NULL_HANDLE, 1, &cpci, NULL, &actx->compute.pipeline);
+	assert(err == VK_SUCCESS);
 
+	VkDescriptorPoolSize dps;
+	memset(&dps, 0, sizeof(dps));
+	dps.type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	dps.descriptorCount = 1;
+
+	VkDescriptorPoolCreateInfo dpci;
+	memset(&dpci, 0, sizeof(dpci));
+	dpci.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	dpci.pNext = NULL;
+	dpci.flags = 0;
+	dpci.maxSets = 1;
+	dpci.poolSizeCount = 1;
+	dpci.pPoolSizes = &dps;
+
+	err = actx->dev->vkd.vkCreateDescriptorPool(actx->dev->device, &dpci, NULL, &actx->compute.desc_pool);
+	assert(err == VK_SUCCESS);
 
-void vk_minimal_draw(struct vk_minimal_context *actx)
-{
-	VkResult err;
-	void *data;
+	VkDescriptorSetAllocateInfo dsai;
+	memset(&dsai, 0, sizeof(dsai));
+	dsai.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	dsai.pNext = NULL;
+	dsai.descriptorPool = actx->compute.desc_pool;
+	dsai.descriptorSetCount = 1;
+	dsai.pSetLayouts = &actx->compute.set_layout;
 
-	err = vkMapMemory(actx->device, actx->canvas.dm, 0, actx->canvas.size, 0, &data);
+	err = actx->dev->vkd.vkAllocateDescriptorSets(actx->dev->device, &dsai, &actx->compute.set);
 	assert(err == VK_SUCCESS);
 
-	VkImageSubresource is;
-	memset(&is, 0, sizeof(is));
-	is.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	is.mipLevel = 0;
-	is.arrayLayer = 0;
+	VkDescriptorImageInfo dii;
+	memset(&dii, 0, sizeof(dii));
+	dii.sampler = VK_NULL_HANDLE;
+	dii.imageView = actx->compute.view;
+	dii.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+	VkWriteDescriptorSet wds;
+	memset(&wds, 0, sizeof(wds));
+	wds.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	wds.pNext = NULL;
+	wds.dstSet = actx->compute.set;
+	wds.dstBinding = 0;
+	wds.dstArrayElement = 0;
+	wds.descriptorCount = 1;
+	wds.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	wds.pImageInfo = &dii;
+
+	actx->dev->vkd.vkUpdateDescriptorSets(actx->dev->device, 1, &wds, 0, NULL);
+
+	// Differs from the first counter value so the first frame copies the lines
+	actx->compute.cntr = actx->cntr - 1;
+}
 
-	VkSubresourceLayout layout;
-	vkGetImageSubresourceLayout(actx->device, actx->canvas.image, &is, &layout);
+static void create_frame(struct vk_minimal_context *actx, VkFormat format, struct vk_minimal_frame *frame)
+{
+	VkResult err;
+	uint32_t i;
 
-	draw_grid(actx, &layout, data);
+	if (actx->upload != VK_MINIMAL_UPLOAD_COMPUTE)
+		create_canvas(actx, format, frame);
 
-	vkUnmapMemory(actx->device, actx->canvas.dm);
+	VkCommandBufferAllocateInfo cbai;
+	memset(&cbai, 0, sizeof(cbai));
+	cbai.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	cbai.pNext = NULL;
+	cbai.commandPool = actx->cmd_pool;
+	cbai.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	cbai.commandBufferCount = 1;
 
-	uint32_t idx = 0;
+	// Recorded lazily by the first frame that uses the image from this slot
+	frame->recordings = calloc(actx->swapchain.count, sizeof(frame->recordings[0]));
+	frame->recording_count = actx->swapchain.count;
+	for (i = 0; i < actx->swapchain.count; i++)
+	{
+		err = actx->dev->vkd.vkAllocateCommandBuffers(actx->dev->device, &cbai, &frame->recordings[i].cmd);
+		assert(err == VK_SUCCESS);
+	}
+	if (actx->capture_container)
+	{
+		err = actx->dev->vkd.vkAllocateCommandBuffers(actx->dev->device, &cbai, &frame->capture_cmd);
+		assert(err == VK_SUCCESS);
+	}
 
-	VkSemaphore acquire_sem;
-	VkSemaphore copy_sem;
 	VkSemaphoreCreateInfo csi;
 	memset(&csi, 0, sizeof(csi));
 	csi.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 	csi.pNext = NULL;
 	csi.flags = 0;
 
-	err = vkCreateSemaphore(actx->device, &csi, NULL, &acquire_sem);
+	err = actx->dev->vkd.vkCreateSemaphore(actx->dev->device, &csi, NULL, &frame->acquire_sem);
 	assert(err == VK_SUCCESS);
-	err = vkCreateSemaphore(actx->device, &csi, NULL, &copy_sem);
+	err = actx->dev->vkd.vkCreateSemaphore(actx->dev->device, &csi, NULL, &frame->render_sem);
 	assert(err == VK_SUCCESS);
 
-	err = vkAcquireNextImageKHR(actx->device, actx->swapchain.swapchain, UINT64_MAX, acquire_sem, VK_NULL_HANDLE, &idx);
-	assert(err == VK_SUCCESS);
+	vk_minimal_damage_clear(&frame->damage);
+	vk_minimal_damage_add(&frame->damage, full_rect(actx));
+}
+
+// Enough buffers for a copy in every slot and for the writer to fall
+// VK_MINIMAL_CAPTURE_SLACK frames behind, sized for the current extent
+static void create_readback(struct vk_minimal_context *actx)
+{
+	VkResult err;
+	uint32_t i;
+
+	assert(vk_minimal_capture_supported(actx->capture_container, actx->swapchain.format));
+	actx->readback_count = actx->frames_in_flight + VK_MINIMAL_CAPTURE_SLACK;
+	actx->readback_next = 0;
+	assert(actx->readback_count <= VK_MINIMAL_CAPTURE_MAX_BUFFERS);
 
+	for (i = 0; i < actx->readback_count; i++)
 	{
-		VkCommandBufferBeginInfo cbbi;
-		memset(&cbbi, 0, sizeof(cbbi));
-		cbbi.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-		cbbi.pNext = NULL;
-		cbbi.flags = 0;
-		cbbi.pInheritanceInfo = NULL;
+		VkBufferCreateInfo bci;
+		memset(&bci, 0, sizeof(bci));
+		bci.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bci.pNext = NULL;
+		bci.flags = 0;
+		bci.size = (VkDeviceSize)actx->extent.width * actx->extent.height * vk_minimal_capture_format_bpp(actx->swapchain.format);
+		bci.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+		bci.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		err = actx->dev->vkd.vkCreateBuffer(actx->dev->device, &bci, NULL, &actx->readback[i].buffer);
+		assert(err == VK_SUCCESS);
+
+		VkMemoryRequirements mr;
+		actx->dev->vkd.vkGetBufferMemoryRequirements(actx->dev->device, actx->readback[i].buffer, &mr);
 
-		err = vkBeginCommandBuffer(actx->cmd, &cbbi);
+		uint32_t type = allocate_memory(actx, &mr, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, 0, 0, VK_MINIMAL_MEM_READBACK,
+		                                VK_MINIMAL_ALLOC_LINEAR, &actx->readback[i].mem);
+		err = actx->dev->vkd.vkBindBufferMemory(actx->dev->device, actx->readback[i].buffer, actx->readback[i].mem.memory, actx->readback[i].mem.offset);
 		assert(err == VK_SUCCESS);
+		assert(actx->readback[i].mem.data);
 
-		vk_minimal_imb(actx, actx->canvas.image, VK_ACCESS_MEMORY_WRITE_BIT | VK_ACCESS_HOST_WRITE_BIT, VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+		actx->readback[i].coherent = (actx->dev->mem_props.memoryTypes[type].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+		actx->readback[i].pending = VK_FALSE;
+	}
+}
 
+// The images of a new swapchain start out undefined and need everything
+static void reset_images(struct vk_minimal_context *actx)
+{
+	uint32_t i;
 
-		vk_minimal_imb(actx, actx->swapchain.images[idx], 0, VK_ACCESS_MEMORY_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+	free(actx->swapchain.damage);
+	free(actx->swapchain.layouts);
+	actx->swapchain.damage = malloc(sizeof(actx->swapchain.damage[0])*actx->swapchain.count);
+	actx->swapchain.layouts = malloc(sizeof(actx->swapchain.layouts[0])*actx->swapchain.count);
+	for (i = 0; i < actx->swapchain.count; i++)
+	{
+		vk_minimal_damage_clear(&actx->swapchain.damage[i]);
+		vk_minimal_damage_add(&actx->swapchain.damage[i], full_rect(actx));
+		actx->swapchain.layouts[i] = VK_IMAGE_LAYOUT_UNDEFINED;
+	}
+}
 
-		VkImageCopy ic;
-		memset(&ic, 0, sizeof(ic));
-		ic.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		ic.srcSubresource.mipLevel = 0;
-		ic.srcSubresource.baseArrayLayer = 0;
-		ic.srcSubresource.layerCount = 1;
-		ic.srcOffset.x = 0;
-		ic.srcOffset.y = 0;
-		ic.srcOffset.z = 0;
-		ic.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		ic.dstSubresource.mipLevel = 0;
-		ic.dstSubresource.baseArrayLayer = 0;
-		ic.dstSubresource.layerCount = 1;
-		ic.dstOffset.x = 0;
-		ic.dstOffset.y = 0;
-		ic.dstOffset.z = 0;
-		ic.extent = extent_2d_to_3d(actx->extent);
+// The canvas holds 32 bit pixels that are copied without conversion, so
+// prefer the formats that store them as they are
+static VkSurfaceFormatKHR choose_surface_format(const VkSurfaceFormatKHR *formats, uint32_t count)
+{
+	static const VkFormat preferred[] = {
+		VK_FORMAT_B8G8R8A8_UNORM,
+		VK_FORMAT_R8G8B8A8_UNORM,
+		VK_FORMAT_B8G8R8A8_SRGB,
+		VK_FORMAT_R8G8B8A8_SRGB
+	};
+	uint32_t i, j;
 
-		vkCmdCopyImage(actx->cmd, actx->canvas.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, actx->swapchain.images[idx], VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &ic);
+	// A single undefined entry means that any format may be used
+	if (count == 1 && formats[0].format == VK_FORMAT_UNDEFINED)
+	{
+		VkSurfaceFormatKHR f = {VK_FORMAT_B8G8R8A8_UNORM, formats[0].colorSpace};
+		return f;
+	}
 
-		vk_minimal_imb(actx, actx->swapchain.images[idx], VK_ACCESS_MEMORY_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_MEMORY_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
-		vk_minimal_imb(actx, actx->canvas.image, VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_MEMORY_WRITE_BIT | VK_ACCESS_HOST_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_GENERAL);
+	for (j = 0; j < sizeof(preferred)/sizeof(preferred[0]); j++)
+	{
+		for (i = 0; i < count; i++)
+		{
+			if (formats[i].format == preferred[j])
+				return formats[i];
+		}
+	}
 
-		err = vkEndCommandBuffer(actx->cmd);
-		assert(err == VK_SUCCESS);
+	return formats[0];
+}
+
+static VkPresentModeKHR choose_present_mode(enum vk_minimal_present_policy policy, const VkPresentModeKHR *modes, uint32_t count)
+{
+	// In order of preference, FIFO is always supported and ends every list
+	static const VkPresentModeKHR order[VK_MINIMAL_PRESENT_POLICY_COUNT][4] = {
+		// Newest frame shown at the next vblank without tearing
+		{VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_FIFO_KHR},
+		// Never wait for the display
+		{VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_FIFO_RELAXED_KHR, VK_PRESENT_MODE_FIFO_KHR},
+		// Render no faster than the display refreshes
+		{VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_FIFO_KHR}
+	};
+	uint32_t i, j;
+
+	assert(policy < VK_MINIMAL_PRESENT_POLICY_COUNT);
+	for (j = 0; j < 4; j++)
+	{
+		for (i = 0; i < count; i++)
+		{
+			if (modes[i] == order[policy][j])
+				return modes[i];
+		}
 	}
 
-	VkPipelineStageFlags stage_flags = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+	return VK_PRESENT_MODE_FIFO_KHR;
+}
 
-	VkSubmitInfo si;
-	memset(&si, 0, sizeof(si));
-	si.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-	si.pNext = NULL;
-	si.waitSemaphoreCount = 1;
-	si.pWaitSemaphores = &acquire_sem;
-	si.pWaitDstStageMask = &stage_flags;
-	si.commandBufferCount = 1;
-	si.pCommandBuffers = &actx->cmd;
-	si.signalSemaphoreCount = 1;
-	si.pSignalSemaphores = &copy_sem;
+static uint32_t choose_image_count(enum vk_minimal_present_policy policy, VkPresentModeKHR mode, const VkSurfaceCapabilitiesKHR *cap)
+{
+	uint32_t count = cap->minImageCount;
+
+	// Mailbox needs a spare image to render into while one is queued and one
+	// is shown. FIFO gets one only when throughput matters, as every extra
+	// image is another frame of queued latency.
+	if (mode == VK_PRESENT_MODE_MAILBOX_KHR || policy == VK_MINIMAL_PRESENT_MAX_THROUGHPUT)
+		count++;
+	if (count < 2)
+		count = 2;
+	if (cap->maxImageCount > 0 && count > cap->maxImageCount)
+		count = cap->maxImageCount;
+
+	return count;
+}
 
-	err = vkQueueSubmit(actx->queue, 1, &si, VK_NULL_HANDLE);
-	assert(err == VK_SUCCESS);
+// A family without graphics runs uploads alongside whatever the graphics
+// queue is doing. Transfer only families usually map to a DMA engine and are
+// preferred, async compute ones come next and are the only option for the
+// compute upload. Damage rectangles are not aligned to anything so families
+// with a coarser transfer granularity than a pixel are skipped.
+static uint32_t choose_upload_family(const VkQueueFamilyProperties *props, uint32_t count, uint32_t graphics_family, int need_compute)
+{
+	uint32_t i, best = graphics_family;
+	int best_score = 0;
 
-	VkPresentInfoKHR pi;
-	memset(&pi, 0, sizeof(pi));
-	pi.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-	pi.pNext = NULL;
-	pi.waitSemaphoreCount = 1;
-	pi.pWaitSemaphores = &copy_sem;
-	pi.swapchainCount = 1;
-	pi.pSwapchains = &actx->swapchain.swapchain;
-	pi.pImageIndices = &idx;
-	pi.pResults = NULL;
-
-	err = vkQueuePresentKHR(actx->queue, &pi);
-	assert(err == VK_SUCCESS);
+	for (i = 0; i < count; i++)
+	{
+		const VkQueueFamilyProperties *p = &props[i];
+		int score = 0;
 
-	err = vkQueueWaitIdle(actx->queue);
-	assert(err == VK_SUCCESS);
+		if (p->queueCount == 0 || (p->queueFlags & VK_QUEUE_GRAPHICS_BIT))
+			continue;
+		if (p->minImageTransferGranularity.width != 1 || p->minImageTransferGranularity.height != 1 ||
+		    p->minImageTransferGranularity.depth != 1)
+			continue;
 
-	vkDestroySemaphore(actx->device, acquire_sem, NULL);
-	vkDestroySemaphore(actx->device, copy_sem, NULL);
+		if (p->queueFlags & VK_QUEUE_COMPUTE_BIT)
+			score = 1;
+		else if ((p->queueFlags & VK_QUEUE_TRANSFER_BIT) && !need_compute)
+			score = 2;
+
+		if (score > best_score)
+		{
+			best = i;
+			best_score = score;
+		}
+	}
+
+	return best;
 }
 
+static VkFormat create_swapchain(struct vk_minimal_context *actx)
+{
+	VkResult err;
+
+	VkSurfaceCapabilitiesKHR surf_cap;
+	err = actx->dev->vki.vkGetPhysicalDeviceSurfaceCapabilitiesKHR(actx->dev->gpu, actx->surface, &surf_cap);
+	assert(err == VK_SUCCESS);
+	assert(surf_cap.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+	assert(!actx->capture_container || (surf_cap.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT));
+	if (surf_cap.currentExtent.width == UINT32_MAX)
+	{
+		// The surface takes the size of the swapchain
+		if (actx->swapchain.requested.width && actx->swapchain.requested.height)
+			actx->extent = actx->swapchain.requested;
+		if (actx->extent.width < surf_cap.minImageExtent.width)
+			actx->extent.width = surf_cap.minImageExtent.width;
+		if (actx->extent.width > surf_cap.maxImageExtent.width)
+			actx->extent.width = surf_cap.maxImageExtent.width;
+		if (actx->extent.height < surf_cap.minImageExtent.height)
+			actx->extent.height = surf_cap.minImageExtent.height;
+		if (actx->extent.height > surf_cap.maxImageExtent.height)
+			actx->extent.height = surf_cap.maxImageExtent.height;
+	}
+	else
+	{
+		actx->extent = surf_cap.currentExtent;
+	}
+
+	uint32_t formatCount;
+	err = actx->dev->vki.vkGetPhysicalDeviceSurfaceFormatsKHR(actx->dev->gpu, actx->surface, &formatCount, NULL);
+	assert(err == VK_SUCCESS && formatCount > 0);
+	VkSurfaceFormatKHR surfFormats[formatCount];
+	err = actx->dev->vki.vkGetPhysicalDeviceSurfaceFormatsKHR(actx->dev->gpu, actx->surface, &formatCount, surfFormats);
+	assert(err == VK_SUCCESS);
+
+	uint32_t presentModeCount;
+	err = actx->dev->vki.vkGetPhysicalDeviceSurfacePresentModesKHR(actx->dev->gpu, actx->surface, &presentModeCount, NULL);
+	assert(err == VK_SUCCESS && presentModeCount > 0);
+	VkPresentModeKHR presentModes[presentModeCount];
+	err = actx->dev->vki.vkGetPhysicalDeviceSurfacePresentModesKHR(actx->dev->gpu, actx->surface, &presentModeCount, presentModes);
+	assert(err == VK_SUCCESS);
+
+	VkSurfaceFormatKHR format = choose_surface_format(surfFormats, formatCount);
+
+	VkPresentModeKHR present_mode = choose_present_mode(actx->present_policy, presentModes, presentModeCount);
+	if (actx->present_mode_override)
+	{
+		uint32_t i;
+		for (i = 0; i < presentModeCount; i++)
+		{
+			if (presentModes[i] == actx->present_mode)
+				break;
+		}
+		assert(i < presentModeCount && "requested present mode not supported");
+		present_mode = actx->present_mode;
+	}
+	actx->present_mode = present_mode;
+
+	VkSwapchainCreateInfoKHR sci;
+	memset(&sci, 0, sizeof(sci));
+	sci.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
+	sci.pNext = NULL;
+	sci.surface = actx->surface;
+	sci.minImageCount = choose_image_count(actx->present_policy, present_mode, &surf_cap);
+	sci.imageFormat = format.format;
+	sci.imageColorSpace = format.colorSpace;
+	sci.imageExtent = actx->extent;
+	sci.imageUsage = VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	// Read back for the capture
+	if (actx->capture_container)
+		sci.imageUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+	sci.preTransform = surf_cap.currentTransform;
+	sci.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
+	sci.imageArrayLayers = 1;
+	// Written by the upload queue and presented from the graphics one.
+	// Sharing them saves an ownership transfer in each direction every
+	// frame, which would otherwise take two more submits to keep the
+	// contents outside the damaged regions.
+	uint32_t families[] = {actx->dev->queue_family, actx->dev->upload_family};
+	if (actx->dev->upload_family != actx->dev->queue_family)
+	{
+		sci.imageSharingMode = VK_SHARING_MODE_CONCURRENT;
+		sci.queueFamilyIndexCount = 2;
+		sci.pQueueFamilyIndices = families;
+	}
+	else
+	{
+		sci.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		sci.queueFamilyIndexCount = 0;
+		sci.pQueueFamilyIndices = NULL;
+	}
+	sci.presentMode = present_mode;
+	// Lets the driver hand over resources, and images of the old one that
+	// are still queued for presentation are presented as usual
+	sci.oldSwapchain = actx->swapchain.retired;
+	sci.clipped = VK_TRUE;
+
+	err = actx->dev->vkd.vkCreateSwapchainKHR(actx->dev->device, &sci, NULL, &actx->swapchain.swapchain);
+	assert(err == VK_SUCCESS);
+
+	actx->dev->vkd.vkGetSwapchainImagesKHR(actx->dev->device, actx->swapchain.swapchain, &actx->swapchain.count, NULL);
+	free(actx->swapchain.images);
+	actx->swapchain.images = malloc(sizeof(actx->swapchain.images[0])*actx->swapchain.count);
+	actx->dev->vkd.vkGetSwapchainImagesKHR(actx->dev->device, actx->swapchain.swapchain, &actx->swapchain.count, actx->swapchain.images);
+
+	actx->swapchain.memory = NULL;
+	actx->swapchain.final_layout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	free(actx->swapchain.present_ns);
+	actx->swapchain.present_ns = calloc(actx->swapchain.count, sizeof(actx->swapchain.present_ns[0]));
+	actx->swapchain.format = format.format;
+
+	LOGI("Presenting with %s%s, %u images (%u requested), format %d, policy %s\n",
+	     vk_minimal_present_mode_name(present_mode), actx->present_mode_override ? " (override)" : "",
+	     actx->swapchain.count, sci.minImageCount, format.format, vk_minimal_present_policy_name(actx->present_policy));
+
+	return format.format;
+}
+
+// Stands in for the swapchain when there is no surface. The images are
+// used round robin and are left ready to be read back by a transfer.
+static VkFormat create_offscreen(struct vk_minimal_context *actx)
+{
+	VkResult err;
+	const VkFormat format = VK_FORMAT_B8G8R8A8_UNORM;
+	uint32_t i;
+
+	if (actx->swapchain.requested.width && actx->swapchain.requested.height)
+		actx->extent = actx->swapchain.requested;
+	if (actx->extent.width == 0 || actx->extent.height == 0)
+	{
+		actx->extent.width = VK_MINIMAL_HEADLESS_WIDTH;
+		actx->extent.height = VK_MINIMAL_HEADLESS_HEIGHT;
+	}
+
+	actx->swapchain.swapchain = VK_NULL_HANDLE;
+	actx->swapchain.count = VK_MINIMAL_HEADLESS_IMAGES;
+	actx->swapchain.format = format;
+	actx->swapchain.images = malloc(sizeof(actx->swapchain.images[0])*actx->swapchain.count);
+	actx->swapchain.memory = malloc(sizeof(actx->swapchain.memory[0])*actx->swapchain.count);
+	actx->swapchain.final_layout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	actx->swapchain.next = 0;
+
+	for (i = 0; i < actx->swapchain.count; i++)
+	{
+		VkImageCreateInfo ici;
+		memset(&ici, 0, sizeof(ici));
+		ici.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		ici.pNext = NULL;
+		ici.imageType = VK_IMAGE_TYPE_2D;
+		ici.format = format;
+		ici.extent = extent_2d_to_3d(actx->extent);
+		ici.mipLevels = 1;
+		ici.arrayLayers = 1;
+		ici.samples = VK_SAMPLE_COUNT_1_BIT;
+		ici.tiling = VK_IMAGE_TILING_OPTIMAL;
+		ici.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		ici.flags = 0;
+		ici.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+		err = actx->dev->vkd.vkCreateImage(actx->dev->device, &ici, NULL, &actx->swapchain.images[i]);
+		assert(err == VK_SUCCESS);
+
+		VkMemoryRequirements mr;
+		actx->dev->vkd.vkGetImageMemoryRequirements(actx->dev->device, actx->swapchain.images[i], &mr);
+
+		allocate_memory(actx, &mr, 0, 0, 0, VK_MINIMAL_MEM_GPU_ONLY, VK_MINIMAL_ALLOC_OPTIMAL, &actx->swapchain.memory[i]);
+
+		err = actx->dev->vkd.vkBindImageMemory(actx->dev->device, actx->swapchain.images[i], actx->swapchain.memory[i].memory, actx->swapchain.memory[i].offset);
+		assert(err == VK_SUCCESS);
+	}
+
+	return format;
+}
+
+const char *vk_minimal_present_policy_name(enum vk_minimal_present_policy policy)
+{
+	static const char *names[VK_MINIMAL_PRESENT_POLICY_COUNT] = {
+		"low latency",
+		"max throughput",
+		"power saving"
+	};
+
+	return policy < VK_MINIMAL_PRESENT_POLICY_COUNT ? names[policy] : "unknown";
+}
+
+const char *vk_minimal_present_mode_name(VkPresentModeKHR mode)
+{
+	switch (mode)
+	{
+		case VK_PRESENT_MODE_IMMEDIATE_KHR: return "immediate";
+		case VK_PRESENT_MODE_MAILBOX_KHR: return "mailbox";
+		case VK_PRESENT_MODE_FIFO_KHR: return "fifo";
+		case VK_PRESENT_MODE_FIFO_RELAXED_KHR: return "fifo relaxed";
+		default: return "unknown";
+	}
+}
+
+const char *vk_minimal_upload_name(enum vk_minimal_upload upload)
+{
+	static const char *names[VK_MINIMAL_UPLOAD_COUNT] = {
+		"linear image",
+		"buffer to optimal image",
+		"buffer to swapchain",
+		"compute shader"
+	};
+
+	return upload < VK_MINIMAL_UPLOAD_COUNT ? names[upload] : "unknown";
+}
+
+const char *vk_minimal_canvas_format_name(enum vk_minimal_canvas_format format)
+{
+	static const char *names[VK_MINIMAL_CANVAS_FORMAT_COUNT] = {
+		"native",
+		"rgb565",
+		"rgba4444"
+	};
+
+	return format < VK_MINIMAL_CANVAS_FORMAT_COUNT ? names[format] : "unknown";
+}
+
+struct vk_minimal_rect vk_minimal_canvas_clear(struct vk_minimal_context *actx, uint32_t color)
+{
+	assert(actx->upload != VK_MINIMAL_UPLOAD_COMPUTE);
+	return vk_minimal_batch_clear(&actx->batch, color);
+}
+
+struct vk_minimal_rect vk_minimal_canvas_fill_rect(struct vk_minimal_context *actx, int32_t x, int32_t y, uint32_t width, uint32_t height,
+                                                   uint32_t color)
+{
+	assert(actx->upload != VK_MINIMAL_UPLOAD_COMPUTE);
+	return vk_minimal_batch_fill_rect(&actx->batch, x, y, width, height, color);
+}
+
+struct vk_minimal_rect vk_minimal_canvas_hline(struct vk_minimal_context *actx, int32_t x, int32_t y, uint32_t width, uint32_t color)
+{
+	assert(actx->upload != VK_MINIMAL_UPLOAD_COMPUTE);
+	return vk_minimal_batch_hline(&actx->batch, x, y, width, color);
+}
+
+struct vk_minimal_rect vk_minimal_canvas_vline(struct vk_minimal_context *actx, int32_t x, int32_t y, uint32_t height, uint32_t color)
+{
+	assert(actx->upload != VK_MINIMAL_UPLOAD_COMPUTE);
+	return vk_minimal_batch_vline(&actx->batch, x, y, height, color);
+}
+
+struct vk_minimal_rect vk_minimal_canvas_line(struct vk_minimal_context *actx, int32_t x0, int32_t y0, int32_t x1, int32_t y1, uint32_t color)
+{
+	assert(actx->upload != VK_MINIMAL_UPLOAD_COMPUTE);
+	return vk_minimal_batch_line(&actx->batch, x0, y0, x1, y1, color);
+}
+
+struct vk_minimal_rect vk_minimal_canvas_blend(struct vk_minimal_context *actx, int32_t x, int32_t y, const uint32_t *pixels, uint32_t pitch,
+                                               uint32_t width, uint32_t height)
+{
+	assert(actx->upload != VK_MINIMAL_UPLOAD_COMPUTE);
+	return vk_minimal_batch_blend(&actx->batch, x, y, pixels, pitch, width, height);
+}
+
+struct vk_minimal_rect vk_minimal_canvas_glyph(struct vk_minimal_context *actx, int32_t x, int32_t y, const struct vk_minimal_atlas *atlas,
+                                               uint32_t glyph, uint32_t color)
+{
+	assert(actx->upload != VK_MINIMAL_UPLOAD_COMPUTE);
+	return vk_minimal_batch_glyph(&actx->batch, x, y, atlas, glyph, color);
+}
+
+void vk_minimal_device_init(struct vk_minimal_device *dev, VkInstance instance, VkSurfaceKHR surface,
+                            uint32_t frames_in_flight, VkBool32 single_queue, VkBool32 need_compute)
+{
+	VkResult err;
+	uint32_t gpu_count;
+	uint32_t i;
+
+	memset(dev, 0, sizeof(*dev));
+	dev->instance = instance;
+	vulkan_dlfcn_instance_init(&dev->vki, instance);
+	err = dev->vki.vkEnumeratePhysicalDevices(instance, &gpu_count, NULL);
+	assert(err == VK_SUCCESS && gpu_count > 0);
+
+	VkPhysicalDevice physical_devices[gpu_count];
+	err = dev->vki.vkEnumeratePhysicalDevices(instance, &gpu_count, physical_devices);
+	assert(err == VK_SUCCESS);
+	const VkPhysicalDevice gpu = physical_devices[0];
+	dev->gpu = gpu;
+	dev->vki.vkGetPhysicalDeviceMemoryProperties(gpu, &dev->mem_props);
+	dev->vki.vkGetPhysicalDeviceProperties(gpu, &dev->props);
+
+	uint32_t queue_count;
+	dev->vki.vkGetPhysicalDeviceQueueFamilyProperties(gpu, &queue_count, NULL);
+	assert(queue_count > 0);
+
+	VkQueueFamilyProperties queue_props[queue_count];
+	dev->vki.vkGetPhysicalDeviceQueueFamilyProperties(gpu, &queue_count, queue_props);
+	assert(queue_props[0].queueFlags & VK_QUEUE_GRAPHICS_BIT);
+	dev->queue_family = 0;
+	if (surface && dev->vki.vkGetPhysicalDeviceSurfaceSupportKHR)
+	{
+		VkBool32 supported;
+		dev->vki.vkGetPhysicalDeviceSurfaceSupportKHR(gpu, dev->queue_family, surface, &supported);
+		assert(supported);
+	}
+
+	dev->upload_family = single_queue ? dev->queue_family :
+	                     choose_upload_family(queue_props, queue_count, dev->queue_family, need_compute);
+
+	// Query pools can only be reset on graphics and compute queues
+	const VkQueueFamilyProperties *upload_props = &queue_props[dev->upload_family];
+	dev->upload_flags = upload_props->queueFlags;
+	dev->timestamp_valid_bits = upload_props->queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT) ? upload_props->timestampValidBits : 0;
+
+	float queue_priorities[] = {1.0};
+	VkDeviceQueueCreateInfo dqci[2];
+	memset(dqci, 0, sizeof(dqci));
+	dqci[0].sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+	dqci[0].pNext = NULL;
+	dqci[0].queueFamilyIndex = dev->queue_family;
+	dqci[0].queueCount = 1;
+	dqci[0].pQueuePriorities = queue_priorities;
+	dqci[1] = dqci[0];
+	dqci[1].queueFamilyIndex = dev->upload_family;
+
+	const char *dextensions[] = {
+	  "VK_KHR_swapchain"
+	};
+
+	VkDeviceCreateInfo dci;
+	memset(&dci, 0, sizeof(dci));
+	dci.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+	dci.pNext = NULL;
+	dci.queueCreateInfoCount = dev->upload_family != dev->queue_family ? 2 : 1;
+	dci.pQueueCreateInfos = dqci;
+	dci.enabledLayerCount = 0;
+	dci.ppEnabledLayerNames = NULL;
+	// Without a surface there is nothing to present to
+	dci.enabledExtensionCount = surface ? sizeof(dextensions)/sizeof(dextensions[0]) : 0;
+	dci.ppEnabledExtensionNames = dextensions;
+	dci.pEnabledFeatures = NULL;
+
+	err = dev->vki.vkCreateDevice(gpu, &dci, NULL, &dev->device);
+	assert(err == VK_SUCCESS);
+	vulkan_dlfcn_device_init(&dev->vkd, &dev->vki, dev->device);
+
+	dev->vkd.vkGetDeviceQueue(dev->device, dev->queue_family, 0, &dev->queue);
+	dev->vkd.vkGetDeviceQueue(dev->device, dev->upload_family, 0, &dev->upload_queue);
+	LOGI("Uploading on queue family %u, presenting on %u\n", dev->upload_family, dev->queue_family);
+
+	vk_minimal_alloc_init(&dev->allocator, &dev->vkd, dev->device, &dev->mem_props, &dev->props.limits);
+
+	if (frames_in_flight == 0)
+		frames_in_flight = VK_MINIMAL_DEFAULT_FRAMES_IN_FLIGHT;
+	assert(frames_in_flight <= VK_MINIMAL_MAX_FRAMES_IN_FLIGHT);
+	dev->frames_in_flight = frames_in_flight;
+	dev->frame_idx = 0;
+
+	// Created signaled so that the first wait on an unused slot returns at once
+	VkFenceCreateInfo fci;
+	memset(&fci, 0, sizeof(fci));
+	fci.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+	fci.pNext = NULL;
+	fci.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+	for (i = 0; i < dev->frames_in_flight; i++)
+	{
+		err = dev->vkd.vkCreateFence(dev->device, &fci, NULL, &dev->fences[i]);
+		assert(err == VK_SUCCESS);
+	}
+}
+
+void vk_minimal_device_destroy(struct vk_minimal_device *dev)
+{
+	VkResult err;
+	uint32_t i;
+
+	err = dev->vkd.vkDeviceWaitIdle(dev->device);
+	assert(err == VK_SUCCESS);
+
+	for (i = 0; i < dev->frames_in_flight; i++)
+	{
+		dev->vkd.vkDestroyFence(dev->device, dev->fences[i], NULL);
+	}
+	vk_minimal_alloc_destroy(&dev->allocator);
+	dev->vkd.vkDestroyDevice(dev->device, NULL);
+	memset(dev, 0, sizeof(*dev));
+}
+
+void vk_minimal_init(struct vk_minimal_context *actx)
+{
+	VkResult err;
+
+	assert(actx->upload < VK_MINIMAL_UPLOAD_COUNT);
+	if (!actx->dev)
+	{
+		actx->dev = malloc(sizeof(*actx->dev));
+		actx->owns_dev = VK_TRUE;
+		vk_minimal_device_init(actx->dev, actx->instance, actx->surface, actx->frames_in_flight,
+		                       actx->single_queue, actx->upload == VK_MINIMAL_UPLOAD_COMPUTE);
+	}
+	else if (actx->surface)
+	{
+		VkBool32 supported;
+		actx->dev->vki.vkGetPhysicalDeviceSurfaceSupportKHR(actx->dev->gpu, actx->dev->queue_family, actx->surface, &supported);
+		assert(supported);
+	}
+	assert(actx->upload != VK_MINIMAL_UPLOAD_COMPUTE || (actx->dev->upload_flags & VK_QUEUE_COMPUTE_BIT));
+	actx->instance = actx->dev->instance;
+	actx->frames_in_flight = actx->dev->frames_in_flight;
+	actx->frame_idx = 0;
+
+	if (actx->surface)
+		create_swapchain(actx);
+	else
+		create_offscreen(actx);
+	reset_images(actx);
+	choose_canvas(actx);
+	uint32_t i;
+
+	VkCommandPoolCreateInfo cpci;
+	memset(&cpci, 0, sizeof(cpci));
+	cpci.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	cpci.pNext = NULL;
+	cpci.queueFamilyIndex = actx->dev->upload_family;
+	cpci.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+
+	err = actx->dev->vkd.vkCreateCommandPool(actx->dev->device, &cpci, NULL, &actx->cmd_pool);
+	assert(err == VK_SUCCESS);
+
+#ifdef VK_MINIMAL_PROFILE
+	vk_minimal_prof_init(&actx->prof, &actx->dev->vkd, actx->dev->device, actx->dev->props.limits.timestampPeriod,
+	                     actx->dev->timestamp_valid_bits, actx->frames_in_flight);
+#endif
+
+	if (actx->upload == VK_MINIMAL_UPLOAD_COMPUTE)
+	{
+		create_compute(actx);
+	}
+	else
+	{
+		vk_minimal_fill_init(&actx->fill, actx->fill_path, actx->canvas.fill_format, actx->extent.width);
+		vk_minimal_batch_init(&actx->batch, actx->extent.width, actx->extent.height);
+		vk_minimal_pool_init(&actx->pool, actx->fill_threads);
+	}
+	if (actx->upload == VK_MINIMAL_UPLOAD_BUFFER_OPTIMAL)
+		create_optimal(actx, actx->canvas.format);
+
+	for (i = 0; i < actx->frames_in_flight; i++)
+	{
+		create_frame(actx, actx->canvas.format, &actx->frames[i]);
+	}
+
+	if (actx->capture_container)
+	{
+		vk_minimal_capture_init(&actx->capture, actx->capture_container, actx->capture_path, &actx->dev->allocator);
+		create_readback(actx);
+		LOGI("Capturing every %u frame(s) as %s to %s, %u readback buffers\n", actx->capture_interval ? actx->capture_interval : 1,
+		     vk_minimal_capture_container_name(actx->capture_container), actx->capture_path, actx->readback_count);
+	}
+}
+
+void vk_minimal_imb(const struct vulkan_dlfcn_device *vkd,
+                    VkCommandBuffer cmd,
+                    VkImage image,
+                    VkAccessFlags srcAccessMask,
+                    VkAccessFlags dstAccessMask,
+                    VkImageLayout oldLayout,
+                    VkImageLayout newLayout)
+{
+	VkImageMemoryBarrier imb;
+	memset(&imb, 0, sizeof(imb));
+	imb.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	imb.pNext = NULL;
+	imb.srcAccessMask = srcAccessMask;
+	imb.dstAccessMask = dstAccessMask;
+	imb.oldLayout = oldLayout;
+	imb.newLayout = newLayout;
+	imb.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	imb.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	imb.image = image;
+	imb.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	imb.subresourceRange.baseMipLevel = 0;
+	imb.subresourceRange.levelCount = 1;
+	imb.subresourceRange.baseArrayLayer = 0;
+	imb.subresourceRange.layerCount = 1;
+
+	vkd->vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, NULL, 0, NULL, 1, &imb);
+}
+
+
+static uint32_t image_copies(const struct vk_minimal_damage *damage, VkImageCopy *ic)
+{
+	uint32_t i;
+
+	memset(ic, 0, sizeof(ic[0])*damage->count);
+	for (i = 0; i < damage->count; i++)
+	{
+		const struct vk_minimal_rect *r = &damage->rects[i];
+		ic[i].srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		ic[i].srcSubresource.mipLevel = 0;
+		ic[i].srcSubresource.baseArrayLayer = 0;
+		ic[i].srcSubresource.layerCount = 1;
+		ic[i].srcOffset.x = r->x0;
+		ic[i].srcOffset.y = r->y0;
+		ic[i].srcOffset.z = 0;
+		ic[i].dstSubresource = ic[i].srcSubresource;
+		ic[i].dstOffset = ic[i].srcOffset;
+		ic[i].extent.width = r->x1 - r->x0;
+		ic[i].extent.height = r->y1 - r->y0;
+		ic[i].extent.depth = 1;
+	}
+
+	return damage->count;
+}
+
+static uint32_t image_blits(const struct vk_minimal_damage *damage, VkImageBlit *ib)
+{
+	uint32_t i;
+
+	memset(ib, 0, sizeof(ib[0])*damage->count);
+	for (i = 0; i < damage->count; i++)
+	{
+		const struct vk_minimal_rect *r = &damage->rects[i];
+		ib[i].srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		ib[i].srcSubresource.mipLevel = 0;
+		ib[i].srcSubresource.baseArrayLayer = 0;
+		ib[i].srcSubresource.layerCount = 1;
+		ib[i].srcOffsets[0].x = r->x0;
+		ib[i].srcOffsets[0].y = r->y0;
+		ib[i].srcOffsets[0].z = 0;
+		ib[i].srcOffsets[1].x = r->x1;
+		ib[i].srcOffsets[1].y = r->y1;
+		ib[i].srcOffsets[1].z = 1;
+		ib[i].dstSubresource = ib[i].srcSubresource;
+		ib[i].dstOffsets[0] = ib[i].srcOffsets[0];
+		ib[i].dstOffsets[1] = ib[i].srcOffsets[1];
+	}
+
+	return damage->count;
+}
+
+static uint32_t buffer_copies(const struct vk_minimal_context *actx, const struct vk_minimal_damage *damage, const struct vk_minimal_frame *frame, VkBufferImageCopy *bic)
+{
+	uint32_t i;
+
+	memset(bic, 0, sizeof(bic[0])*damage->count);
+	for (i = 0; i < damage->count; i++)
+	{
+		const struct vk_minimal_rect *r = &damage->rects[i];
+		bic[i].bufferOffset = frame->canvas.layout.offset + r->y0 * frame->canvas.row_pitch + r->x0 * actx->canvas.bpp;
+		bic[i].bufferRowLength = frame->canvas.row_pitch / actx->canvas.bpp;
+		bic[i].bufferImageHeight = 0;
+		bic[i].imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		bic[i].imageSubresource.mipLevel = 0;
+		bic[i].imageSubresource.baseArrayLayer = 0;
+		bic[i].imageSubresource.layerCount = 1;
+		bic[i].imageOffset.x = r->x0;
+		bic[i].imageOffset.y = r->y0;
+		bic[i].imageOffset.z = 0;
+		bic[i].imageExtent.width = r->x1 - r->x0;
+		bic[i].imageExtent.height = r->y1 - r->y0;
+		bic[i].imageExtent.depth = 1;
+	}
+
+	return damage->count;
+}
+
+// From the canvas or its device local copy to the swapchain image, a blit
+// when the canvas is 16 bit. Nearest filtering as nothing is scaled.
+static void record_canvas_copy(struct vk_minimal_context *actx, VkCommandBuffer cmd, VkImage src, VkImage dst, const struct vk_minimal_damage *damage)
+{
+	VkImageCopy ic[VK_MINIMAL_MAX_DAMAGE_RECTS];
+	VkImageBlit ib[VK_MINIMAL_MAX_DAMAGE_RECTS];
+
+	if (damage->count == 0)
+		return;
+
+	if (actx->canvas.blit)
+		actx->dev->vkd.vkCmdBlitImage(cmd, src, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, dst, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, image_blits(damage, ib), ib, VK_FILTER_NEAREST);
+	else
+		actx->dev->vkd.vkCmdCopyImage(cmd, src, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, dst, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, image_copies(damage, ic), ic);
+}
+
+// Only records, the state the commands leave behind is tracked by finish_upload()
+static void record_upload(struct vk_minimal_context *actx, VkCommandBuffer cmd, struct vk_minimal_frame *frame, uint32_t idx, const struct vk_minimal_damage *damage)
+{
+	VkImage dst = actx->swapchain.images[idx];
+	VkImageCopy ic[VK_MINIMAL_MAX_DAMAGE_RECTS];
+	VkBufferImageCopy bic[VK_MINIMAL_MAX_DAMAGE_RECTS];
+
+	// Coming from the final layout keeps the contents outside the damaged regions
+	vk_minimal_imb(&actx->dev->vkd, cmd, dst, 0, VK_ACCESS_MEMORY_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT, actx->swapchain.layouts[idx], VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+
+	switch (actx->upload)
+	{
+		case VK_MINIMAL_UPLOAD_LINEAR_IMAGE:
+		vk_minimal_imb(&actx->dev->vkd, cmd, frame->canvas.image, VK_ACCESS_MEMORY_WRITE_BIT | VK_ACCESS_HOST_WRITE_BIT, VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+		record_canvas_copy(actx, cmd, frame->canvas.image, dst, damage);
+		vk_minimal_imb(&actx->dev->vkd, cmd, frame->canvas.image, VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_MEMORY_WRITE_BIT | VK_ACCESS_HOST_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_GENERAL);
+		break;
+
+		case VK_MINIMAL_UPLOAD_BUFFER_SWAPCHAIN:
+		if (damage->count > 0)
+			actx->dev->vkd.vkCmdCopyBufferToImage(cmd, frame->canvas.buffer, dst, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, buffer_copies(actx, damage, frame, bic), bic);
+		break;
+
+		case VK_MINIMAL_UPLOAD_BUFFER_OPTIMAL:
+		// Bring the device local copy up to date, then copy from it
+		vk_minimal_imb(&actx->dev->vkd, cmd, actx->optimal.image, VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, actx->optimal.layout, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+		if (actx->optimal.damage.count > 0)
+			actx->dev->vkd.vkCmdCopyBufferToImage(cmd, frame->canvas.buffer, actx->optimal.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, buffer_copies(actx, &actx->optimal.damage, frame, bic), bic);
+		vk_minimal_imb(&actx->dev->vkd, cmd, actx->optimal.image, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+		record_canvas_copy(actx, cmd, actx->optimal.image, dst, damage);
+		break;
+
+		case VK_MINIMAL_UPLOAD_COMPUTE:
+		vk_minimal_imb(&actx->dev->vkd, cmd, actx->compute.image, VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_SHADER_WRITE_BIT, actx->compute.layout, VK_IMAGE_LAYOUT_GENERAL);
+		actx->dev->vkd.vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, actx->compute.pipeline);
+		actx->dev->vkd.vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, actx->compute.pipeline_layout, 0, 1, &actx->compute.set, 0, NULL);
+		actx->dev->vkd.vkCmdPushConstants(cmd, actx->compute.pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(actx->compute.cntr), &actx->compute.cntr);
+		// Matches the 16x16 local size of the shader
+		actx->dev->vkd.vkCmdDispatch(cmd, (actx->extent.width + 15) / 16, (actx->extent.height + 15) / 16, 1);
+		vk_minimal_imb(&actx->dev->vkd, cmd, actx->compute.image, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+		if (damage->count > 0)
+			actx->dev->vkd.vkCmdCopyImage(cmd, actx->compute.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, dst, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, image_copies(damage, ic), ic);
+		break;
+
+		default:
+		assert(0 && "unknown upload mode");
+	}
+
+	vk_minimal_imb(&actx->dev->vkd, cmd, dst, VK_ACCESS_MEMORY_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_MEMORY_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, actx->swapchain.final_layout);
+}
+
+// Copies the image the upload just finished into a readback buffer, in a
+// command buffer of its own as the buffer changes from frame to frame
+static void record_capture(struct vk_minimal_context *actx, VkCommandBuffer cmd, uint32_t idx, VkBuffer buffer)
+{
+	VkImage src = actx->swapchain.images[idx];
+
+	// The upload came first in the same submit
+	vk_minimal_imb(&actx->dev->vkd, cmd, src, VK_ACCESS_MEMORY_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT, actx->swapchain.final_layout, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+
+	VkBufferImageCopy bic;
+	memset(&bic, 0, sizeof(bic));
+	bic.bufferOffset = 0;
+	bic.bufferRowLength = 0;
+	bic.bufferImageHeight = 0;
+	bic.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	bic.imageSubresource.mipLevel = 0;
+	bic.imageSubresource.baseArrayLayer = 0;
+	bic.imageSubresource.layerCount = 1;
+	bic.imageExtent = extent_2d_to_3d(actx->extent);
+
+	actx->dev->vkd.vkCmdCopyImageToBuffer(cmd, src, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, buffer, 1, &bic);
+	vk_minimal_imb(&actx->dev->vkd, cmd, src, VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_MEMORY_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, actx->swapchain.final_layout);
+
+	// The fence alone doesn't make the copy visible to the host
+	VkBufferMemoryBarrier bmb;
+	memset(&bmb, 0, sizeof(bmb));
+	bmb.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	bmb.pNext = NULL;
+	bmb.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	bmb.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	bmb.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	bmb.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	bmb.buffer = buffer;
+	bmb.offset = 0;
+	bmb.size = VK_WHOLE_SIZE;
+
+	actx->dev->vkd.vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, NULL, 1, &bmb, 0, NULL);
+}
+
+// Hands the readback buffers whose copy completed to the writer, oldest
+// first, or all of them once the device is known to be idle
+static void hand_over_captures(struct vk_minimal_context *actx, VkBool32 idle)
+{
+	uint32_t i, n;
+
+	for (n = 0; n < actx->readback_count; n++)
+	{
+		i = (actx->readback_next + n) % actx->readback_count;
+		if (!actx->readback[i].pending)
+			continue;
+		if (!idle && actx->readback[i].submit + actx->dev->frames_in_flight > actx->dev->submits)
+			break;
+		actx->readback[i].pending = VK_FALSE;
+		vk_minimal_capture_push(&actx->capture, &actx->readback[i].job);
+	}
+}
+
+// Takes the oldest buffer unless it is still in flight or being written.
+// Returns 0 when the frame is not captured.
+static int capture_frame(struct vk_minimal_context *actx, struct vk_minimal_frame *frame, uint32_t idx)
+{
+	VkResult err;
+	uint32_t interval = actx->capture_interval ? actx->capture_interval : 1;
+	uint32_t i = actx->readback_next;
+
+	if (!actx->capture_container || actx->frame_count % interval != 0)
+		return 0;
+	if (actx->readback[i].pending || vk_minimal_capture_busy(&actx->capture, i))
+	{
+		actx->stats.capture_dropped++;
+		return 0;
+	}
+
+	VkCommandBufferBeginInfo cbbi;
+	memset(&cbbi, 0, sizeof(cbbi));
+	cbbi.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	cbbi.pNext = NULL;
+	cbbi.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	cbbi.pInheritanceInfo = NULL;
+
+	err = actx->dev->vkd.vkBeginCommandBuffer(frame->capture_cmd, &cbbi);
+	assert(err == VK_SUCCESS);
+	record_capture(actx, frame->capture_cmd, idx, actx->readback[i].buffer);
+	err = actx->dev->vkd.vkEndCommandBuffer(frame->capture_cmd);
+	assert(err == VK_SUCCESS);
+
+	// Goes out with the submit of this frame
+	struct vk_minimal_capture_job *job = &actx->readback[i].job;
+	memset(job, 0, sizeof(*job));
+	job->data = actx->readback[i].mem.data;
+	job->mem = actx->readback[i].coherent ? NULL : &actx->readback[i].mem;
+	job->format = actx->swapchain.format;
+	job->width = actx->extent.width;
+	job->height = actx->extent.height;
+	job->frame = actx->frame_count;
+	job->ns = now_ns();
+	job->buffer = i;
+
+	actx->readback[i].pending = VK_TRUE;
+	actx->readback[i].submit = actx->dev->submits;
+	actx->readback_next = (i + 1) % actx->readback_count;
+	actx->stats.captured++;
+	return 1;
+}
+
+// Whether the recording can be submitted again for this frame
+static int recording_matches(struct vk_minimal_context *actx, const struct vk_minimal_recording *rec, uint32_t idx, const struct vk_minimal_damage *damage)
+{
+	if (!rec->valid || rec->layout != actx->swapchain.layouts[idx] || !vk_minimal_damage_equal(&rec->damage, damage))
+		return 0;
+
+	switch (actx->upload)
+	{
+		case VK_MINIMAL_UPLOAD_BUFFER_OPTIMAL:
+		return rec->optimal_layout == actx->optimal.layout && vk_minimal_damage_equal(&rec->optimal_damage, &actx->optimal.damage);
+
+		case VK_MINIMAL_UPLOAD_COMPUTE:
+		// The counter is a push constant so this misses on every new frame
+		return rec->compute_cntr == actx->compute.cntr;
+
+		default:
+		return 1;
+	}
+}
+
+static void save_recording(struct vk_minimal_context *actx, struct vk_minimal_recording *rec, uint32_t idx, const struct vk_minimal_damage *damage)
+{
+	rec->valid = VK_TRUE;
+	rec->layout = actx->swapchain.layouts[idx];
+	rec->optimal_layout = actx->optimal.layout;
+	rec->compute_cntr = actx->compute.cntr;
+	rec->damage = *damage;
+	rec->optimal_damage = actx->optimal.damage;
+}
+
+// Moves the tracked state on to what the upload left behind, recorded or
+// not. Returns the number of bytes the GPU reads from host memory.
+static uint64_t finish_upload(struct vk_minimal_context *actx, uint32_t idx, struct vk_minimal_damage *damage)
+{
+	uint64_t uploaded = 0;
+
+	switch (actx->upload)
+	{
+		case VK_MINIMAL_UPLOAD_LINEAR_IMAGE:
+		case VK_MINIMAL_UPLOAD_BUFFER_SWAPCHAIN:
+		uploaded = vk_minimal_damage_area(damage) * actx->canvas.bpp;
+		break;
+
+		case VK_MINIMAL_UPLOAD_BUFFER_OPTIMAL:
+		actx->optimal.layout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		uploaded = vk_minimal_damage_area(&actx->optimal.damage) * actx->canvas.bpp;
+		vk_minimal_damage_clear(&actx->optimal.damage);
+		break;
+
+		case VK_MINIMAL_UPLOAD_COMPUTE:
+		actx->compute.layout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		break;
+
+		default:
+		assert(0 && "unknown upload mode");
+	}
+
+	actx->swapchain.layouts[idx] = actx->swapchain.final_layout;
+	vk_minimal_damage_clear(damage);
+
+	return uploaded;
+}
+
+static void destroy_canvas(struct vk_minimal_context *actx, struct vk_minimal_frame *frame)
+{
+	if (frame->canvas.image)
+		actx->dev->vkd.vkDestroyImage(actx->dev->device, frame->canvas.image, NULL);
+	if (frame->canvas.buffer)
+		actx->dev->vkd.vkDestroyBuffer(actx->dev->device, frame->canvas.buffer, NULL);
+	vk_minimal_free(&actx->dev->allocator, &frame->canvas.mem);
+	memset(&frame->canvas, 0, sizeof(frame->canvas));
+}
+
+static void destroy_optimal(struct vk_minimal_context *actx)
+{
+	actx->dev->vkd.vkDestroyImage(actx->dev->device, actx->optimal.image, NULL);
+	vk_minimal_free(&actx->dev->allocator, &actx->optimal.mem);
+	memset(&actx->optimal, 0, sizeof(actx->optimal));
+}
+
+static void destroy_compute(struct vk_minimal_context *actx)
+{
+	actx->dev->vkd.vkDestroyPipeline(actx->dev->device, actx->compute.pipeline, NULL);
+	actx->dev->vkd.vkDestroyPipelineLayout(actx->dev->device, actx->compute.pipeline_layout, NULL);
+	actx->dev->vkd.vkDestroyDescriptorPool(actx->dev->device, actx->compute.desc_pool, NULL);
+	actx->dev->vkd.vkDestroyDescriptorSetLayout(actx->dev->device, actx->compute.set_layout, NULL);
+	actx->dev->vkd.vkDestroyShaderModule(actx->dev->device, actx->compute.module, NULL);
+	actx->dev->vkd.vkDestroyImageView(actx->dev->device, actx->compute.view, NULL);
+	actx->dev->vkd.vkDestroyImage(actx->dev->device, actx->compute.image, NULL);
+	vk_minimal_free(&actx->dev->allocator, &actx->compute.mem);
+	memset(&actx->compute, 0, sizeof(actx->compute));
+}
+
+static void destroy_offscreen(struct vk_minimal_context *actx)
+{
+	uint32_t i;
+
+	for (i = 0; i < actx->swapchain.count; i++)
+	{
+		actx->dev->vkd.vkDestroyImage(actx->dev->device, actx->swapchain.images[i], NULL);
+		vk_minimal_free(&actx->dev->allocator, &actx->swapchain.memory[i]);
+	}
+	free(actx->swapchain.images);
+	free(actx->swapchain.memory);
+	actx->swapchain.images = NULL;
+	actx->swapchain.memory = NULL;
+}
+
+// Once the copies completed, hands what is left to the writer and waits for it
+static void destroy_readback(struct vk_minimal_context *actx)
+{
+	uint32_t i;
+
+	hand_over_captures(actx, VK_TRUE);
+	vk_minimal_capture_drain(&actx->capture);
+	for (i = 0; i < actx->readback_count; i++)
+	{
+		actx->dev->vkd.vkDestroyBuffer(actx->dev->device, actx->readback[i].buffer, NULL);
+		vk_minimal_free(&actx->dev->allocator, &actx->readback[i].mem);
+	}
+	memset(actx->readback, 0, sizeof(actx->readback));
+	actx->readback_count = 0;
+	actx->readback_next = 0;
+}
+
+// Waits for every slot, which covers all the work this context has queued
+// along with that of the other contexts on the device
+static void wait_frames(struct vk_minimal_context *actx)
+{
+	VkResult err;
+
+	err = actx->dev->vkd.vkWaitForFences(actx->dev->device, actx->dev->frames_in_flight, actx->dev->fences, VK_TRUE, UINT64_MAX);
+	assert(err == VK_SUCCESS);
+}
+
+// Grows the slot's recordings to the image count. Everything is recorded
+// again as the images changed, each buffer only once its slot comes up so
+// none of them is pending at the time.
+static void reset_recordings(struct vk_minimal_context *actx, struct vk_minimal_frame *frame)
+{
+	VkResult err;
+	uint32_t i;
+
+	if (frame->recording_count < actx->swapchain.count)
+	{
+		VkCommandBufferAllocateInfo cbai;
+		memset(&cbai, 0, sizeof(cbai));
+		cbai.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		cbai.pNext = NULL;
+		cbai.commandPool = actx->cmd_pool;
+		cbai.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		cbai.commandBufferCount = 1;
+
+		frame->recordings = realloc(frame->recordings, sizeof(frame->recordings[0])*actx->swapchain.count);
+		for (i = frame->recording_count; i < actx->swapchain.count; i++)
+		{
+			err = actx->dev->vkd.vkAllocateCommandBuffers(actx->dev->device, &cbai, &frame->recordings[i].cmd);
+			assert(err == VK_SUCCESS);
+		}
+		frame->recording_count = actx->swapchain.count;
+	}
+
+	for (i = 0; i < frame->recording_count; i++)
+	{
+		frame->recordings[i].valid = VK_FALSE;
+	}
+}
+
+// Returns 0 while the surface has no area, e.g. when the window is minimized.
+// The old swapchain is retired rather than destroyed so nothing waits for
+// the frames still in flight, only a change of extent or format waits for
+// them before the canvases are replaced.
+static int recreate_swapchain(struct vk_minimal_context *actx)
+{
+	VkResult err;
+	VkExtent2D old_extent = actx->extent;
+	VkFormat old_format = actx->swapchain.format;
+	uint32_t i;
+
+	if (actx->surface)
+	{
+		VkSurfaceCapabilitiesKHR surf_cap;
+		err = actx->dev->vki.vkGetPhysicalDeviceSurfaceCapabilitiesKHR(actx->dev->gpu, actx->surface, &surf_cap);
+		assert(err == VK_SUCCESS);
+		if (surf_cap.currentExtent.width == 0 || surf_cap.currentExtent.height == 0)
+			return 0;
+
+		// There is none to retire after vk_minimal_surface_lost()
+		if (actx->swapchain.swapchain)
+		{
+			// Only one is retired at a time, one that is still waiting goes now
+			if (actx->swapchain.retired)
+			{
+				wait_frames(actx);
+				actx->dev->vkd.vkDestroySwapchainKHR(actx->dev->device, actx->swapchain.retired, NULL);
+			}
+			actx->swapchain.retired = actx->swapchain.swapchain;
+			actx->swapchain.retired_frame = actx->frame_count;
+		}
+		create_swapchain(actx);
+	}
+	else
+	{
+		// Offscreen images are ours, and the frames in flight copy into them
+		wait_frames(actx);
+		destroy_offscreen(actx);
+		create_offscreen(actx);
+	}
+	reset_images(actx);
+
+	if (actx->extent.width != old_extent.width || actx->extent.height != old_extent.height ||
+	    actx->swapchain.format != old_format)
+	{
+		// The frames in flight still read from the canvases
+		wait_frames(actx);
+		choose_canvas(actx);
+		if (actx->upload == VK_MINIMAL_UPLOAD_COMPUTE)
+		{
+			destroy_compute(actx);
+			create_compute(actx);
+		}
+		else
+		{
+			vk_minimal_fill_destroy(&actx->fill);
+			vk_minimal_fill_init(&actx->fill, actx->fill_path, actx->canvas.fill_format, actx->extent.width);
+			// Queued commands were clipped to the old extent
+			vk_minimal_batch_destroy(&actx->batch);
+			vk_minimal_batch_init(&actx->batch, actx->extent.width, actx->extent.height);
+			for (i = 0; i < actx->frames_in_flight; i++)
+			{
+				destroy_canvas(actx, &actx->frames[i]);
+				create_canvas(actx, actx->canvas.format, &actx->frames[i]);
+				vk_minimal_damage_clear(&actx->frames[i].damage);
+				vk_minimal_damage_add(&actx->frames[i].damage, full_rect(actx));
+			}
+		}
+		if (actx->upload == VK_MINIMAL_UPLOAD_BUFFER_OPTIMAL)
+		{
+			destroy_optimal(actx);
+			create_optimal(actx, actx->canvas.format);
+		}
+		if (actx->capture_container)
+		{
+			destroy_readback(actx);
+			create_readback(actx);
+		}
+	}
+
+	for (i = 0; i < actx->frames_in_flight; i++)
+	{
+		reset_recordings(actx, &actx->frames[i]);
+	}
+
+	actx->swapchain.stale = VK_FALSE;
+	return 1;
+}
+
+void vk_minimal_resize(struct vk_minimal_context *actx, uint32_t width, uint32_t height)
+{
+	actx->swapchain.requested.width = width;
+	actx->swapchain.requested.height = height;
+	actx->swapchain.stale = VK_TRUE;
+}
+
+void vk_minimal_surface_lost(struct vk_minimal_context *actx)
+{
+	VkResult err;
+
+	// Nothing may still be queued for the images once the window is gone
+	err = actx->dev->vkd.vkDeviceWaitIdle(actx->dev->device);
+	assert(err == VK_SUCCESS);
+
+	if (actx->swapchain.retired)
+		actx->dev->vkd.vkDestroySwapchainKHR(actx->dev->device, actx->swapchain.retired, NULL);
+	actx->dev->vkd.vkDestroySwapchainKHR(actx->dev->device, actx->swapchain.swapchain, NULL);
+	free(actx->swapchain.images);
+	actx->swapchain.images = NULL;
+	actx->swapchain.count = 0;
+	actx->swapchain.swapchain = VK_NULL_HANDLE;
+	actx->swapchain.retired = VK_NULL_HANDLE;
+	actx->surface = VK_NULL_HANDLE;
+}
+
+void vk_minimal_surface_created(struct vk_minimal_context *actx, VkSurfaceKHR surface)
+{
+	VkBool32 supported;
+
+	// The device was picked for the first surface, a later one has to do
+	// with the same presenting queue
+	actx->dev->vki.vkGetPhysicalDeviceSurfaceSupportKHR(actx->dev->gpu, actx->dev->queue_family, surface, &supported);
+	assert(supported);
+
+	actx->surface = surface;
+	actx->swapchain.stale = VK_TRUE;
+}
+
+// Everything for one context up to the submit, once the slot is free.
+// Returns 0 when the frame is dropped, otherwise si is what goes into the
+// batch and image_idx the image to present.
+static int prepare_frame(struct vk_minimal_context *actx, VkSubmitInfo *si, uint32_t *image_idx)
+{
+	static const VkPipelineStageFlags stage_flags = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+	VkResult err;
+	struct vk_minimal_frame *frame = &actx->frames[actx->frame_idx];
+
+	// Every frame that used the retired swapchain has completed once the
+	// slots have all come around since
+	if (actx->swapchain.retired && actx->frame_count + 1 >= actx->swapchain.retired_frame + actx->frames_in_flight)
+	{
+		actx->dev->vkd.vkDestroySwapchainKHR(actx->dev->device, actx->swapchain.retired, NULL);
+		actx->swapchain.retired = VK_NULL_HANDLE;
+	}
+
+	uint64_t t0 = now_ns();
+	uint32_t i;
+
+	// The slot was waited for, which completes the copies of the submit
+	// that used it before
+	if (actx->capture_container)
+		hand_over_captures(actx, VK_FALSE);
+
+	vk_minimal_damage_clear(&actx->damage);
+	if (actx->upload == VK_MINIMAL_UPLOAD_COMPUTE)
+	{
+		compute_grid(actx);
+	}
+	else
+	{
+		draw_grid(actx, frame);
+
+		// The other canvases now lag behind by what was drawn into this one
+		for (i = 0; i < actx->frames_in_flight; i++)
+		{
+			if (&actx->frames[i] != frame)
+				vk_minimal_damage_union(&actx->frames[i].damage, &actx->damage);
+		}
+		vk_minimal_damage_clear(&frame->damage);
+
+		if (!frame->canvas.coherent)
+		{
+			err = vk_minimal_alloc_flush(&actx->dev->allocator, &frame->canvas.mem, 0, VK_WHOLE_SIZE);
+			assert(err == VK_SUCCESS);
+		}
+	}
+
+	uint32_t idx = 0;
+	uint64_t t1 = now_ns();
+	VK_MINIMAL_PROF_PHASE(&actx->prof, actx->frame_idx, VK_MINIMAL_PROF_FILL);
+
+	if (actx->swapchain.swapchain)
+	{
+		err = actx->dev->vkd.vkAcquireNextImageKHR(actx->dev->device, actx->swapchain.swapchain, UINT64_MAX, frame->acquire_sem, VK_NULL_HANDLE, &idx);
+		if (err == VK_ERROR_OUT_OF_DATE_KHR)
+		{
+			// Nothing was acquired, the next call recreates and draws again
+			actx->swapchain.stale = VK_TRUE;
+			return 0;
+		}
+		// Still presentable, recreated after this frame
+		if (err == VK_SUBOPTIMAL_KHR)
+			actx->swapchain.stale = VK_TRUE;
+		else
+			assert(err == VK_SUCCESS);
+
+		// How long the image was held by the presentation engine
+		if (actx->swapchain.present_ns[idx])
+			actx->stats.present_to_acquire_ns = now_ns() - actx->swapchain.present_ns[idx];
+	}
+	else
+	{
+		idx = actx->swapchain.next;
+		actx->swapchain.next = (idx + 1) % actx->swapchain.count;
+	}
+
+	uint64_t t2 = now_ns();
+	VK_MINIMAL_PROF_PHASE(&actx->prof, actx->frame_idx, VK_MINIMAL_PROF_ACQUIRE);
+
+	// The image needs everything that changed since it was last presented
+	struct vk_minimal_damage *damage = &actx->swapchain.damage[idx];
+	for (i = 0; i < actx->swapchain.count; i++)
+	{
+		vk_minimal_damage_union(&actx->swapchain.damage[i], &actx->damage);
+	}
+
+	if (actx->upload == VK_MINIMAL_UPLOAD_BUFFER_OPTIMAL)
+		vk_minimal_damage_union(&actx->optimal.damage, &actx->damage);
+
+	// Steady state damage is the same every frame, so after the first round
+	// through the images the recorded buffers are simply submitted again
+	struct vk_minimal_recording *rec = &frame->recordings[idx];
+	if (!recording_matches(actx, rec, idx, damage))
+	{
+		VkCommandBufferBeginInfo cbbi;
+		memset(&cbbi, 0, sizeof(cbbi));
+		cbbi.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		cbbi.pNext = NULL;
+		cbbi.flags = 0;
+		cbbi.pInheritanceInfo = NULL;
+
+		err = actx->dev->vkd.vkBeginCommandBuffer(rec->cmd, &cbbi);
+		assert(err == VK_SUCCESS);
+
+		VK_MINIMAL_PROF_GPU_BEGIN(&actx->prof, rec->cmd, actx->frame_idx);
+		record_upload(actx, rec->cmd, frame, idx, damage);
+		VK_MINIMAL_PROF_GPU_END(&actx->prof, rec->cmd, actx->frame_idx);
+
+		err = actx->dev->vkd.vkEndCommandBuffer(rec->cmd);
+		assert(err == VK_SUCCESS);
+
+		save_recording(actx, rec, idx, damage);
+		actx->stats.recordings++;
+	}
+	VK_MINIMAL_PROF_PHASE(&actx->prof, actx->frame_idx, VK_MINIMAL_PROF_RECORD);
+
+	actx->stats.transfer_bytes = finish_upload(actx, idx, damage);
+	actx->stats.transfer_bytes_total += actx->stats.transfer_bytes;
+
+	frame->submit_cmds[0] = rec->cmd;
+	frame->submit_cmds[1] = frame->capture_cmd;
+	uint32_t cmd_count = capture_frame(actx, frame, idx) ? 2 : 1;
+
+	memset(si, 0, sizeof(*si));
+	si->sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	si->pNext = NULL;
+	// Offscreen images are neither acquired nor presented
+	si->waitSemaphoreCount = actx->swapchain.swapchain ? 1 : 0;
+	si->pWaitSemaphores = &frame->acquire_sem;
+	si->pWaitDstStageMask = &stage_flags;
+	si->commandBufferCount = cmd_count;
+	si->pCommandBuffers = frame->submit_cmds;
+	si->signalSemaphoreCount = actx->swapchain.swapchain ? 1 : 0;
+	si->pSignalSemaphores = &frame->render_sem;
+
+	*image_idx = idx;
+	actx->stats.cpu_ns = (t1 - t0) + (now_ns() - t2);
+	return 1;
+}
+
+void vk_minimal_draw_many(struct vk_minimal_context *const *actxs, uint32_t count)
+{
+	struct vk_minimal_device *dev = actxs[0]->dev;
+	struct vk_minimal_context *drawn[count];
+	VkSubmitInfo si[count];
+	uint32_t image_idx[count];
+	VkSwapchainKHR swapchains[count];
+	uint32_t present_idx[count];
+	VkSemaphore render_sems[count];
+	VkResult results[count];
+	uint32_t i, n, presents;
+	VkResult err;
+
+	// Recreating waits for the slots by itself, a context without area sits
+	// this one out
+	for (i = 0, n = 0; i < count; i++)
+	{
+		assert(actxs[i]->dev == dev);
+		if (actxs[i]->swapchain.stale && !recreate_swapchain(actxs[i]))
+			continue;
+		drawn[n++] = actxs[i];
+		VK_MINIMAL_PROF_BEGIN(&actxs[i]->prof);
+	}
+	if (n == 0)
+		return;
+
+	// Wait until the GPU is done with this slot, the other slots may still be
+	// in flight. The fence is only reset right before the submit, as a frame
+	// is dropped if its swapchain turns out to be out of date.
+	err = dev->vkd.vkWaitForFences(dev->device, 1, &dev->fences[dev->frame_idx], VK_TRUE, UINT64_MAX);
+	assert(err == VK_SUCCESS);
+
+	for (i = 0; i < n; i++)
+	{
+		drawn[i]->frame_idx = dev->frame_idx;
+		VK_MINIMAL_PROF_RESOLVE(&drawn[i]->prof, dev->device, dev->frame_idx);
+		VK_MINIMAL_PROF_PHASE(&drawn[i]->prof, dev->frame_idx, VK_MINIMAL_PROF_WAIT);
+	}
+
+	count = n;
+	for (i = 0, n = 0; i < count; i++)
+	{
+		VK_MINIMAL_PROF_MARK(&drawn[i]->prof, dev->frame_idx);
+		if (prepare_frame(drawn[i], &si[n], &image_idx[n]))
+			drawn[n++] = drawn[i];
+	}
+	if (n == 0)
+		return;
+
+	// Submitting and presenting cost the same for a batch as for a single
+	// frame, each context is charged all of it
+	uint64_t t0 = now_ns();
+	for (i = 0; i < n; i++)
+	{
+		VK_MINIMAL_PROF_MARK(&drawn[i]->prof, dev->frame_idx);
+	}
+
+	err = dev->vkd.vkResetFences(dev->device, 1, &dev->fences[dev->frame_idx]);
+	assert(err == VK_SUCCESS);
+	err = dev->vkd.vkQueueSubmit(dev->upload_queue, n, si, dev->fences[dev->frame_idx]);
+	assert(err == VK_SUCCESS);
+	dev->submits++;
+
+	uint64_t submit_ns = now_ns() - t0;
+	for (i = 0, presents = 0; i < n; i++)
+	{
+		struct vk_minimal_context *actx = drawn[i];
+
+		actx->stats.cpu_ns += submit_ns;
+		VK_MINIMAL_PROF_PHASE(&actx->prof, dev->frame_idx, VK_MINIMAL_PROF_SUBMIT);
+		VK_MINIMAL_PROF_SUBMITTED(&actx->prof, dev->frame_idx);
+		if (actx->swapchain.swapchain)
+		{
+			swapchains[presents] = actx->swapchain.swapchain;
+			present_idx[presents] = image_idx[i];
+			render_sems[presents] = actx->frames[dev->frame_idx].render_sem;
+			presents++;
+		}
+	}
+
+	if (presents)
+	{
+		VkPresentInfoKHR pi;
+		memset(&pi, 0, sizeof(pi));
+		pi.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+		pi.pNext = NULL;
+		pi.waitSemaphoreCount = presents;
+		pi.pWaitSemaphores = render_sems;
+		pi.swapchainCount = presents;
+		pi.pSwapchains = swapchains;
+		pi.pImageIndices = present_idx;
+		pi.pResults = results;
+
+		// Out of date swapchains only affect their own result
+		err = dev->vkd.vkQueuePresentKHR(dev->queue, &pi);
+		assert(err == VK_SUCCESS || err == VK_SUBOPTIMAL_KHR || err == VK_ERROR_OUT_OF_DATE_KHR);
+
+		uint64_t now = now_ns();
+		for (i = 0, presents = 0; i < n; i++)
+		{
+			struct vk_minimal_context *actx = drawn[i];
+
+			if (!actx->swapchain.swapchain)
+				continue;
+			if (results[presents] == VK_ERROR_OUT_OF_DATE_KHR || results[presents] == VK_SUBOPTIMAL_KHR)
+				actx->swapchain.stale = VK_TRUE;
+			else
+				assert(results[presents] == VK_SUCCESS);
+			actx->swapchain.present_ns[image_idx[i]] = now;
+			presents++;
+		}
+	}
+
+	for (i = 0; i < n; i++)
+	{
+		VK_MINIMAL_PROF_PHASE(&drawn[i]->prof, dev->frame_idx, VK_MINIMAL_PROF_PRESENT);
+		drawn[i]->frame_count++;
+	}
+	dev->frame_idx = (dev->frame_idx + 1) % dev->frames_in_flight;
+}
+
+void vk_minimal_draw(struct vk_minimal_context *actx)
+{
+	vk_minimal_draw_many(&actx, 1);
+}
+
+void vk_minimal_destroy(struct vk_minimal_context *actx)
+{
+	VkResult err;
+	uint32_t i, j;
+
+	err = actx->dev->vkd.vkDeviceWaitIdle(actx->dev->device);
+	assert(err == VK_SUCCESS);
+
+	if (actx->capture_container)
+	{
+		destroy_readback(actx);
+		vk_minimal_capture_destroy(&actx->capture);
+	}
+
+	for (i = 0; i < actx->frames_in_flight; i++)
+	{
+		struct vk_minimal_frame *frame = &actx->frames[i];
+
+		destroy_canvas(actx, frame);
+		if (frame->capture_cmd)
+			actx->dev->vkd.vkFreeCommandBuffers(actx->dev->device, actx->cmd_pool, 1, &frame->capture_cmd);
+		for (j = 0; j < frame->recording_count; j++)
+		{
+			actx->dev->vkd.vkFreeCommandBuffers(actx->dev->device, actx->cmd_pool, 1, &frame->recordings[j].cmd);
+		}
+		free(frame->recordings);
+		actx->dev->vkd.vkDestroySemaphore(actx->dev->device, frame->acquire_sem, NULL);
+		actx->dev->vkd.vkDestroySemaphore(actx->dev->device, frame->render_sem, NULL);
+		memset(frame, 0, sizeof(*frame));
+	}
+
+	if (actx->optimal.image)
+		destroy_optimal(actx);
+
+	if (actx->compute.image)
+	{
+		destroy_compute(actx);
+	}
+	else
+	{
+		vk_minimal_pool_destroy(&actx->pool);
+		vk_minimal_batch_destroy(&actx->batch);
+		vk_minimal_fill_destroy(&actx->fill);
+	}
+
+#ifdef VK_MINIMAL_PROFILE
+	vk_minimal_prof_destroy(&actx->prof, actx->dev->device);
+#endif
+
+	actx->dev->vkd.vkDestroyCommandPool(actx->dev->device, actx->cmd_pool, NULL);
+
+	if (actx->swapchain.swapchain)
+	{
+		actx->dev->vkd.vkDestroySwapchainKHR(actx->dev->device, actx->swapchain.swapchain, NULL);
+		free(actx->swapchain.images);
+	}
+	else
+	{
+		destroy_offscreen(actx);
+	}
+	if (actx->swapchain.retired)
+		actx->dev->vkd.vkDestroySwapchainKHR(actx->dev->device, actx->swapchain.retired, NULL);
+	free(actx->swapchain.damage);
+	free(actx->swapchain.layouts);
+	free(actx->swapchain.present_ns);
+	memset(&actx->swapchain, 0, sizeof(actx->swapchain));
+
+	if (actx->owns_dev)
+	{
+		vk_minimal_device_destroy(actx->dev);
+		free(actx->dev);
+	}
+	actx->dev = NULL;
+	actx->owns_dev = VK_FALSE;
+}
@@ -29,30 +29,365 @@ For more information, please refer to <http://unlicense.org>
 #define VK_MINIMAL_H
 
 #include "vulkan_dlfcn/vulkan_dlfcn.h"
+#include "vk_minimal_alloc.h"
+#include "vk_minimal_damage.h"
+#include "vk_minimal_batch.h"
+#include "vk_minimal_capture.h"
+#include "vk_minimal_fill.h"
+#include "vk_minimal_pool.h"
+#include "vk_minimal_prof.h"
 
-struct vk_minimal_context {
+enum vk_minimal_upload {
+	// Host visible linear image, copied image to image
+	VK_MINIMAL_UPLOAD_LINEAR_IMAGE = 0,
+	// Host visible buffer, copied into a device local optimal image and from there to the swapchain
+	VK_MINIMAL_UPLOAD_BUFFER_OPTIMAL,
+	// Host visible buffer, copied straight into the swapchain image
+	VK_MINIMAL_UPLOAD_BUFFER_SWAPCHAIN,
+	// Generated by a compute shader into a device local storage image, no host writes
+	VK_MINIMAL_UPLOAD_COMPUTE,
+	VK_MINIMAL_UPLOAD_COUNT
+};
+
+enum vk_minimal_canvas_format {
+	// 32 bit in the swapchain format, copied as is
+	VK_MINIMAL_CANVAS_NATIVE = 0,
+	// 16 bit, half of what the host writes and the GPU reads for a 32 bit
+	// canvas. Blitted to the swapchain when the device can.
+	VK_MINIMAL_CANVAS_RGB565,
+	VK_MINIMAL_CANVAS_RGBA4444,
+	VK_MINIMAL_CANVAS_FORMAT_COUNT
+};
+
+enum vk_minimal_present_policy {
+	// Mailbox if available, otherwise immediate or FIFO, with few images queued
+	VK_MINIMAL_PRESENT_LOW_LATENCY = 0,
+	// Immediate or mailbox, with an extra image to render into
+	VK_MINIMAL_PRESENT_MAX_THROUGHPUT,
+	// FIFO with the fewest images, frames are paced by the display
+	VK_MINIMAL_PRESENT_POWER_SAVING,
+	VK_MINIMAL_PRESENT_POLICY_COUNT
+};
+
+// How the host accesses an allocation, steers the choice of memory type
+enum vk_minimal_mem_access {
+	VK_MINIMAL_MEM_GPU_ONLY = 0,
+	// Written front to back by the host and read by the GPU
+	VK_MINIMAL_MEM_SEQUENTIAL_WRITE,
+	// Read by the host in no particular order
+	VK_MINIMAL_MEM_RANDOM_READ,
+	// Written by the GPU and read back by the host
+	VK_MINIMAL_MEM_READBACK,
+	VK_MINIMAL_MEM_ACCESS_COUNT
+};
+
+#define VK_MINIMAL_MAX_FRAMES_IN_FLIGHT 4
+#define VK_MINIMAL_DEFAULT_FRAMES_IN_FLIGHT 2
+
+// Used when vk_minimal_init() is called without a surface
+#define VK_MINIMAL_HEADLESS_IMAGES 3
+#define VK_MINIMAL_HEADLESS_WIDTH 1920
+#define VK_MINIMAL_HEADLESS_HEIGHT 1080
+
+// A command buffer recorded for one swapchain image from one slot. It is
+// submitted again as is for as long as the state it was recorded from still
+// holds, and only re-recorded once that changes.
+struct vk_minimal_recording {
+	VkCommandBuffer cmd;
+	VkBool32 valid;
+
+	// What the recorded commands depend on
+	VkImageLayout layout;
+	VkImageLayout optimal_layout;
+	uint32_t compute_cntr;
+	struct vk_minimal_damage damage;
+	struct vk_minimal_damage optimal_damage;
+};
+
+// Everything that is touched while a frame is in flight. A slot is reused
+// only after the device's fence for it has signaled so the CPU can fill the
+// canvas of the next slot while the GPU is still copying and presenting the
+// previous one.
+struct vk_minimal_frame {
+	// One per swapchain image, a buffer is never pending when its slot is
+	// reused so it can be submitted again without the simultaneous use flag.
+	// Kept when the swapchain shrinks so that it can grow back.
+	struct vk_minimal_recording *recordings;
+	uint32_t recording_count;
+	VkSemaphore acquire_sem;
+	VkSemaphore render_sem;
+	// Recorded every frame that is captured, follows the upload in the submit
+	VkCommandBuffer capture_cmd;
+	VkCommandBuffer submit_cmds[2];
+
+	struct {
+		// Either image or buffer depending on the upload mode
+		VkImage image;
+		VkBuffer buffer;
+		struct vk_minimal_allocation mem;
+		VkDeviceSize size;
+
+		// Mapped once at init, the layout of a linear image never changes
+		void *data;
+		VkSubresourceLayout layout;
+		VkDeviceSize row_pitch;
+		VkBool32 coherent;
+	} canvas;
+
+	// Damage drawn into the other slots since this canvas was last drawn
+	struct vk_minimal_damage damage;
+};
+
+// Shared by every context presenting through it, one per VkDevice
+struct vk_minimal_device {
 	VkInstance instance;
+	VkPhysicalDevice gpu;
 	VkDevice device;
-	VkSurfaceKHR surface;
+	// Everything after vkCreateDevice() calls through these instead of the
+	// loader globals
+	struct vulkan_dlfcn_instance vki;
+	struct vulkan_dlfcn_device vkd;
+	// Graphics queue, also the one that presents
 	VkQueue queue;
-	VkCommandBuffer cmd;
+	uint32_t queue_family;
+	// Canvas uploads are submitted here, a queue of its own when the device
+	// has a family without graphics, otherwise the same as queue
+	VkQueue upload_queue;
+	uint32_t upload_family;
+
+	// Queried once at init, used to rank memory types for every allocation
+	VkPhysicalDeviceMemoryProperties mem_props;
+	VkPhysicalDeviceProperties props;
+	VkQueueFlags upload_flags;
+	// Of the upload family, 0 when it can't reset query pools
+	uint32_t timestamp_valid_bits;
+	// Every resource is a range in one of its blocks
+	struct vk_minimal_allocator allocator;
+
+	// Every submit takes the next slot, whichever contexts it carries, so
+	// the contexts have their frame slots in step with these
+	uint32_t frames_in_flight;
+	uint32_t frame_idx;
+	VkFence fences[VK_MINIMAL_MAX_FRAMES_IN_FLIGHT];
+	// Submits so far. Submit n has completed once submit n + frames_in_flight
+	// waited for the fence of their slot.
+	uint64_t submits;
+};
+
+// One surface with its swapchain, canvases and sync, presenting through a
+// device of its own or one shared with other contexts
+struct vk_minimal_context {
+	// Set before vk_minimal_init() to share a device created by
+	// vk_minimal_device_init(), otherwise one is created for this context
+	// from instance, single_queue and frames_in_flight
+	struct vk_minimal_device *dev;
+	VkBool32 owns_dev;
+	VkInstance instance;
+	// Setting it keeps the uploads on the graphics queue
+	VkBool32 single_queue;
+	// VK_NULL_HANDLE renders into a ring of offscreen images instead of a
+	// swapchain, the extent may then be set before vk_minimal_init()
+	VkSurfaceKHR surface;
+	// Command buffers for the upload queue
+	VkCommandPool cmd_pool;
 
 	struct {
+		// VK_NULL_HANDLE when headless, the images and memory are then ours
 		VkSwapchainKHR swapchain;
 		VkImage *images;
+		struct vk_minimal_allocation *memory;
+		uint32_t count;
+		uint32_t next;
+		VkFormat format;
+
+		// Recreated by the next vk_minimal_draw() once set, the requested
+		// extent is used when the surface leaves the extent to the swapchain
+		// and for offscreen images
+		VkBool32 stale;
+		VkExtent2D requested;
+
+		// Replaced by a recreation, destroyed once the frames in flight at
+		// that point have completed
+		VkSwapchainKHR retired;
+		uint64_t retired_frame;
+
+		// PRESENT_SRC, or TRANSFER_SRC for offscreen images
+		VkImageLayout final_layout;
+
+		// When each image was last presented, NULL when headless
+		uint64_t *present_ns;
+
+		// Per image damage since it was last presented and its current layout
+		struct vk_minimal_damage *damage;
+		VkImageLayout *layouts;
 	} swapchain;
 
+	// Set before vk_minimal_init()
+	enum vk_minimal_upload upload;
+
+	// Set before vk_minimal_init(), ignored by VK_MINIMAL_UPLOAD_COMPUTE
+	enum vk_minimal_canvas_format canvas_format;
+
+	// What the canvases are held in. A 16 bit format that can't be blitted
+	// with the upload mode in use, or at all, falls back to a canvas in the
+	// swapchain format that the fill converts into on the CPU.
 	struct {
-		VkImage image;
-		VkDeviceMemory dm;
-		VkDeviceSize size;
+		VkFormat format;
+		uint32_t bpp;
+		VkBool32 blit;
+		enum vk_minimal_fill_format fill_format;
 	} canvas;
 
+	// Device local copy of the canvas for VK_MINIMAL_UPLOAD_BUFFER_OPTIMAL
+	struct {
+		VkImage image;
+		struct vk_minimal_allocation mem;
+		VkImageLayout layout;
+		struct vk_minimal_damage damage;
+	} optimal;
+
+	// Storage image and pipeline for VK_MINIMAL_UPLOAD_COMPUTE
+	struct {
+		VkImage image;
+		struct vk_minimal_allocation mem;
+		VkImageView view;
+		VkImageLayout layout;
+
+		VkShaderModule module;
+		VkDescriptorSetLayout set_layout;
+		VkDescriptorPool desc_pool;
+		VkDescriptorSet set;
+		VkPipelineLayout pipeline_layout;
+		VkPipeline pipeline;
+
+		// Counter value pushed for the frame being recorded
+		uint32_t cntr;
+	} compute;
+
+	// Set before vk_minimal_init(), the present mode and image count are
+	// picked from what the surface supports and logged
+	enum vk_minimal_present_policy present_policy;
+
+	// Set before vk_minimal_init() to bypass the policy and request a present
+	// mode. Holds the mode in use after init either way.
+	VkBool32 present_mode_override;
+	VkPresentModeKHR present_mode;
+
+	// Set before vk_minimal_init() when creating the device, 0 selects the
+	// default. Taken from the device otherwise.
+	uint32_t frames_in_flight;
+	// Slot of the frame being drawn
+	uint32_t frame_idx;
+	struct vk_minimal_frame frames[VK_MINIMAL_MAX_FRAMES_IN_FLIGHT];
+
+	// Set before vk_minimal_init(), VK_MINIMAL_FILL_AUTO picks the best path for the CPU
+	enum vk_minimal_fill_path fill_path;
+	struct vk_minimal_fill fill;
+
+	// Set before vk_minimal_init(), 0 uses one fill thread per online CPU
+	uint32_t fill_threads;
+	struct vk_minimal_pool pool;
+
+	// Queued by the vk_minimal_canvas_*() calls for the next frame
+	struct vk_minimal_batch batch;
+
+	// Marked by the draw routines for the frame being drawn
+	struct vk_minimal_damage damage;
+
+	// Set before vk_minimal_init(), VK_MINIMAL_CAPTURE_OFF reads nothing back.
+	// Every capture_interval-th frame, 0 counting as 1, is copied into a
+	// ring of host cached buffers that the writer streams to capture_path
+	// once the copy completed. A frame is dropped from the capture rather
+	// than waited for when the writer still has every buffer.
+	enum vk_minimal_capture_container capture_container;
+	const char *capture_path;
+	uint32_t capture_interval;
+	struct vk_minimal_capture capture;
+
+	struct {
+		VkBuffer buffer;
+		struct vk_minimal_allocation mem;
+		VkBool32 coherent;
+		// Copied into by device submit number submit, not yet handed over
+		VkBool32 pending;
+		uint64_t submit;
+		struct vk_minimal_capture_job job;
+	} readback[VK_MINIMAL_CAPTURE_MAX_BUFFERS];
+	uint32_t readback_count;
+	// Oldest buffer, the next one to capture into
+	uint32_t readback_next;
+
+	struct {
+		// Bytes the GPU read from host memory for the last frame and in total
+		uint64_t transfer_bytes;
+		uint64_t transfer_bytes_total;
+		// Time spent on the CPU producing and submitting the last frame,
+		// not counting the waits for a free slot and a swapchain image
+		uint64_t cpu_ns;
+		// Time between presenting the image that was last acquired and
+		// getting it back, 0 until an image comes around a second time
+		uint64_t present_to_acquire_ns;
+		// Command buffers recorded so far, frames that reused one don't count
+		uint64_t recordings;
+		// Frames copied for the capture and those skipped as no buffer was free
+		uint64_t captured;
+		uint64_t capture_dropped;
+	} stats;
+
+	// Per phase timings, only collected when built with VK_MINIMAL_PROFILE
+	struct vk_minimal_prof prof;
+
 	uint32_t cntr;
 	VkExtent2D extent;
+	// Frames of this context submitted so far
+	uint64_t frame_count;
 };
 
+// surface is one the device has to present to, VK_NULL_HANDLE for a device
+// that only renders offscreen. need_compute picks an upload family that can
+// run VK_MINIMAL_UPLOAD_COMPUTE.
+void vk_minimal_device_init(struct vk_minimal_device *dev, VkInstance instance, VkSurfaceKHR surface,
+                            uint32_t frames_in_flight, VkBool32 single_queue, VkBool32 need_compute);
+// After every context using it was destroyed
+void vk_minimal_device_destroy(struct vk_minimal_device *dev);
+
 void vk_minimal_init(struct vk_minimal_context *actx);
 void vk_minimal_draw(struct vk_minimal_context *actx);
+// Draws a frame for each context with one submit and presents all of their
+// swapchains with one present. The contexts share a device.
+void vk_minimal_draw_many(struct vk_minimal_context *const *actxs, uint32_t count);
+// Has the next vk_minimal_draw() recreate the swapchain, e.g. on a window
+// resize. Surfaces that report their own extent ignore width and height.
+void vk_minimal_resize(struct vk_minimal_context *actx, uint32_t width, uint32_t height);
+// Waits for the device to go idle and destroys the swapchain so the caller
+// can destroy the surface, e.g. when the window goes away. The device and
+// canvases are kept, vk_minimal_draw() must not be called until a new
+// surface is handed over with vk_minimal_surface_created().
+void vk_minimal_surface_lost(struct vk_minimal_context *actx);
+void vk_minimal_surface_created(struct vk_minimal_context *actx, VkSurfaceKHR surface);
+// Waits for the device to go idle and destroys everything created by
+// vk_minimal_init(), the surface and instance are left to the caller. A
+// shared device is left too.
+void vk_minimal_destroy(struct vk_minimal_context *actx);
+// Draw over the grid of the next vk_minimal_draw(), from the thread that
+// calls it. Only what is queued for a frame is shown in it, so overlays are
+// queued again every frame. Sources and atlases are read when the frame is
+// drawn. Each returns the area it dirties clipped to the extent, empty when
+// nothing is visible. Not available with VK_MINIMAL_UPLOAD_COMPUTE.
+struct vk_minimal_rect vk_minimal_canvas_clear(struct vk_minimal_context *actx, uint32_t color);
+struct vk_minimal_rect vk_minimal_canvas_fill_rect(struct vk_minimal_context *actx, int32_t x, int32_t y, uint32_t width, uint32_t height,
+                                                   uint32_t color);
+struct vk_minimal_rect vk_minimal_canvas_hline(struct vk_minimal_context *actx, int32_t x, int32_t y, uint32_t width, uint32_t color);
+struct vk_minimal_rect vk_minimal_canvas_vline(struct vk_minimal_context *actx, int32_t x, int32_t y, uint32_t height, uint32_t color);
+struct vk_minimal_rect vk_minimal_canvas_line(struct vk_minimal_context *actx, int32_t x0, int32_t y0, int32_t x1, int32_t y1, uint32_t color);
+struct vk_minimal_rect vk_minimal_canvas_blend(struct vk_minimal_context *actx, int32_t x, int32_t y, const uint32_t *pixels, uint32_t pitch,
+                                               uint32_t width, uint32_t height);
+struct vk_minimal_rect vk_minimal_canvas_glyph(struct vk_minimal_context *actx, int32_t x, int32_t y, const struct vk_minimal_atlas *atlas,
+                                               uint32_t glyph, uint32_t color);
+
+const char *vk_minimal_upload_name(enum vk_minimal_upload upload);
+const char *vk_minimal_canvas_format_name(enum vk_minimal_canvas_format format);
+const char *vk_minimal_present_policy_name(enum vk_minimal_present_policy policy);
+const char *vk_minimal_present_mode_name(VkPresentModeKHR mode);
 
 #endif
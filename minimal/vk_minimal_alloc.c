@@ -0,0 +1,381 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#include "vk_minimal_alloc.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+static VkDeviceSize align_up(VkDeviceSize v, VkDeviceSize alignment)
+{
+	return alignment > 1 ? (v + alignment - 1) / alignment * alignment : v;
+}
+
+static VkDeviceSize align_down(VkDeviceSize v, VkDeviceSize alignment)
+{
+	return alignment > 1 ? v / alignment * alignment : v;
+}
+
+static void reserve_ranges(struct vk_minimal_alloc_block *block, uint32_t count)
+{
+	if (count <= block->free_capacity)
+		return;
+
+	block->free_capacity = count < 16 ? 16 : 2 * count;
+	block->free = realloc(block->free, sizeof(block->free[0]) * block->free_capacity);
+	assert(block->free);
+}
+
+static void insert_range(struct vk_minimal_alloc_block *block, uint32_t pos, VkDeviceSize offset, VkDeviceSize size)
+{
+	reserve_ranges(block, block->free_count + 1);
+	memmove(&block->free[pos + 1], &block->free[pos], sizeof(block->free[0]) * (block->free_count - pos));
+	block->free[pos].offset = offset;
+	block->free[pos].size = size;
+	block->free_count++;
+}
+
+static void remove_range(struct vk_minimal_alloc_block *block, uint32_t pos)
+{
+	memmove(&block->free[pos], &block->free[pos + 1], sizeof(block->free[0]) * (block->free_count - pos - 1));
+	block->free_count--;
+}
+
+// First fit. Whatever is left in front of and behind the range stays free.
+static int block_alloc(struct vk_minimal_alloc_block *block, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize *offset)
+{
+	uint32_t i;
+
+	for (i = 0; i < block->free_count; i++)
+	{
+		struct vk_minimal_alloc_range r = block->free[i];
+		VkDeviceSize start = align_up(r.offset, alignment);
+		VkDeviceSize end = start + size;
+
+		if (end > r.offset + r.size)
+			continue;
+
+		remove_range(block, i);
+		if (end < r.offset + r.size)
+			insert_range(block, i, end, r.offset + r.size - end);
+		if (start > r.offset)
+			insert_range(block, i, r.offset, start - r.offset);
+
+		*offset = start;
+		return 1;
+	}
+
+	return 0;
+}
+
+static void block_free(struct vk_minimal_alloc_block *block, VkDeviceSize offset, VkDeviceSize size)
+{
+	uint32_t pos = 0;
+
+	while (pos < block->free_count && block->free[pos].offset < offset)
+		pos++;
+
+	// Merge with the neighbours where they touch
+	if (pos > 0 && block->free[pos - 1].offset + block->free[pos - 1].size == offset)
+	{
+		pos--;
+		block->free[pos].size += size;
+	}
+	else
+	{
+		insert_range(block, pos, offset, size);
+	}
+	if (pos + 1 < block->free_count && block->free[pos].offset + block->free[pos].size == block->free[pos + 1].offset)
+	{
+		block->free[pos].size += block->free[pos + 1].size;
+		remove_range(block, pos + 1);
+	}
+}
+
+static VkResult create_block(struct vk_minimal_allocator *a, uint32_t type, VkDeviceSize size, int dedicated, uint32_t *idx)
+{
+	VkResult err;
+	uint32_t i;
+
+	for (i = 0; i < VK_MINIMAL_ALLOC_MAX_BLOCKS; i++)
+	{
+		if (!a->blocks[i].memory)
+			break;
+	}
+	if (i == VK_MINIMAL_ALLOC_MAX_BLOCKS)
+		return VK_ERROR_TOO_MANY_OBJECTS;
+
+	struct vk_minimal_alloc_block *block = &a->blocks[i];
+
+	VkMemoryAllocateInfo mai;
+	memset(&mai, 0, sizeof(mai));
+	mai.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	mai.pNext = NULL;
+	mai.allocationSize = size;
+	mai.memoryTypeIndex = type;
+
+	err = a->vkd->vkAllocateMemory(a->device, &mai, NULL, &block->memory);
+	if (err != VK_SUCCESS)
+	{
+		block->memory = VK_NULL_HANDLE;
+		return err;
+	}
+
+	// Memory can only be mapped once, so the whole block is mapped up front
+	block->data = NULL;
+	if (a->props.memoryTypes[type].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+	{
+		err = a->vkd->vkMapMemory(a->device, block->memory, 0, VK_WHOLE_SIZE, 0, &block->data);
+		assert(err == VK_SUCCESS);
+	}
+
+	block->type = type;
+	block->size = size;
+	block->dedicated = dedicated;
+	block->allocations = 0;
+	block->used = 0;
+	block->free_count = 0;
+	insert_range(block, 0, 0, size);
+
+	if (i >= a->block_count)
+		a->block_count = i + 1;
+	*idx = i;
+
+	return VK_SUCCESS;
+}
+
+static void destroy_block(struct vk_minimal_allocator *a, struct vk_minimal_alloc_block *block)
+{
+	if (block->data)
+		a->vkd->vkUnmapMemory(a->device, block->memory);
+	a->vkd->vkFreeMemory(a->device, block->memory, NULL);
+	free(block->free);
+	memset(block, 0, sizeof(*block));
+}
+
+void vk_minimal_alloc_init(struct vk_minimal_allocator *a, const struct vulkan_dlfcn_device *vkd, VkDevice device, const VkPhysicalDeviceMemoryProperties *props, const VkPhysicalDeviceLimits *limits)
+{
+	memset(a, 0, sizeof(*a));
+	a->vkd = vkd;
+	a->device = device;
+	a->props = *props;
+	a->granularity = limits->bufferImageGranularity;
+	a->atom_size = limits->nonCoherentAtomSize;
+}
+
+void vk_minimal_alloc_destroy(struct vk_minimal_allocator *a)
+{
+	uint32_t i;
+
+	for (i = 0; i < a->block_count; i++)
+	{
+		if (a->blocks[i].memory)
+			destroy_block(a, &a->blocks[i]);
+	}
+	a->block_count = 0;
+}
+
+VkResult vk_minimal_alloc(struct vk_minimal_allocator *a, uint32_t type, const VkMemoryRequirements *mr,
+                          enum vk_minimal_alloc_kind kind, struct vk_minimal_allocation *out)
+{
+	VkDeviceSize size = mr->size;
+	VkDeviceSize alignment = mr->alignment;
+	VkDeviceSize offset = 0;
+	uint32_t i;
+	VkResult err;
+
+	assert(type < a->props.memoryTypeCount && (mr->memoryTypeBits & (1 << type)));
+
+	if (kind == VK_MINIMAL_ALLOC_OPTIMAL && a->granularity > 1)
+	{
+		if (alignment < a->granularity)
+			alignment = a->granularity;
+		size = align_up(size, a->granularity);
+	}
+
+	// Keep regular blocks small compared to the heap they come from
+	VkDeviceSize block_size = VK_MINIMAL_ALLOC_BLOCK_SIZE;
+	VkDeviceSize heap_size = a->props.memoryHeaps[a->props.memoryTypes[type].heapIndex].size;
+	while (block_size > heap_size / 8 && block_size > (1 << 20))
+		block_size /= 2;
+
+	if (size > block_size / 2)
+	{
+		err = create_block(a, type, size, 1, &i);
+		if (err != VK_SUCCESS)
+			return err;
+		// The single range is taken as a whole
+		offset = 0;
+		a->blocks[i].free_count = 0;
+	}
+	else
+	{
+		for (i = 0; i < a->block_count; i++)
+		{
+			struct vk_minimal_alloc_block *block = &a->blocks[i];
+			if (block->memory && !block->dedicated && block->type == type && block_alloc(block, size, alignment, &offset))
+				break;
+		}
+		if (i == a->block_count)
+		{
+			err = create_block(a, type, block_size, 0, &i);
+			if (err != VK_SUCCESS)
+				return err;
+			if (!block_alloc(&a->blocks[i], size, alignment, &offset))
+				assert(0 && "fresh block too small");
+		}
+	}
+
+	struct vk_minimal_alloc_block *block = &a->blocks[i];
+	block->allocations++;
+	block->used += size;
+
+	out->memory = block->memory;
+	out->offset = offset;
+	out->size = size;
+	out->data = block->data ? (uint8_t *)block->data + offset : NULL;
+	out->type = type;
+	out->block = i;
+
+	return VK_SUCCESS;
+}
+
+void vk_minimal_free(struct vk_minimal_allocator *a, struct vk_minimal_allocation *alloc)
+{
+	if (!alloc->memory)
+		return;
+
+	struct vk_minimal_alloc_block *block = &a->blocks[alloc->block];
+	assert(block->memory == alloc->memory && block->allocations > 0);
+
+	block->allocations--;
+	block->used -= alloc->size;
+	if (block->dedicated)
+		destroy_block(a, block);
+	else
+		block_free(block, alloc->offset, alloc->size);
+
+	memset(alloc, 0, sizeof(*alloc));
+}
+
+static void mapped_range(const struct vk_minimal_allocator *a, const struct vk_minimal_allocation *alloc, VkDeviceSize offset, VkDeviceSize size, VkMappedMemoryRange *mmr)
+{
+	const struct vk_minimal_alloc_block *block = &a->blocks[alloc->block];
+
+	if (size == VK_WHOLE_SIZE)
+		size = alloc->size - offset;
+
+	VkDeviceSize start = align_down(alloc->offset + offset, a->atom_size);
+	VkDeviceSize end = align_up(alloc->offset + offset + size, a->atom_size);
+
+	memset(mmr, 0, sizeof(*mmr));
+	mmr->sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+	mmr->pNext = NULL;
+	mmr->memory = alloc->memory;
+	mmr->offset = start;
+	mmr->size = end >= block->size ? VK_WHOLE_SIZE : end - start;
+}
+
+VkResult vk_minimal_alloc_flush(struct vk_minimal_allocator *a, const struct vk_minimal_allocation *alloc, VkDeviceSize offset, VkDeviceSize size)
+{
+	VkMappedMemoryRange mmr;
+
+	mapped_range(a, alloc, offset, size, &mmr);
+	return a->vkd->vkFlushMappedMemoryRanges(a->device, 1, &mmr);
+}
+
+VkResult vk_minimal_alloc_invalidate(struct vk_minimal_allocator *a, const struct vk_minimal_allocation *alloc, VkDeviceSize offset, VkDeviceSize size)
+{
+	VkMappedMemoryRange mmr;
+
+	mapped_range(a, alloc, offset, size, &mmr);
+	return a->vkd->vkInvalidateMappedMemoryRanges(a->device, 1, &mmr);
+}
+
+void vk_minimal_alloc_get_stats(const struct vk_minimal_allocator *a, struct vk_minimal_alloc_stats *stats)
+{
+	VkDeviceSize free_total = 0;
+	uint32_t i, j;
+
+	memset(stats, 0, sizeof(*stats));
+	for (i = 0; i < a->block_count; i++)
+	{
+		const struct vk_minimal_alloc_block *block = &a->blocks[i];
+		if (!block->memory)
+			continue;
+
+		stats->blocks++;
+		stats->allocations += block->allocations;
+		stats->reserved += block->size;
+		stats->used += block->used;
+		stats->free_ranges += block->free_count;
+		for (j = 0; j < block->free_count; j++)
+		{
+			free_total += block->free[j].size;
+			if (block->free[j].size > stats->largest_free)
+				stats->largest_free = block->free[j].size;
+		}
+	}
+
+	stats->fragmentation = free_total ? 1.0 - (double)stats->largest_free / free_total : 0.0;
+}
+
+VkResult vk_minimal_arena_init(struct vk_minimal_allocator *a, struct vk_minimal_arena *arena, uint32_t type, VkDeviceSize size)
+{
+	VkMemoryRequirements mr;
+	memset(&mr, 0, sizeof(mr));
+	mr.size = size;
+	mr.alignment = a->atom_size > 256 ? a->atom_size : 256;
+	mr.memoryTypeBits = 1 << type;
+
+	arena->head = 0;
+	return vk_minimal_alloc(a, type, &mr, VK_MINIMAL_ALLOC_LINEAR, &arena->alloc);
+}
+
+void vk_minimal_arena_destroy(struct vk_minimal_allocator *a, struct vk_minimal_arena *arena)
+{
+	vk_minimal_free(a, &arena->alloc);
+	arena->head = 0;
+}
+
+VkDeviceSize vk_minimal_arena_push(struct vk_minimal_arena *arena, VkDeviceSize size, VkDeviceSize alignment)
+{
+	// Aligned within the block, the arena itself is only aligned to 256
+	VkDeviceSize base = arena->alloc.offset;
+	VkDeviceSize offset = align_up(base + arena->head, alignment) - base;
+
+	if (offset + size > arena->alloc.size)
+		return VK_WHOLE_SIZE;
+
+	arena->head = offset + size;
+	return offset;
+}
+
+void vk_minimal_arena_reset(struct vk_minimal_arena *arena)
+{
+	arena->head = 0;
+}
@@ -0,0 +1,131 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#ifndef VK_MINIMAL_ALLOC_H
+#define VK_MINIMAL_ALLOC_H
+
+#include <stdint.h>
+#include "vulkan_dlfcn/vulkan_dlfcn.h"
+
+// Size of the blocks ranges are carved from, smaller for small heaps
+#define VK_MINIMAL_ALLOC_BLOCK_SIZE (64ull << 20)
+#define VK_MINIMAL_ALLOC_MAX_BLOCKS 64
+
+// Buffers and linear images must not share a bufferImageGranularity page
+// with optimal images. Optimal allocations are therefore padded out to whole
+// pages at both ends, which keeps every page to a single kind.
+enum vk_minimal_alloc_kind {
+	VK_MINIMAL_ALLOC_LINEAR = 0,
+	VK_MINIMAL_ALLOC_OPTIMAL
+};
+
+struct vk_minimal_alloc_range {
+	VkDeviceSize offset;
+	VkDeviceSize size;
+};
+
+// One vkAllocateMemory, mapped once if host visible. Free ranges are kept
+// sorted by offset so neighbours can be merged when a range is returned.
+struct vk_minimal_alloc_block {
+	VkDeviceMemory memory;
+	uint32_t type;
+	VkDeviceSize size;
+	void *data;
+	// Holds a single allocation that did not fit a regular block
+	int dedicated;
+
+	uint32_t allocations;
+	VkDeviceSize used;
+	struct vk_minimal_alloc_range *free;
+	uint32_t free_count;
+	uint32_t free_capacity;
+};
+
+struct vk_minimal_allocation {
+	VkDeviceMemory memory;
+	VkDeviceSize offset;
+	VkDeviceSize size;
+	// Mapped pointer to offset, NULL unless the memory type is host visible
+	void *data;
+	uint32_t type;
+	uint32_t block;
+};
+
+struct vk_minimal_allocator {
+	const struct vulkan_dlfcn_device *vkd;
+	VkDevice device;
+	VkPhysicalDeviceMemoryProperties props;
+	VkDeviceSize granularity;
+	VkDeviceSize atom_size;
+	struct vk_minimal_alloc_block blocks[VK_MINIMAL_ALLOC_MAX_BLOCKS];
+	uint32_t block_count;
+};
+
+struct vk_minimal_alloc_stats {
+	uint32_t blocks;
+	uint32_t allocations;
+	// Bytes held from the driver and handed out, padding included
+	VkDeviceSize reserved;
+	VkDeviceSize used;
+	uint32_t free_ranges;
+	VkDeviceSize largest_free;
+	// 0 when all free space is one range, approaching 1 as it splinters
+	double fragmentation;
+};
+
+// Bump allocator over a range of its own. Reset is O(1) so it suits data
+// that lives for one frame. Only for buffers, as it does not pad for
+// bufferImageGranularity.
+struct vk_minimal_arena {
+	struct vk_minimal_allocation alloc;
+	VkDeviceSize head;
+};
+
+void vk_minimal_alloc_init(struct vk_minimal_allocator *a, const struct vulkan_dlfcn_device *vkd, VkDevice device, const VkPhysicalDeviceMemoryProperties *props, const VkPhysicalDeviceLimits *limits);
+void vk_minimal_alloc_destroy(struct vk_minimal_allocator *a);
+
+// Returns VK_ERROR_OUT_OF_DEVICE_MEMORY or similar when the type has no room
+VkResult vk_minimal_alloc(struct vk_minimal_allocator *a, uint32_t type, const VkMemoryRequirements *mr,
+                          enum vk_minimal_alloc_kind kind, struct vk_minimal_allocation *out);
+void vk_minimal_free(struct vk_minimal_allocator *a, struct vk_minimal_allocation *alloc);
+
+// Flushes the range of a non coherent allocation, rounded to nonCoherentAtomSize
+VkResult vk_minimal_alloc_flush(struct vk_minimal_allocator *a, const struct vk_minimal_allocation *alloc, VkDeviceSize offset, VkDeviceSize size);
+// Same for device writes to be read by the host, safe from any thread
+VkResult vk_minimal_alloc_invalidate(struct vk_minimal_allocator *a, const struct vk_minimal_allocation *alloc, VkDeviceSize offset, VkDeviceSize size);
+
+void vk_minimal_alloc_get_stats(const struct vk_minimal_allocator *a, struct vk_minimal_alloc_stats *stats);
+
+VkResult vk_minimal_arena_init(struct vk_minimal_allocator *a, struct vk_minimal_arena *arena, uint32_t type, VkDeviceSize size);
+void vk_minimal_arena_destroy(struct vk_minimal_allocator *a, struct vk_minimal_arena *arena);
+// Returns the offset within the arena allocation, VK_WHOLE_SIZE when full.
+// The alignment applies to the offset within the memory, i.e. to
+// alloc.offset plus the returned offset.
+VkDeviceSize vk_minimal_arena_push(struct vk_minimal_arena *arena, VkDeviceSize size, VkDeviceSize alignment);
+void vk_minimal_arena_reset(struct vk_minimal_arena *arena);
+
+#endif
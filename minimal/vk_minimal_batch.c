@@ -0,0 +1,703 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#include "vk_minimal_batch.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define VK_MINIMAL_BATCH_X86 1
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#define VK_MINIMAL_BATCH_ARM 1
+#include <arm_neon.h>
+#endif
+
+// Span kernels on rows of 0xAARRGGBB pixels in cached memory
+struct kernels {
+	void (*span)(uint32_t *dst, uint32_t color, uint32_t count);
+	// Straight alpha over, the alpha of the result is a + dst_a * (1 - a)
+	void (*blend)(uint32_t *dst, const uint32_t *src, uint32_t count);
+	void (*blend_mask)(uint32_t *dst, uint32_t color, const uint8_t *mask, uint32_t count);
+};
+
+// Rounded x / 255 for x up to 255 * 255, the vector paths use the same
+static uint32_t div255(uint32_t x)
+{
+	x += 128;
+	return (x + (x >> 8)) >> 8;
+}
+
+// s * a + d * (1 - a) per channel, s with its alpha set to 255
+static uint32_t lerp(uint32_t d, uint32_t s, uint32_t a)
+{
+	uint32_t shift, out = 0;
+
+	for (shift = 0; shift < 32; shift += 8)
+		out |= div255(((s >> shift) & 0xff) * a + ((d >> shift) & 0xff) * (255 - a)) << shift;
+	return out;
+}
+
+static void span_scalar(uint32_t *dst, uint32_t color, uint32_t count)
+{
+	uint32_t i;
+
+	for (i = 0; i < count; i++)
+		dst[i] = color;
+}
+
+static void blend_scalar(uint32_t *dst, const uint32_t *src, uint32_t count)
+{
+	uint32_t i;
+
+	for (i = 0; i < count; i++)
+		dst[i] = lerp(dst[i], src[i] | 0xff000000, src[i] >> 24);
+}
+
+static void blend_mask_scalar(uint32_t *dst, uint32_t color, const uint8_t *mask, uint32_t count)
+{
+	uint32_t i;
+
+	for (i = 0; i < count; i++)
+		dst[i] = lerp(dst[i], color | 0xff000000, div255(mask[i] * (color >> 24)));
+}
+
+#if VK_MINIMAL_BATCH_X86
+
+// Two pixels widened to 16 bit lanes
+__attribute__((target("sse2")))
+static __m128i lerp_sse2(__m128i d, __m128i s, __m128i a)
+{
+	__m128i t = _mm_add_epi16(_mm_mullo_epi16(s, a), _mm_mullo_epi16(d, _mm_sub_epi16(_mm_set1_epi16(255), a)));
+	t = _mm_add_epi16(t, _mm_set1_epi16(128));
+	return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+
+__attribute__((target("sse2")))
+static void span_sse2(uint32_t *dst, uint32_t color, uint32_t count)
+{
+	const __m128i c = _mm_set1_epi32(color);
+	uint32_t i;
+
+	for (i = 0; i + 4 <= count; i += 4)
+		_mm_storeu_si128((__m128i *)(dst + i), c);
+	span_scalar(dst + i, color, count - i);
+}
+
+__attribute__((target("sse2")))
+static void blend_sse2(uint32_t *dst, const uint32_t *src, uint32_t count)
+{
+	const __m128i zero = _mm_setzero_si128(), opaque = _mm_set1_epi32(0xff000000);
+	uint32_t i;
+
+	for (i = 0; i + 4 <= count; i += 4)
+	{
+		__m128i s = _mm_loadu_si128((const __m128i *)(src + i));
+		__m128i alpha = _mm_srli_epi32(s, 24);
+
+		// Overlays are mostly fully transparent or opaque
+		if (_mm_movemask_epi8(_mm_cmpeq_epi32(alpha, zero)) == 0xffff)
+			continue;
+		if (_mm_movemask_epi8(_mm_cmpeq_epi32(alpha, _mm_set1_epi32(255))) == 0xffff)
+		{
+			_mm_storeu_si128((__m128i *)(dst + i), s);
+			continue;
+		}
+
+		// Alpha of each pixel in all four of its lanes
+		__m128i a_lo = _mm_unpacklo_epi8(s, zero), a_hi = _mm_unpackhi_epi8(s, zero);
+		a_lo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(a_lo, 0xff), 0xff);
+		a_hi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(a_hi, 0xff), 0xff);
+
+		__m128i d = _mm_loadu_si128((const __m128i *)(dst + i));
+		s = _mm_or_si128(s, opaque);
+		__m128i lo = lerp_sse2(_mm_unpacklo_epi8(d, zero), _mm_unpacklo_epi8(s, zero), a_lo);
+		__m128i hi = lerp_sse2(_mm_unpackhi_epi8(d, zero), _mm_unpackhi_epi8(s, zero), a_hi);
+		_mm_storeu_si128((__m128i *)(dst + i), _mm_packus_epi16(lo, hi));
+	}
+	blend_scalar(dst + i, src + i, count - i);
+}
+
+__attribute__((target("sse2")))
+static void blend_mask_sse2(uint32_t *dst, uint32_t color, const uint8_t *mask, uint32_t count)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i c = _mm_unpacklo_epi8(_mm_set1_epi32(color | 0xff000000), zero);
+	const __m128i ca = _mm_set1_epi16(color >> 24);
+	uint32_t i;
+
+	for (i = 0; i + 4 <= count; i += 4)
+	{
+		uint32_t m4;
+		memcpy(&m4, mask + i, sizeof(m4));
+		if (m4 == 0)
+			continue;
+
+		// Coverage times alpha, then spread over the lanes of each pixel
+		__m128i a = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(m4), zero), ca), _mm_set1_epi16(128));
+		a = _mm_srli_epi16(_mm_add_epi16(a, _mm_srli_epi16(a, 8)), 8);
+		a = _mm_unpacklo_epi16(a, a);
+
+		__m128i d = _mm_loadu_si128((const __m128i *)(dst + i));
+		__m128i lo = lerp_sse2(_mm_unpacklo_epi8(d, zero), c, _mm_unpacklo_epi32(a, a));
+		__m128i hi = lerp_sse2(_mm_unpackhi_epi8(d, zero), c, _mm_unpackhi_epi32(a, a));
+		_mm_storeu_si128((__m128i *)(dst + i), _mm_packus_epi16(lo, hi));
+	}
+	blend_mask_scalar(dst + i, color, mask + i, count - i);
+}
+
+#endif
+
+#if VK_MINIMAL_BATCH_ARM
+
+// Eight pixels split into channels by vld4
+static uint8x8_t lerp_neon(uint8x8_t d, uint8x8_t s, uint8x8_t a)
+{
+	uint16x8_t t = vmlal_u8(vmull_u8(s, a), d, vmvn_u8(a));
+	return vrshrn_n_u16(vrsraq_n_u16(t, t, 8), 8);
+}
+
+static void span_neon(uint32_t *dst, uint32_t color, uint32_t count)
+{
+	const uint32x4_t c = vdupq_n_u32(color);
+	uint32_t i;
+
+	for (i = 0; i + 4 <= count; i += 4)
+		vst1q_u32(dst + i, c);
+	span_scalar(dst + i, color, count - i);
+}
+
+static void blend_neon(uint32_t *dst, const uint32_t *src, uint32_t count)
+{
+	uint32_t i, c;
+
+	for (i = 0; i + 8 <= count; i += 8)
+	{
+		uint8x8x4_t s = vld4_u8((const uint8_t *)(src + i));
+		uint8x8x4_t d = vld4_u8((const uint8_t *)(dst + i));
+		uint8x8_t a = s.val[3];
+
+		s.val[3] = vdup_n_u8(255);
+		for (c = 0; c < 4; c++)
+			d.val[c] = lerp_neon(d.val[c], s.val[c], a);
+		vst4_u8((uint8_t *)(dst + i), d);
+	}
+	blend_scalar(dst + i, src + i, count - i);
+}
+
+static void blend_mask_neon(uint32_t *dst, uint32_t color, const uint8_t *mask, uint32_t count)
+{
+	const uint8x8_t ca = vdup_n_u8(color >> 24);
+	uint8x8_t s[4];
+	uint32_t i, c;
+
+	s[0] = vdup_n_u8(color);
+	s[1] = vdup_n_u8(color >> 8);
+	s[2] = vdup_n_u8(color >> 16);
+	s[3] = vdup_n_u8(255);
+
+	for (i = 0; i + 8 <= count; i += 8)
+	{
+		uint16x8_t t = vmull_u8(vld1_u8(mask + i), ca);
+		uint8x8_t a = vrshrn_n_u16(vrsraq_n_u16(t, t, 8), 8);
+		uint8x8x4_t d = vld4_u8((const uint8_t *)(dst + i));
+
+		for (c = 0; c < 4; c++)
+			d.val[c] = lerp_neon(d.val[c], s[c], a);
+		vst4_u8((uint8_t *)(dst + i), d);
+	}
+	blend_mask_scalar(dst + i, color, mask + i, count - i);
+}
+
+#endif
+
+static void select_kernels(enum vk_minimal_fill_path path, struct kernels *k)
+{
+	switch (path)
+	{
+#if VK_MINIMAL_BATCH_X86
+		// Rows are short and cached, AVX2 gains nothing over SSE2 here
+		case VK_MINIMAL_FILL_SSE2:
+		case VK_MINIMAL_FILL_AVX2:
+		k->span = span_sse2;
+		k->blend = blend_sse2;
+		k->blend_mask = blend_mask_sse2;
+		break;
+#endif
+#if VK_MINIMAL_BATCH_ARM
+		case VK_MINIMAL_FILL_NEON:
+		k->span = span_neon;
+		k->blend = blend_neon;
+		k->blend_mask = blend_mask_neon;
+		break;
+#endif
+		default:
+		k->span = span_scalar;
+		k->blend = blend_scalar;
+		k->blend_mask = blend_mask_scalar;
+		break;
+	}
+}
+
+void vk_minimal_batch_init(struct vk_minimal_batch *batch, uint32_t width, uint32_t height)
+{
+	memset(batch, 0, sizeof(*batch));
+	batch->width = width;
+	batch->height = height;
+	batch->bands = (height + VK_MINIMAL_FILL_BAND_ROWS - 1) / VK_MINIMAL_FILL_BAND_ROWS;
+	// Two extra so the bucket sort can count and place in the same array
+	batch->band_offsets = calloc(batch->bands + 2, sizeof(batch->band_offsets[0]));
+	assert(batch->band_offsets);
+	batch->rows = calloc(height + 1, sizeof(batch->rows[0]));
+	assert(batch->rows);
+	// At most every other row starts a run
+	batch->runs = calloc(height + 2, sizeof(batch->runs[0]));
+	assert(batch->runs);
+	vk_minimal_damage_clear(&batch->damage);
+	vk_minimal_damage_clear(&batch->drawn);
+}
+
+void vk_minimal_batch_destroy(struct vk_minimal_batch *batch)
+{
+	free(batch->cmds);
+	free(batch->band_offsets);
+	free(batch->band_cmds);
+	free(batch->rows);
+	free(batch->runs);
+	free(batch->rest);
+	memset(batch, 0, sizeof(*batch));
+}
+
+static const struct vk_minimal_rect empty_rect = {0, 0, 0, 0};
+
+// Clips [x0, x1) x [y0, y1) to the batch, returns 0 when nothing is left
+static int clip(const struct vk_minimal_batch *batch, int64_t x0, int64_t y0, int64_t x1, int64_t y1, struct vk_minimal_rect *rect)
+{
+	if (x0 < 0)
+		x0 = 0;
+	if (y0 < 0)
+		y0 = 0;
+	if (x1 > batch->width)
+		x1 = batch->width;
+	if (y1 > batch->height)
+		y1 = batch->height;
+	if (x0 >= x1 || y0 >= y1)
+		return 0;
+
+	rect->x0 = x0;
+	rect->y0 = y0;
+	rect->x1 = x1;
+	rect->y1 = y1;
+	return 1;
+}
+
+static struct vk_minimal_rect push(struct vk_minimal_batch *batch, const struct vk_minimal_batch_cmd *cmd)
+{
+	if (batch->count == batch->capacity)
+	{
+		batch->capacity = batch->capacity ? 2 * batch->capacity : 64;
+		batch->cmds = realloc(batch->cmds, batch->capacity * sizeof(batch->cmds[0]));
+		assert(batch->cmds);
+	}
+	batch->cmds[batch->count++] = *cmd;
+	vk_minimal_damage_add(&batch->damage, cmd->rect);
+
+	return cmd->rect;
+}
+
+struct vk_minimal_rect vk_minimal_batch_clear(struct vk_minimal_batch *batch, uint32_t color)
+{
+	return vk_minimal_batch_fill_rect(batch, 0, 0, batch->width, batch->height, color);
+}
+
+struct vk_minimal_rect vk_minimal_batch_fill_rect(struct vk_minimal_batch *batch, int32_t x, int32_t y, uint32_t width, uint32_t height,
+                                                  uint32_t color)
+{
+	struct vk_minimal_batch_cmd cmd;
+	memset(&cmd, 0, sizeof(cmd));
+	cmd.op = VK_MINIMAL_BATCH_FILL;
+	cmd.color = color;
+	if (!clip(batch, x, y, (int64_t)x + width, (int64_t)y + height, &cmd.rect))
+		return empty_rect;
+
+	return push(batch, &cmd);
+}
+
+struct vk_minimal_rect vk_minimal_batch_hline(struct vk_minimal_batch *batch, int32_t x, int32_t y, uint32_t width, uint32_t color)
+{
+	return vk_minimal_batch_fill_rect(batch, x, y, width, 1, color);
+}
+
+struct vk_minimal_rect vk_minimal_batch_vline(struct vk_minimal_batch *batch, int32_t x, int32_t y, uint32_t height, uint32_t color)
+{
+	return vk_minimal_batch_fill_rect(batch, x, y, 1, height, color);
+}
+
+struct vk_minimal_rect vk_minimal_batch_line(struct vk_minimal_batch *batch, int32_t x0, int32_t y0, int32_t x1, int32_t y1, uint32_t color)
+{
+	struct vk_minimal_batch_cmd cmd;
+	memset(&cmd, 0, sizeof(cmd));
+	cmd.op = VK_MINIMAL_BATCH_LINE;
+	cmd.color = color;
+	// Rows are drawn top to bottom
+	if (y0 <= y1)
+	{
+		cmd.x0 = x0;
+		cmd.y0 = y0;
+		cmd.x1 = x1;
+		cmd.y1 = y1;
+	}
+	else
+	{
+		cmd.x0 = x1;
+		cmd.y0 = y1;
+		cmd.x1 = x0;
+		cmd.y1 = y0;
+	}
+	if (!clip(batch, cmd.x0 < cmd.x1 ? cmd.x0 : cmd.x1, cmd.y0, (int64_t)(cmd.x0 > cmd.x1 ? cmd.x0 : cmd.x1) + 1, (int64_t)cmd.y1 + 1, &cmd.rect))
+		return empty_rect;
+
+	return push(batch, &cmd);
+}
+
+struct vk_minimal_rect vk_minimal_batch_blend(struct vk_minimal_batch *batch, int32_t x, int32_t y, const uint32_t *pixels, uint32_t pitch,
+                                              uint32_t width, uint32_t height)
+{
+	struct vk_minimal_batch_cmd cmd;
+	memset(&cmd, 0, sizeof(cmd));
+	cmd.op = VK_MINIMAL_BATCH_BLEND;
+	cmd.x0 = x;
+	cmd.y0 = y;
+	cmd.src = pixels;
+	cmd.src_pitch = pitch;
+	if (!clip(batch, x, y, (int64_t)x + width, (int64_t)y + height, &cmd.rect))
+		return empty_rect;
+
+	return push(batch, &cmd);
+}
+
+struct vk_minimal_rect vk_minimal_batch_glyph(struct vk_minimal_batch *batch, int32_t x, int32_t y, const struct vk_minimal_atlas *atlas,
+                                              uint32_t glyph, uint32_t color)
+{
+	assert(glyph < atlas->count);
+	const struct vk_minimal_rect *g = &atlas->glyphs[glyph];
+
+	struct vk_minimal_batch_cmd cmd;
+	memset(&cmd, 0, sizeof(cmd));
+	cmd.op = VK_MINIMAL_BATCH_GLYPH;
+	cmd.color = color;
+	cmd.x0 = x;
+	cmd.y0 = y;
+	cmd.src = atlas->coverage + g->y0 * atlas->pitch + g->x0;
+	cmd.src_pitch = atlas->pitch;
+	if (!clip(batch, x, y, (int64_t)x + (g->x1 - g->x0), (int64_t)y + (g->y1 - g->y0), &cmd.rect))
+		return empty_rect;
+
+	return push(batch, &cmd);
+}
+
+// Pixels [*x0, *x1) of the line on row y. Row k of the line holds the steps
+// t along the major axis for which round(t * minor / major) is k, solved for
+// t directly so that any row can be drawn without stepping to it.
+static int line_span(const struct vk_minimal_batch_cmd *cmd, uint32_t y, uint32_t *x0, uint32_t *x1)
+{
+	const int64_t dx = (int64_t)cmd->x1 - cmd->x0;
+	const int64_t adx = dx < 0 ? -dx : dx;
+	const int64_t dy = (int64_t)cmd->y1 - cmd->y0;
+	const int64_t k = (int64_t)y - cmd->y0;
+	int64_t tmin, tmax, l0, l1;
+
+	if (dy == 0)
+	{
+		tmin = 0;
+		tmax = adx;
+	}
+	else if (adx <= dy)
+	{
+		tmin = tmax = (2 * k * adx + dy) / (2 * dy);
+	}
+	else
+	{
+		tmin = k == 0 ? 0 : ((2 * k - 1) * adx + 2 * dy - 1) / (2 * dy);
+		tmax = k == dy ? adx : ((2 * k + 1) * adx + 2 * dy - 1) / (2 * dy) - 1;
+	}
+
+	if (dx >= 0)
+	{
+		l0 = cmd->x0 + tmin;
+		l1 = cmd->x0 + tmax + 1;
+	}
+	else
+	{
+		l0 = cmd->x0 - tmax;
+		l1 = cmd->x0 - tmin + 1;
+	}
+
+	if (l0 < cmd->rect.x0)
+		l0 = cmd->rect.x0;
+	if (l1 > cmd->rect.x1)
+		l1 = cmd->rect.x1;
+	*x0 = l0;
+	*x1 = l1;
+	return l0 < l1;
+}
+
+struct band_job {
+	const struct vk_minimal_batch *batch;
+	const struct vk_minimal_fill *fill;
+	struct kernels kernels;
+	const struct vk_minimal_damage *damage;
+	void *data;
+	size_t row_pitch;
+};
+
+static void draw_span(const struct kernels *k, const struct vk_minimal_batch_cmd *cmd, uint32_t y, uint32_t *row)
+{
+	const uint32_t width = cmd->rect.x1 - cmd->rect.x0;
+	const int64_t sx = (int64_t)cmd->rect.x0 - cmd->x0, sy = (int64_t)y - cmd->y0;
+	uint32_t x0, x1;
+
+	switch (cmd->op)
+	{
+		case VK_MINIMAL_BATCH_FILL:
+		k->span(row + cmd->rect.x0, cmd->color, width);
+		break;
+
+		case VK_MINIMAL_BATCH_LINE:
+		if (line_span(cmd, y, &x0, &x1))
+			k->span(row + x0, cmd->color, x1 - x0);
+		break;
+
+		case VK_MINIMAL_BATCH_BLEND:
+		k->blend(row + cmd->rect.x0, (const uint32_t *)((const uint8_t *)cmd->src + sy * cmd->src_pitch) + sx, width);
+		break;
+
+		case VK_MINIMAL_BATCH_GLYPH:
+		k->blend_mask(row + cmd->rect.x0, cmd->color, (const uint8_t *)cmd->src + sy * cmd->src_pitch + sx, width);
+		break;
+
+		default:
+		assert(0 && "unknown batch op");
+	}
+}
+
+static void draw_band(void *arg, uint32_t band)
+{
+	const struct band_job *job = arg;
+	const struct vk_minimal_batch *batch = job->batch;
+	const uint32_t *cmds = batch->band_cmds + batch->band_offsets[band];
+	const uint32_t count = batch->band_offsets[band + 1] - batch->band_offsets[band];
+	const uint32_t y0 = band * VK_MINIMAL_FILL_BAND_ROWS;
+	const uint32_t y1 = y0 + VK_MINIMAL_FILL_BAND_ROWS < batch->height ? y0 + VK_MINIMAL_FILL_BAND_ROWS : batch->height;
+	const uint32_t bpp = job->fill->bpp;
+	struct vk_minimal_rect grid[VK_MINIMAL_MAX_DAMAGE_RECTS];
+	uint32_t row[batch->width];
+	uint32_t i, y, grid_count = 0;
+
+	if (count == 0)
+		return;
+
+	for (i = 0; i < job->damage->count; i++)
+	{
+		if (job->damage->rects[i].y0 < y1 && job->damage->rects[i].y1 > y0)
+			grid[grid_count++] = job->damage->rects[i];
+	}
+
+	for (y = y0; y < y1; y++)
+	{
+		uint32_t x0 = batch->width, x1 = 0;
+
+		for (i = 0; i < count; i++)
+		{
+			const struct vk_minimal_rect *r = &batch->cmds[cmds[i]].rect;
+			if (y >= r->y0 && y < r->y1)
+			{
+				if (r->x0 < x0)
+					x0 = r->x0;
+				if (r->x1 > x1)
+					x1 = r->x1;
+			}
+		}
+		if (x0 >= x1)
+			continue;
+		// The fill leaves the damaged grid on this row to it
+		for (i = 0; i < grid_count; i++)
+		{
+			if (y >= grid[i].y0 && y < grid[i].y1)
+			{
+				if (grid[i].x0 < x0)
+					x0 = grid[i].x0;
+				if (grid[i].x1 > x1)
+					x1 = grid[i].x1;
+			}
+		}
+
+		// The grid is what the fill has just put there, composed from its
+		// rows rather than read back from the canvas
+		vk_minimal_fill_unpack(job->fill, row + x0, (const uint8_t *)vk_minimal_fill_grid_row(job->fill, y) + x0 * bpp, x1 - x0);
+		for (i = 0; i < count; i++)
+		{
+			const struct vk_minimal_batch_cmd *cmd = &batch->cmds[cmds[i]];
+			if (y >= cmd->rect.y0 && y < cmd->rect.y1)
+				draw_span(&job->kernels, cmd, y, row);
+		}
+		vk_minimal_fill_store(job->fill, (uint8_t *)job->data + y * job->row_pitch + x0 * bpp, row + x0, x1 - x0);
+	}
+	vk_minimal_fill_fence(job->fill);
+}
+
+// Bucket sort by band, counted into band_offsets[b + 2] and placed through
+// band_offsets[b + 1] so that band_offsets[b] ends up where band b starts
+static void sort_bands(struct vk_minimal_batch *batch)
+{
+	uint32_t i, b, total = 0;
+
+	memset(batch->band_offsets, 0, (batch->bands + 2) * sizeof(batch->band_offsets[0]));
+	for (i = 0; i < batch->count; i++)
+	{
+		const struct vk_minimal_rect *r = &batch->cmds[i].rect;
+		for (b = r->y0 / VK_MINIMAL_FILL_BAND_ROWS; b <= (r->y1 - 1) / VK_MINIMAL_FILL_BAND_ROWS; b++)
+			batch->band_offsets[b + 2]++;
+	}
+	for (b = 0; b < batch->bands; b++)
+	{
+		total += batch->band_offsets[b + 2];
+		batch->band_offsets[b + 2] = total;
+	}
+
+	if (total > batch->band_capacity)
+	{
+		batch->band_capacity = total;
+		batch->band_cmds = realloc(batch->band_cmds, total * sizeof(batch->band_cmds[0]));
+		assert(batch->band_cmds);
+	}
+
+	for (i = 0; i < batch->count; i++)
+	{
+		const struct vk_minimal_rect *r = &batch->cmds[i].rect;
+		for (b = r->y0 / VK_MINIMAL_FILL_BAND_ROWS; b <= (r->y1 - 1) / VK_MINIMAL_FILL_BAND_ROWS; b++)
+			batch->band_cmds[batch->band_offsets[b + 1]++] = i;
+	}
+}
+
+// Clips the damage to the runs of rows no queued command touches, draw_band()
+// writes the grid on all the others
+static uint32_t split_damage(struct vk_minimal_batch *batch, const struct vk_minimal_damage *damage)
+{
+	uint32_t i, j, y, start = 0, runs = 0, count = 0;
+	int32_t touched = 0;
+
+	memset(batch->rows, 0, (batch->height + 1) * sizeof(batch->rows[0]));
+	for (i = 0; i < batch->count; i++)
+	{
+		batch->rows[batch->cmds[i].rect.y0]++;
+		batch->rows[batch->cmds[i].rect.y1]--;
+	}
+	for (y = 0; y < batch->height; y++)
+	{
+		touched += batch->rows[y];
+		if (touched == 0)
+			continue;
+		if (start < y)
+		{
+			batch->runs[runs++] = start;
+			batch->runs[runs++] = y;
+		}
+		start = y + 1;
+	}
+	if (start < batch->height)
+	{
+		batch->runs[runs++] = start;
+		batch->runs[runs++] = batch->height;
+	}
+
+	for (i = 0; i < damage->count; i++)
+	{
+		const struct vk_minimal_rect *r = &damage->rects[i];
+		for (j = 0; j < runs; j += 2)
+		{
+			uint32_t ry0 = batch->runs[j] > r->y0 ? batch->runs[j] : r->y0;
+			uint32_t ry1 = batch->runs[j + 1] < r->y1 ? batch->runs[j + 1] : r->y1;
+			if (ry0 >= ry1)
+				continue;
+
+			if (count == batch->rest_capacity)
+			{
+				batch->rest_capacity = batch->rest_capacity ? 2 * batch->rest_capacity : 64;
+				batch->rest = realloc(batch->rest, batch->rest_capacity * sizeof(batch->rest[0]));
+				assert(batch->rest);
+			}
+			batch->rest[count].x0 = r->x0;
+			batch->rest[count].y0 = ry0;
+			batch->rest[count].x1 = r->x1;
+			batch->rest[count].y1 = ry1;
+			count++;
+		}
+	}
+	return count;
+}
+
+void vk_minimal_batch_draw(struct vk_minimal_batch *batch, const struct vk_minimal_fill *fill, struct vk_minimal_pool *pool,
+                           const struct vk_minimal_damage *damage, void *data, size_t row_pitch)
+{
+	uint32_t b;
+
+	assert(fill->width == batch->width);
+	if (batch->count == 0)
+	{
+		vk_minimal_fill_grid(fill, pool, data, row_pitch, damage->rects, damage->count);
+	}
+	else
+	{
+		vk_minimal_fill_grid(fill, pool, data, row_pitch, batch->rest, split_damage(batch, damage));
+		sort_bands(batch);
+
+		struct band_job job;
+		memset(&job, 0, sizeof(job));
+		job.batch = batch;
+		job.fill = fill;
+		select_kernels(fill->path, &job.kernels);
+		job.damage = damage;
+		job.data = data;
+		job.row_pitch = row_pitch;
+
+		if (!pool || pool->threads <= 1)
+		{
+			for (b = 0; b < batch->bands; b++)
+				draw_band(&job, b);
+		}
+		else
+		{
+			vk_minimal_pool_run(pool, batch->bands, draw_band, &job);
+		}
+	}
+
+	batch->drawn = batch->damage;
+	vk_minimal_damage_clear(&batch->damage);
+	batch->count = 0;
+}
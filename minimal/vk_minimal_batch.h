@@ -0,0 +1,128 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#ifndef VK_MINIMAL_BATCH_H
+#define VK_MINIMAL_BATCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "vk_minimal_damage.h"
+#include "vk_minimal_fill.h"
+#include "vk_minimal_pool.h"
+
+// Glyphs are 8 bit coverage masks packed into one atlas
+struct vk_minimal_atlas {
+	const uint8_t *coverage;
+	uint32_t pitch;
+	// Where each glyph lies in the atlas
+	const struct vk_minimal_rect *glyphs;
+	uint32_t count;
+};
+
+enum vk_minimal_batch_op {
+	VK_MINIMAL_BATCH_FILL = 0,
+	VK_MINIMAL_BATCH_LINE,
+	VK_MINIMAL_BATCH_BLEND,
+	VK_MINIMAL_BATCH_GLYPH
+};
+
+struct vk_minimal_batch_cmd {
+	enum vk_minimal_batch_op op;
+	// 0xAARRGGBB, the alpha of a fill is stored as is
+	uint32_t color;
+	// Clipped area the command touches
+	struct vk_minimal_rect rect;
+	// Line end points ordered top to bottom, or where the source lands
+	int32_t x0, y0, x1, y1;
+	// Source pixels or coverage at (x0, y0), pitch in bytes
+	const void *src;
+	uint32_t src_pitch;
+};
+
+// Commands queued for one frame. Drawing buckets them by the band of rows
+// they touch and goes band by band, row by row. Each row is composed over the
+// grid in a cached buffer and streamed into the canvas once, so the write
+// combined canvas is never read back and overlapping commands don't write it
+// twice. Within a band the commands keep the order they were queued in.
+struct vk_minimal_batch {
+	uint32_t width;
+	uint32_t height;
+
+	struct vk_minimal_batch_cmd *cmds;
+	uint32_t count;
+	uint32_t capacity;
+
+	// Command indices of band b are band_cmds[band_offsets[b]] up to
+	// band_cmds[band_offsets[b + 1]]
+	uint32_t bands;
+	uint32_t *band_offsets;
+	uint32_t *band_cmds;
+	uint32_t band_capacity;
+
+	// Area touched by the queued commands, and by the ones last drawn that
+	// the grid has to be restored under unless they are queued again
+	struct vk_minimal_damage damage;
+	struct vk_minimal_damage drawn;
+
+	// Commands starting minus commands ending on each row, the runs of rows
+	// no command touches as [runs[2k], runs[2k + 1]), and the grid damage on
+	// them that is left to vk_minimal_fill_grid()
+	int32_t *rows;
+	uint32_t *runs;
+	struct vk_minimal_rect *rest;
+	uint32_t rest_capacity;
+};
+
+void vk_minimal_batch_init(struct vk_minimal_batch *batch, uint32_t width, uint32_t height);
+void vk_minimal_batch_destroy(struct vk_minimal_batch *batch);
+
+// Each returns the area it dirties clipped to the batch, empty when nothing
+// is left and then nothing is queued. Sources and atlases are only read when
+// the batch is drawn.
+struct vk_minimal_rect vk_minimal_batch_clear(struct vk_minimal_batch *batch, uint32_t color);
+struct vk_minimal_rect vk_minimal_batch_fill_rect(struct vk_minimal_batch *batch, int32_t x, int32_t y, uint32_t width, uint32_t height,
+                                                  uint32_t color);
+struct vk_minimal_rect vk_minimal_batch_hline(struct vk_minimal_batch *batch, int32_t x, int32_t y, uint32_t width, uint32_t color);
+struct vk_minimal_rect vk_minimal_batch_vline(struct vk_minimal_batch *batch, int32_t x, int32_t y, uint32_t height, uint32_t color);
+// Bresenham, both end points included
+struct vk_minimal_rect vk_minimal_batch_line(struct vk_minimal_batch *batch, int32_t x0, int32_t y0, int32_t x1, int32_t y1, uint32_t color);
+// Blends 0xAARRGGBB pixels with straight alpha over the canvas
+struct vk_minimal_rect vk_minimal_batch_blend(struct vk_minimal_batch *batch, int32_t x, int32_t y, const uint32_t *pixels, uint32_t pitch,
+                                              uint32_t width, uint32_t height);
+// Blends color over the canvas with the glyph's coverage times its alpha
+struct vk_minimal_rect vk_minimal_batch_glyph(struct vk_minimal_batch *batch, int32_t x, int32_t y, const struct vk_minimal_atlas *atlas,
+                                              uint32_t glyph, uint32_t color);
+
+// Restores the grid of fill where damaged and draws the queued commands over
+// it into a canvas in its layout, then moves them on to drawn and empties the
+// batch. Rows the commands touch are composed together with the damaged grid
+// on them, only the damage on the other rows goes to vk_minimal_fill_grid(),
+// so no pixel is written twice. pool may be NULL.
+void vk_minimal_batch_draw(struct vk_minimal_batch *batch, const struct vk_minimal_fill *fill, struct vk_minimal_pool *pool,
+                           const struct vk_minimal_damage *damage, void *data, size_t row_pitch);
+
+#endif
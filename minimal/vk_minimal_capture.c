@@ -0,0 +1,344 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#include "vk_minimal_capture.h"
+#include <assert.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Rows converted per fwrite() for PPM
+#define CAPTURE_PPM_ROWS 64
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// Byte offsets of red and blue in a pixel, green is always at 1. Returns 0
+// for formats PPM can't take.
+static int rgb_offsets(VkFormat format, uint32_t *r, uint32_t *b)
+{
+	switch (format)
+	{
+		case VK_FORMAT_B8G8R8A8_UNORM:
+		case VK_FORMAT_B8G8R8A8_SRGB:
+		*r = 2;
+		*b = 0;
+		return 1;
+
+		case VK_FORMAT_R8G8B8A8_UNORM:
+		case VK_FORMAT_R8G8B8A8_SRGB:
+		case VK_FORMAT_A8B8G8R8_UNORM_PACK32:
+		case VK_FORMAT_A8B8G8R8_SRGB_PACK32:
+		*r = 0;
+		*b = 2;
+		return 1;
+
+		default:
+		return 0;
+	}
+}
+
+uint32_t vk_minimal_capture_format_bpp(VkFormat format)
+{
+	switch (format)
+	{
+		case VK_FORMAT_R4G4B4A4_UNORM_PACK16:
+		case VK_FORMAT_B4G4R4A4_UNORM_PACK16:
+		case VK_FORMAT_R5G6B5_UNORM_PACK16:
+		case VK_FORMAT_B5G6R5_UNORM_PACK16:
+		case VK_FORMAT_R5G5B5A1_UNORM_PACK16:
+		case VK_FORMAT_B5G5R5A1_UNORM_PACK16:
+		case VK_FORMAT_A1R5G5B5_UNORM_PACK16:
+		return 2;
+
+		case VK_FORMAT_R8G8B8A8_UNORM:
+		case VK_FORMAT_R8G8B8A8_SRGB:
+		case VK_FORMAT_B8G8R8A8_UNORM:
+		case VK_FORMAT_B8G8R8A8_SRGB:
+		case VK_FORMAT_A8B8G8R8_UNORM_PACK32:
+		case VK_FORMAT_A8B8G8R8_SRGB_PACK32:
+		case VK_FORMAT_A2R10G10B10_UNORM_PACK32:
+		case VK_FORMAT_A2B10G10R10_UNORM_PACK32:
+		case VK_FORMAT_B10G11R11_UFLOAT_PACK32:
+		return 4;
+
+		case VK_FORMAT_R16G16B16A16_UNORM:
+		case VK_FORMAT_R16G16B16A16_SFLOAT:
+		return 8;
+
+		default:
+		return 0;
+	}
+}
+
+static void write_bytes(struct vk_minimal_capture *cap, const void *data, size_t size)
+{
+	size_t written = fwrite(data, 1, size, cap->file);
+	assert(written == size);
+	cap->offset += size;
+}
+
+static void write_ppm(struct vk_minimal_capture *cap, const struct vk_minimal_capture_job *job)
+{
+	char header[64];
+	uint32_t r = 0, b = 0;
+	uint32_t y, x, rows;
+
+	int ok = rgb_offsets(job->format, &r, &b);
+	assert(ok);
+
+	int len = snprintf(header, sizeof(header), "P6\n%u %u\n255\n", job->width, job->height);
+	write_bytes(cap, header, len);
+
+	size_t size = (size_t)job->width * 3 * CAPTURE_PPM_ROWS;
+	if (cap->rows_size < size)
+	{
+		free(cap->rows);
+		cap->rows = malloc(size);
+		assert(cap->rows);
+		cap->rows_size = size;
+	}
+
+	for (y = 0; y < job->height; y += rows)
+	{
+		rows = job->height - y < CAPTURE_PPM_ROWS ? job->height - y : CAPTURE_PPM_ROWS;
+		const uint8_t *src = job->data + (size_t)y * job->width * 4;
+		uint8_t *dst = cap->rows;
+
+		for (x = 0; x < job->width * rows; x++)
+		{
+			dst[0] = src[r];
+			dst[1] = src[1];
+			dst[2] = src[b];
+			src += 4;
+			dst += 3;
+		}
+		write_bytes(cap, cap->rows, (size_t)job->width * 3 * rows);
+	}
+}
+
+static void write_frame(struct vk_minimal_capture *cap, const struct vk_minimal_capture_job *job)
+{
+	uint32_t size = job->width * job->height * vk_minimal_capture_format_bpp(job->format);
+	uint64_t t0 = now_ns();
+	uint64_t start = cap->offset;
+
+	if (job->mem)
+	{
+		VkResult err = vk_minimal_alloc_invalidate(cap->allocator, job->mem, 0, size);
+		assert(err == VK_SUCCESS);
+	}
+
+	switch (cap->container)
+	{
+		case VK_MINIMAL_CAPTURE_PPM:
+		write_ppm(cap, job);
+		break;
+
+		case VK_MINIMAL_CAPTURE_RAW:
+		write_bytes(cap, job->data, size);
+		break;
+
+		case VK_MINIMAL_CAPTURE_INDEXED:
+		{
+			struct vk_minimal_capture_record rec;
+			memset(&rec, 0, sizeof(rec));
+			rec.offset = cap->offset + sizeof(rec);
+			rec.frame = job->frame;
+			rec.ns = job->ns;
+			rec.width = job->width;
+			rec.height = job->height;
+			rec.format = job->format;
+			rec.size = size;
+
+			if (cap->index_count == cap->index_capacity)
+			{
+				cap->index_capacity = cap->index_capacity ? cap->index_capacity * 2 : 256;
+				cap->index = realloc(cap->index, sizeof(cap->index[0])*cap->index_capacity);
+				assert(cap->index);
+			}
+			cap->index[cap->index_count++] = rec;
+
+			write_bytes(cap, &rec, sizeof(rec));
+			write_bytes(cap, job->data, size);
+			break;
+		}
+
+		default:
+		assert(0 && "unknown capture container");
+	}
+
+	uint64_t ns = now_ns() - t0;
+	atomic_fetch_add_explicit(&cap->stats.frames, 1, memory_order_relaxed);
+	atomic_fetch_add_explicit(&cap->stats.bytes, cap->offset - start, memory_order_relaxed);
+	atomic_fetch_add_explicit(&cap->stats.write_ns, ns, memory_order_relaxed);
+	if (ns > atomic_load_explicit(&cap->stats.write_max_ns, memory_order_relaxed))
+		atomic_store_explicit(&cap->stats.write_max_ns, ns, memory_order_relaxed);
+}
+
+// The render thread owns tail and the writer head, as in vk_minimal_render
+static int queue_pop(struct vk_minimal_capture *cap, struct vk_minimal_capture_job *job)
+{
+	unsigned head = atomic_load_explicit(&cap->head, memory_order_relaxed);
+
+	if (atomic_load_explicit(&cap->tail, memory_order_acquire) == head)
+		return 0;
+	*job = cap->jobs[head % VK_MINIMAL_CAPTURE_MAX_BUFFERS];
+	atomic_store_explicit(&cap->head, head + 1, memory_order_release);
+	return 1;
+}
+
+static void *capture_main(void *p)
+{
+	struct vk_minimal_capture *cap = p;
+	struct vk_minimal_capture_job job;
+
+	for (;;)
+	{
+		sem_wait(&cap->queued);
+		// Every job comes with a post, so an empty queue is the one to stop
+		if (!queue_pop(cap, &job))
+			break;
+		write_frame(cap, &job);
+		atomic_store_explicit(&cap->busy[job.buffer], 0, memory_order_release);
+		sem_post(&cap->done);
+	}
+
+	return NULL;
+}
+
+void vk_minimal_capture_init(struct vk_minimal_capture *cap, enum vk_minimal_capture_container container, const char *path,
+                             struct vk_minimal_allocator *allocator)
+{
+	int res;
+
+	assert(container > VK_MINIMAL_CAPTURE_OFF && container < VK_MINIMAL_CAPTURE_CONTAINER_COUNT);
+	memset(cap, 0, sizeof(*cap));
+	cap->container = container;
+	cap->allocator = allocator;
+	cap->file = fopen(path, "wb");
+	assert(cap->file && "can't create the capture file");
+
+	sem_init(&cap->queued, 0, 0);
+	sem_init(&cap->done, 0, 0);
+
+	if (container == VK_MINIMAL_CAPTURE_INDEXED)
+	{
+		struct vk_minimal_capture_file_header header;
+		memset(&header, 0, sizeof(header));
+		memcpy(header.magic, VK_MINIMAL_CAPTURE_MAGIC, sizeof(header.magic));
+		header.index_offset = 0;
+		write_bytes(cap, &header, sizeof(header));
+	}
+
+	res = pthread_create(&cap->thread, NULL, capture_main, cap);
+	assert(res == 0);
+}
+
+void vk_minimal_capture_destroy(struct vk_minimal_capture *cap)
+{
+	sem_post(&cap->queued);
+	pthread_join(cap->thread, NULL);
+
+	if (cap->container == VK_MINIMAL_CAPTURE_INDEXED)
+	{
+		uint64_t index_offset = cap->offset;
+		uint64_t count = cap->index_count;
+
+		write_bytes(cap, &count, sizeof(count));
+		write_bytes(cap, cap->index, sizeof(cap->index[0])*cap->index_count);
+
+		int err = fseek(cap->file, offsetof(struct vk_minimal_capture_file_header, index_offset), SEEK_SET);
+		assert(err == 0);
+		size_t written = fwrite(&index_offset, sizeof(index_offset), 1, cap->file);
+		assert(written == 1);
+	}
+
+	fclose(cap->file);
+	sem_destroy(&cap->queued);
+	sem_destroy(&cap->done);
+	free(cap->rows);
+	free(cap->index);
+	memset(cap, 0, sizeof(*cap));
+}
+
+int vk_minimal_capture_supported(enum vk_minimal_capture_container container, VkFormat format)
+{
+	uint32_t r, b;
+
+	if (!vk_minimal_capture_format_bpp(format))
+		return 0;
+	return container != VK_MINIMAL_CAPTURE_PPM || rgb_offsets(format, &r, &b);
+}
+
+void vk_minimal_capture_push(struct vk_minimal_capture *cap, const struct vk_minimal_capture_job *job)
+{
+	unsigned tail = atomic_load_explicit(&cap->tail, memory_order_relaxed);
+
+	assert(job->buffer < VK_MINIMAL_CAPTURE_MAX_BUFFERS);
+	assert(!atomic_load_explicit(&cap->busy[job->buffer], memory_order_relaxed));
+	assert(tail - atomic_load_explicit(&cap->head, memory_order_acquire) < VK_MINIMAL_CAPTURE_MAX_BUFFERS);
+
+	atomic_store_explicit(&cap->busy[job->buffer], 1, memory_order_relaxed);
+	cap->jobs[tail % VK_MINIMAL_CAPTURE_MAX_BUFFERS] = *job;
+	atomic_store_explicit(&cap->tail, tail + 1, memory_order_release);
+	sem_post(&cap->queued);
+}
+
+int vk_minimal_capture_busy(struct vk_minimal_capture *cap, uint32_t buffer)
+{
+	return atomic_load_explicit(&cap->busy[buffer], memory_order_acquire);
+}
+
+void vk_minimal_capture_drain(struct vk_minimal_capture *cap)
+{
+	uint32_t i;
+
+	for (i = 0; i < VK_MINIMAL_CAPTURE_MAX_BUFFERS; i++)
+	{
+		// Posts of jobs written earlier may still be pending, so check again
+		while (vk_minimal_capture_busy(cap, i))
+			sem_wait(&cap->done);
+	}
+}
+
+const char *vk_minimal_capture_container_name(enum vk_minimal_capture_container container)
+{
+	switch (container)
+	{
+		case VK_MINIMAL_CAPTURE_OFF: return "off";
+		case VK_MINIMAL_CAPTURE_PPM: return "ppm";
+		case VK_MINIMAL_CAPTURE_RAW: return "raw";
+		case VK_MINIMAL_CAPTURE_INDEXED: return "indexed";
+		default: return "unknown";
+	}
+}
@@ -0,0 +1,149 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#ifndef VK_MINIMAL_CAPTURE_H
+#define VK_MINIMAL_CAPTURE_H
+
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "vk_minimal_alloc.h"
+
+// Readback buffers on top of the frames in flight, i.e. how many frames the
+// writer may fall behind before frames are dropped
+#define VK_MINIMAL_CAPTURE_SLACK 2
+#define VK_MINIMAL_CAPTURE_MAX_BUFFERS 8
+
+enum vk_minimal_capture_container {
+	VK_MINIMAL_CAPTURE_OFF = 0,
+	// Binary PPM images back to back in one file, read as a sequence by
+	// netpbm and ffmpeg
+	VK_MINIMAL_CAPTURE_PPM,
+	// The pixels as read back, rows tightly packed and frames back to back.
+	// Extent and format are only logged.
+	VK_MINIMAL_CAPTURE_RAW,
+	// The raw frames each behind a record, followed by an index of the
+	// records so a frame can be looked up without reading the ones before it
+	VK_MINIMAL_CAPTURE_INDEXED,
+	VK_MINIMAL_CAPTURE_CONTAINER_COUNT
+};
+
+#define VK_MINIMAL_CAPTURE_MAGIC "VKMCAP01"
+
+// VK_MINIMAL_CAPTURE_INDEXED is this header, a record and the pixels of
+// every frame, then a uint64_t record count and the records again as the
+// index. Everything is in host byte order.
+struct vk_minimal_capture_file_header {
+	char magic[8];
+	// Written when the file is closed, 0 for a file that was cut short, whose
+	// records can still be walked from the start
+	uint64_t index_offset;
+};
+
+struct vk_minimal_capture_record {
+	// Of the pixels in the file
+	uint64_t offset;
+	// Frame of the context and CLOCK_MONOTONIC time it was submitted at
+	uint64_t frame;
+	uint64_t ns;
+	uint32_t width;
+	uint32_t height;
+	// VkFormat, vk_minimal_capture_format_bpp() bytes per pixel
+	uint32_t format;
+	uint32_t size;
+};
+
+// A readback buffer handed to the writer
+struct vk_minimal_capture_job {
+	const uint8_t *data;
+	// Invalidated by the writer before reading, NULL for coherent memory
+	const struct vk_minimal_allocation *mem;
+	VkFormat format;
+	uint32_t width;
+	uint32_t height;
+	uint64_t frame;
+	uint64_t ns;
+	uint32_t buffer;
+};
+
+// Streams the frames from a thread of its own. The render thread hands the
+// buffers over in the order they were filled and only reuses one once the
+// writer is done with it.
+struct vk_minimal_capture {
+	enum vk_minimal_capture_container container;
+	struct vk_minimal_allocator *allocator;
+	FILE *file;
+	pthread_t thread;
+
+	// Lock-free ring from the render thread, never holds a buffer twice
+	atomic_uint head __attribute__((aligned(64)));
+	atomic_uint tail __attribute__((aligned(64)));
+	struct vk_minimal_capture_job jobs[VK_MINIMAL_CAPTURE_MAX_BUFFERS];
+	// Posted per job and once more to stop, and per job written
+	sem_t queued;
+	sem_t done;
+	// Set when a buffer is handed over, cleared once it was written
+	atomic_int busy[VK_MINIMAL_CAPTURE_MAX_BUFFERS];
+
+	// Only touched by the writer
+	uint8_t *rows;
+	size_t rows_size;
+	uint64_t offset;
+	struct vk_minimal_capture_record *index;
+	uint32_t index_count;
+	uint32_t index_capacity;
+
+	// Written by the writer, may be read from any thread
+	struct {
+		atomic_uint_fast64_t frames;
+		atomic_uint_fast64_t bytes;
+		atomic_uint_fast64_t write_ns;
+		atomic_uint_fast64_t write_max_ns;
+	} stats;
+};
+
+// Creates the file at path and starts the writer
+void vk_minimal_capture_init(struct vk_minimal_capture *cap, enum vk_minimal_capture_container container, const char *path,
+                             struct vk_minimal_allocator *allocator);
+// Writes what was handed over, completes the file and joins the writer
+void vk_minimal_capture_destroy(struct vk_minimal_capture *cap);
+
+// Bytes per pixel of the color formats a swapchain may have, 0 for others
+uint32_t vk_minimal_capture_format_bpp(VkFormat format);
+// Whether frames in the format can go into the container
+int vk_minimal_capture_supported(enum vk_minimal_capture_container container, VkFormat format);
+void vk_minimal_capture_push(struct vk_minimal_capture *cap, const struct vk_minimal_capture_job *job);
+int vk_minimal_capture_busy(struct vk_minimal_capture *cap, uint32_t buffer);
+// Waits for the writer to be done with every buffer handed over
+void vk_minimal_capture_drain(struct vk_minimal_capture *cap);
+
+const char *vk_minimal_capture_container_name(enum vk_minimal_capture_container container);
+
+#endif
@@ -0,0 +1,161 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#include <string.h>
+
+#include "vk_minimal_damage.h"
+
+static uint64_t rect_area(const struct vk_minimal_rect *r)
+{
+	return (uint64_t)(r->x1 - r->x0) * (r->y1 - r->y0);
+}
+
+static int rect_contains(const struct vk_minimal_rect *a, const struct vk_minimal_rect *b)
+{
+	return a->x0 <= b->x0 && a->y0 <= b->y0 && a->x1 >= b->x1 && a->y1 >= b->y1;
+}
+
+static struct vk_minimal_rect rect_bounds(const struct vk_minimal_rect *a, const struct vk_minimal_rect *b)
+{
+	struct vk_minimal_rect r;
+	r.x0 = a->x0 < b->x0 ? a->x0 : b->x0;
+	r.y0 = a->y0 < b->y0 ? a->y0 : b->y0;
+	r.x1 = a->x1 > b->x1 ? a->x1 : b->x1;
+	r.y1 = a->y1 > b->y1 ? a->y1 : b->y1;
+	return r;
+}
+
+static uint64_t rect_overlap(const struct vk_minimal_rect *a, const struct vk_minimal_rect *b)
+{
+	uint32_t x0 = a->x0 > b->x0 ? a->x0 : b->x0;
+	uint32_t y0 = a->y0 > b->y0 ? a->y0 : b->y0;
+	uint32_t x1 = a->x1 < b->x1 ? a->x1 : b->x1;
+	uint32_t y1 = a->y1 < b->y1 ? a->y1 : b->y1;
+
+	if (x0 >= x1 || y0 >= y1)
+		return 0;
+	return (uint64_t)(x1 - x0) * (y1 - y0);
+}
+
+static void remove_rect(struct vk_minimal_damage *damage, uint32_t i)
+{
+	damage->rects[i] = damage->rects[--damage->count];
+}
+
+void vk_minimal_damage_clear(struct vk_minimal_damage *damage)
+{
+	damage->count = 0;
+}
+
+void vk_minimal_damage_add(struct vk_minimal_damage *damage, struct vk_minimal_rect rect)
+{
+	uint32_t i;
+
+	if (rect.x0 >= rect.x1 || rect.y0 >= rect.y1)
+		return;
+
+	for (i = 0; i < damage->count; i++)
+	{
+		if (rect_contains(&damage->rects[i], &rect))
+			return;
+	}
+
+	for (i = 0; i < damage->count; )
+	{
+		const struct vk_minimal_rect *r = &damage->rects[i];
+		struct vk_minimal_rect bounds = rect_bounds(r, &rect);
+
+		if (rect_contains(&rect, r))
+		{
+			remove_rect(damage, i);
+		}
+		else if (rect_area(&bounds) == rect_area(r) + rect_area(&rect) - rect_overlap(r, &rect))
+		{
+			// The union is exactly a rectangle, the result may merge further
+			remove_rect(damage, i);
+			vk_minimal_damage_add(damage, bounds);
+			return;
+		}
+		else
+		{
+			i++;
+		}
+	}
+
+	if (damage->count == VK_MINIMAL_MAX_DAMAGE_RECTS)
+	{
+		uint32_t best = 0;
+		uint64_t best_growth = UINT64_MAX;
+
+		for (i = 0; i < damage->count; i++)
+		{
+			struct vk_minimal_rect bounds = rect_bounds(&damage->rects[i], &rect);
+			uint64_t growth = rect_area(&bounds) - rect_area(&damage->rects[i]);
+			if (growth < best_growth)
+			{
+				best = i;
+				best_growth = growth;
+			}
+		}
+
+		struct vk_minimal_rect bounds = rect_bounds(&damage->rects[best], &rect);
+		remove_rect(damage, best);
+		vk_minimal_damage_add(damage, bounds);
+		return;
+	}
+
+	damage->rects[damage->count++] = rect;
+}
+
+void vk_minimal_damage_union(struct vk_minimal_damage *damage, const struct vk_minimal_damage *other)
+{
+	uint32_t i;
+
+	for (i = 0; i < other->count; i++)
+	{
+		vk_minimal_damage_add(damage, other->rects[i]);
+	}
+}
+
+uint64_t vk_minimal_damage_area(const struct vk_minimal_damage *damage)
+{
+	uint64_t area = 0;
+	uint32_t i;
+
+	for (i = 0; i < damage->count; i++)
+	{
+		area += rect_area(&damage->rects[i]);
+	}
+
+	return area;
+}
+
+// Same rectangles in the same order, which is what the same sequence of adds gives
+int vk_minimal_damage_equal(const struct vk_minimal_damage *a, const struct vk_minimal_damage *b)
+{
+	return a->count == b->count && memcmp(a->rects, b->rects, a->count * sizeof(a->rects[0])) == 0;
+}
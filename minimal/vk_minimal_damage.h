@@ -0,0 +1,56 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#ifndef VK_MINIMAL_DAMAGE_H
+#define VK_MINIMAL_DAMAGE_H
+
+#include <stdint.h>
+
+#define VK_MINIMAL_MAX_DAMAGE_RECTS 128
+
+// Half-open pixel rectangle [x0, x1) x [y0, y1)
+struct vk_minimal_rect {
+	uint32_t x0, y0;
+	uint32_t x1, y1;
+};
+
+// List of damaged rectangles. Rectangles whose union is itself a rectangle
+// are merged as they are added, and once the list is full the new rectangle
+// is merged with the one that grows the least, so the list never overflows
+// but may cover more than was actually damaged.
+struct vk_minimal_damage {
+	uint32_t count;
+	struct vk_minimal_rect rects[VK_MINIMAL_MAX_DAMAGE_RECTS];
+};
+
+void vk_minimal_damage_clear(struct vk_minimal_damage *damage);
+void vk_minimal_damage_add(struct vk_minimal_damage *damage, struct vk_minimal_rect rect);
+void vk_minimal_damage_union(struct vk_minimal_damage *damage, const struct vk_minimal_damage *other);
+uint64_t vk_minimal_damage_area(const struct vk_minimal_damage *damage);
+int vk_minimal_damage_equal(const struct vk_minimal_damage *a, const struct vk_minimal_damage *b);
+
+#endif
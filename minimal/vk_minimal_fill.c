@@ -0,0 +1,765 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#include "vk_minimal_fill.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define VK_MINIMAL_FILL_X86 1
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#define VK_MINIMAL_FILL_ARM 1
+#include <arm_neon.h>
+#endif
+
+static void stream_scalar(void *dst, const void *src, size_t bytes)
+{
+	memcpy(dst, src, bytes);
+}
+
+#if VK_MINIMAL_FILL_X86
+
+// The canvas is write-combined host memory that the CPU never reads back, so
+// the fast paths bypass the cache with non-temporal stores. Only the stores
+// need to be aligned, the unaligned head and tail are copied normally.
+__attribute__((target("sse2")))
+static void stream_sse2(void *dst, const void *src, size_t bytes)
+{
+	uint8_t *d = dst;
+	const uint8_t *s = src;
+	size_t head = (16 - ((uintptr_t)d & 15)) & 15;
+
+	if (head > bytes)
+		head = bytes;
+	memcpy(d, s, head);
+	d += head;
+	s += head;
+	bytes -= head;
+
+	for (; bytes >= 64; bytes -= 64, d += 64, s += 64)
+	{
+		__m128i a = _mm_loadu_si128((const __m128i *)(s + 0));
+		__m128i b = _mm_loadu_si128((const __m128i *)(s + 16));
+		__m128i c = _mm_loadu_si128((const __m128i *)(s + 32));
+		__m128i e = _mm_loadu_si128((const __m128i *)(s + 48));
+		_mm_stream_si128((__m128i *)(d + 0), a);
+		_mm_stream_si128((__m128i *)(d + 16), b);
+		_mm_stream_si128((__m128i *)(d + 32), c);
+		_mm_stream_si128((__m128i *)(d + 48), e);
+	}
+	for (; bytes >= 16; bytes -= 16, d += 16, s += 16)
+	{
+		_mm_stream_si128((__m128i *)d, _mm_loadu_si128((const __m128i *)s));
+	}
+	memcpy(d, s, bytes);
+}
+
+__attribute__((target("avx2")))
+static void stream_avx2(void *dst, const void *src, size_t bytes)
+{
+	uint8_t *d = dst;
+	const uint8_t *s = src;
+	size_t head = (32 - ((uintptr_t)d & 31)) & 31;
+
+	if (head > bytes)
+		head = bytes;
+	memcpy(d, s, head);
+	d += head;
+	s += head;
+	bytes -= head;
+
+	for (; bytes >= 128; bytes -= 128, d += 128, s += 128)
+	{
+		__m256i a = _mm256_loadu_si256((const __m256i *)(s + 0));
+		__m256i b = _mm256_loadu_si256((const __m256i *)(s + 32));
+		__m256i c = _mm256_loadu_si256((const __m256i *)(s + 64));
+		__m256i e = _mm256_loadu_si256((const __m256i *)(s + 96));
+		_mm256_stream_si256((__m256i *)(d + 0), a);
+		_mm256_stream_si256((__m256i *)(d + 32), b);
+		_mm256_stream_si256((__m256i *)(d + 64), c);
+		_mm256_stream_si256((__m256i *)(d + 96), e);
+	}
+	for (; bytes >= 32; bytes -= 32, d += 32, s += 32)
+	{
+		_mm256_stream_si256((__m256i *)d, _mm256_loadu_si256((const __m256i *)s));
+	}
+	memcpy(d, s, bytes);
+}
+
+#endif
+
+#if VK_MINIMAL_FILL_ARM
+
+static void stream_neon(void *dst, const void *src, size_t bytes)
+{
+	uint8_t *d = dst;
+	const uint8_t *s = src;
+	size_t head = (16 - ((uintptr_t)d & 15)) & 15;
+
+	if (head > bytes)
+		head = bytes;
+	memcpy(d, s, head);
+	d += head;
+	s += head;
+	bytes -= head;
+
+	for (; bytes >= 64; bytes -= 64, d += 64, s += 64)
+	{
+		uint8x16x4_t v = vld1q_u8_x4(s);
+#if defined(__clang__)
+		// Lowers to stnp on arm64
+		__builtin_nontemporal_store(v.val[0], (uint8x16_t *)(d + 0));
+		__builtin_nontemporal_store(v.val[1], (uint8x16_t *)(d + 16));
+		__builtin_nontemporal_store(v.val[2], (uint8x16_t *)(d + 32));
+		__builtin_nontemporal_store(v.val[3], (uint8x16_t *)(d + 48));
+#else
+		vst1q_u8_x4(d, v);
+#endif
+	}
+	for (; bytes >= 16; bytes -= 16, d += 16, s += 16)
+	{
+		vst1q_u8(d, vld1q_u8(s));
+	}
+	memcpy(d, s, bytes);
+}
+
+#endif
+
+static uint32_t expand_565(uint16_t p)
+{
+	const uint32_t r = p >> 11, g = (p >> 5) & 0x3f, b = p & 0x1f;
+	return 0xff000000 | (r << 3 | r >> 2) << 16 | (g << 2 | g >> 4) << 8 | (b << 3 | b >> 2);
+}
+
+static uint32_t expand_4444(uint16_t p)
+{
+	const uint32_t b = p >> 12, g = (p >> 8) & 0xf, r = (p >> 4) & 0xf, a = p & 0xf;
+	return (a * 0x11) << 24 | (r * 0x11) << 16 | (g * 0x11) << 8 | b * 0x11;
+}
+
+static void expand_565_scalar(uint32_t *dst, const uint16_t *src, uint32_t count)
+{
+	uint32_t i;
+
+	for (i = 0; i < count; i++)
+		dst[i] = expand_565(src[i]);
+}
+
+static void expand_4444_scalar(uint32_t *dst, const uint16_t *src, uint32_t count)
+{
+	uint32_t i;
+
+	for (i = 0; i < count; i++)
+		dst[i] = expand_4444(src[i]);
+}
+
+static void pack_565_scalar(uint16_t *dst, const uint32_t *src, uint32_t count)
+{
+	uint32_t i;
+
+	for (i = 0; i < count; i++)
+		dst[i] = vk_minimal_fill_pack(VK_MINIMAL_FILL_565, src[i]);
+}
+
+static void pack_4444_scalar(uint16_t *dst, const uint32_t *src, uint32_t count)
+{
+	uint32_t i;
+
+	for (i = 0; i < count; i++)
+		dst[i] = vk_minimal_fill_pack(VK_MINIMAL_FILL_4444, src[i]);
+}
+
+#if VK_MINIMAL_FILL_X86
+
+// Eight pixels at a time, the channels are widened to bytes in 16 bit lanes
+// that are then interleaved into G:B and A:R halves of each 32 bit pixel. Only
+// runs when the color changes so AVX2 uses this too.
+__attribute__((target("sse2")))
+static void expand_565_sse2(uint32_t *dst, const uint16_t *src, uint32_t count)
+{
+	const __m128i mask5 = _mm_set1_epi16(0x1f), mask6 = _mm_set1_epi16(0x3f), alpha = _mm_set1_epi16((short)0xff00);
+	uint32_t i;
+
+	for (i = 0; i + 8 <= count; i += 8)
+	{
+		__m128i p = _mm_loadu_si128((const __m128i *)(src + i));
+		__m128i r = _mm_srli_epi16(p, 11);
+		__m128i g = _mm_and_si128(_mm_srli_epi16(p, 5), mask6);
+		__m128i b = _mm_and_si128(p, mask5);
+		r = _mm_or_si128(_mm_slli_epi16(r, 3), _mm_srli_epi16(r, 2));
+		g = _mm_or_si128(_mm_slli_epi16(g, 2), _mm_srli_epi16(g, 4));
+		b = _mm_or_si128(_mm_slli_epi16(b, 3), _mm_srli_epi16(b, 2));
+		__m128i gb = _mm_or_si128(_mm_slli_epi16(g, 8), b);
+		__m128i ar = _mm_or_si128(alpha, r);
+		_mm_storeu_si128((__m128i *)(dst + i), _mm_unpacklo_epi16(gb, ar));
+		_mm_storeu_si128((__m128i *)(dst + i + 4), _mm_unpackhi_epi16(gb, ar));
+	}
+	expand_565_scalar(dst + i, src + i, count - i);
+}
+
+__attribute__((target("sse2")))
+static void expand_4444_sse2(uint32_t *dst, const uint16_t *src, uint32_t count)
+{
+	const __m128i mask4 = _mm_set1_epi16(0xf), dup = _mm_set1_epi16(0x11);
+	uint32_t i;
+
+	for (i = 0; i + 8 <= count; i += 8)
+	{
+		__m128i p = _mm_loadu_si128((const __m128i *)(src + i));
+		__m128i b = _mm_mullo_epi16(_mm_srli_epi16(p, 12), dup);
+		__m128i g = _mm_mullo_epi16(_mm_and_si128(_mm_srli_epi16(p, 8), mask4), dup);
+		__m128i r = _mm_mullo_epi16(_mm_and_si128(_mm_srli_epi16(p, 4), mask4), dup);
+		__m128i a = _mm_mullo_epi16(_mm_and_si128(p, mask4), dup);
+		__m128i gb = _mm_or_si128(_mm_slli_epi16(g, 8), b);
+		__m128i ar = _mm_or_si128(_mm_slli_epi16(a, 8), r);
+		_mm_storeu_si128((__m128i *)(dst + i), _mm_unpacklo_epi16(gb, ar));
+		_mm_storeu_si128((__m128i *)(dst + i + 4), _mm_unpackhi_epi16(gb, ar));
+	}
+	expand_4444_scalar(dst + i, src + i, count - i);
+}
+
+// The packed pixels are sign extended so that the saturating pack to 16 bit
+// leaves them alone, SSE2 has no unsigned 32 bit one
+__attribute__((target("sse2")))
+static __m128i narrow_sse2(__m128i a, __m128i b)
+{
+	a = _mm_srai_epi32(_mm_slli_epi32(a, 16), 16);
+	b = _mm_srai_epi32(_mm_slli_epi32(b, 16), 16);
+	return _mm_packs_epi32(a, b);
+}
+
+__attribute__((target("sse2")))
+static __m128i pack_565_x4_sse2(__m128i p)
+{
+	__m128i r = _mm_and_si128(_mm_srli_epi32(p, 8), _mm_set1_epi32(0xf800));
+	__m128i g = _mm_and_si128(_mm_srli_epi32(p, 5), _mm_set1_epi32(0x07e0));
+	__m128i b = _mm_and_si128(_mm_srli_epi32(p, 3), _mm_set1_epi32(0x001f));
+	return _mm_or_si128(_mm_or_si128(r, g), b);
+}
+
+__attribute__((target("sse2")))
+static __m128i pack_4444_x4_sse2(__m128i p)
+{
+	__m128i b = _mm_and_si128(_mm_slli_epi32(p, 8), _mm_set1_epi32(0xf000));
+	__m128i g = _mm_and_si128(_mm_srli_epi32(p, 4), _mm_set1_epi32(0x0f00));
+	__m128i r = _mm_and_si128(_mm_srli_epi32(p, 16), _mm_set1_epi32(0x00f0));
+	__m128i a = _mm_srli_epi32(p, 28);
+	return _mm_or_si128(_mm_or_si128(b, g), _mm_or_si128(r, a));
+}
+
+__attribute__((target("sse2")))
+static void pack_565_sse2(uint16_t *dst, const uint32_t *src, uint32_t count)
+{
+	uint32_t i;
+
+	for (i = 0; i + 8 <= count; i += 8)
+	{
+		__m128i a = pack_565_x4_sse2(_mm_loadu_si128((const __m128i *)(src + i)));
+		__m128i b = pack_565_x4_sse2(_mm_loadu_si128((const __m128i *)(src + i + 4)));
+		_mm_storeu_si128((__m128i *)(dst + i), narrow_sse2(a, b));
+	}
+	pack_565_scalar(dst + i, src + i, count - i);
+}
+
+__attribute__((target("sse2")))
+static void pack_4444_sse2(uint16_t *dst, const uint32_t *src, uint32_t count)
+{
+	uint32_t i;
+
+	for (i = 0; i + 8 <= count; i += 8)
+	{
+		__m128i a = pack_4444_x4_sse2(_mm_loadu_si128((const __m128i *)(src + i)));
+		__m128i b = pack_4444_x4_sse2(_mm_loadu_si128((const __m128i *)(src + i + 4)));
+		_mm_storeu_si128((__m128i *)(dst + i), narrow_sse2(a, b));
+	}
+	pack_4444_scalar(dst + i, src + i, count - i);
+}
+
+#endif
+
+#if VK_MINIMAL_FILL_ARM
+
+// Same as SSE2, vst2q interleaves the halves on the way out
+static void expand_565_neon(uint32_t *dst, const uint16_t *src, uint32_t count)
+{
+	const uint16x8_t mask5 = vdupq_n_u16(0x1f), mask6 = vdupq_n_u16(0x3f), alpha = vdupq_n_u16(0xff00);
+	uint32_t i;
+
+	for (i = 0; i + 8 <= count; i += 8)
+	{
+		uint16x8_t p = vld1q_u16(src + i);
+		uint16x8_t r = vshrq_n_u16(p, 11);
+		uint16x8_t g = vandq_u16(vshrq_n_u16(p, 5), mask6);
+		uint16x8_t b = vandq_u16(p, mask5);
+		r = vorrq_u16(vshlq_n_u16(r, 3), vshrq_n_u16(r, 2));
+		g = vorrq_u16(vshlq_n_u16(g, 2), vshrq_n_u16(g, 4));
+		b = vorrq_u16(vshlq_n_u16(b, 3), vshrq_n_u16(b, 2));
+		uint16x8x2_t v;
+		v.val[0] = vorrq_u16(vshlq_n_u16(g, 8), b);
+		v.val[1] = vorrq_u16(alpha, r);
+		vst2q_u16((uint16_t *)(dst + i), v);
+	}
+	expand_565_scalar(dst + i, src + i, count - i);
+}
+
+static void expand_4444_neon(uint32_t *dst, const uint16_t *src, uint32_t count)
+{
+	const uint16x8_t mask4 = vdupq_n_u16(0xf);
+	uint32_t i;
+
+	for (i = 0; i + 8 <= count; i += 8)
+	{
+		uint16x8_t p = vld1q_u16(src + i);
+		uint16x8_t b = vmulq_n_u16(vshrq_n_u16(p, 12), 0x11);
+		uint16x8_t g = vmulq_n_u16(vandq_u16(vshrq_n_u16(p, 8), mask4), 0x11);
+		uint16x8_t r = vmulq_n_u16(vandq_u16(vshrq_n_u16(p, 4), mask4), 0x11);
+		uint16x8_t a = vmulq_n_u16(vandq_u16(p, mask4), 0x11);
+		uint16x8x2_t v;
+		v.val[0] = vorrq_u16(vshlq_n_u16(g, 8), b);
+		v.val[1] = vorrq_u16(vshlq_n_u16(a, 8), r);
+		vst2q_u16((uint16_t *)(dst + i), v);
+	}
+	expand_4444_scalar(dst + i, src + i, count - i);
+}
+
+static uint16x4_t pack_565_x4_neon(uint32x4_t p)
+{
+	uint32x4_t r = vandq_u32(vshrq_n_u32(p, 8), vdupq_n_u32(0xf800));
+	uint32x4_t g = vandq_u32(vshrq_n_u32(p, 5), vdupq_n_u32(0x07e0));
+	uint32x4_t b = vandq_u32(vshrq_n_u32(p, 3), vdupq_n_u32(0x001f));
+	return vmovn_u32(vorrq_u32(vorrq_u32(r, g), b));
+}
+
+static uint16x4_t pack_4444_x4_neon(uint32x4_t p)
+{
+	uint32x4_t b = vandq_u32(vshlq_n_u32(p, 8), vdupq_n_u32(0xf000));
+	uint32x4_t g = vandq_u32(vshrq_n_u32(p, 4), vdupq_n_u32(0x0f00));
+	uint32x4_t r = vandq_u32(vshrq_n_u32(p, 16), vdupq_n_u32(0x00f0));
+	uint32x4_t a = vshrq_n_u32(p, 28);
+	return vmovn_u32(vorrq_u32(vorrq_u32(b, g), vorrq_u32(r, a)));
+}
+
+static void pack_565_neon(uint16_t *dst, const uint32_t *src, uint32_t count)
+{
+	uint32_t i;
+
+	for (i = 0; i + 8 <= count; i += 8)
+		vst1q_u16(dst + i, vcombine_u16(pack_565_x4_neon(vld1q_u32(src + i)), pack_565_x4_neon(vld1q_u32(src + i + 4))));
+	pack_565_scalar(dst + i, src + i, count - i);
+}
+
+static void pack_4444_neon(uint16_t *dst, const uint32_t *src, uint32_t count)
+{
+	uint32_t i;
+
+	for (i = 0; i + 8 <= count; i += 8)
+		vst1q_u16(dst + i, vcombine_u16(pack_4444_x4_neon(vld1q_u32(src + i)), pack_4444_x4_neon(vld1q_u32(src + i + 4))));
+	pack_4444_scalar(dst + i, src + i, count - i);
+}
+
+#endif
+
+const char *vk_minimal_fill_path_name(enum vk_minimal_fill_path path)
+{
+	switch (path)
+	{
+		case VK_MINIMAL_FILL_AUTO: return "auto";
+		case VK_MINIMAL_FILL_SCALAR: return "scalar";
+		case VK_MINIMAL_FILL_SSE2: return "sse2";
+		case VK_MINIMAL_FILL_AVX2: return "avx2";
+		case VK_MINIMAL_FILL_NEON: return "neon";
+		default: return "unknown";
+	}
+}
+
+int vk_minimal_fill_path_supported(enum vk_minimal_fill_path path)
+{
+	switch (path)
+	{
+		case VK_MINIMAL_FILL_AUTO:
+		case VK_MINIMAL_FILL_SCALAR:
+		return 1;
+#if VK_MINIMAL_FILL_X86
+		case VK_MINIMAL_FILL_SSE2:
+		return __builtin_cpu_supports("sse2");
+		case VK_MINIMAL_FILL_AVX2:
+		return __builtin_cpu_supports("avx2");
+#endif
+#if VK_MINIMAL_FILL_ARM
+		case VK_MINIMAL_FILL_NEON:
+		return 1;
+#endif
+		default:
+		return 0;
+	}
+}
+
+static enum vk_minimal_fill_path select_path(void)
+{
+	static const enum vk_minimal_fill_path preferred[] = {
+		VK_MINIMAL_FILL_AVX2,
+		VK_MINIMAL_FILL_SSE2,
+		VK_MINIMAL_FILL_NEON
+	};
+	uint32_t i;
+
+	for (i = 0; i < sizeof(preferred)/sizeof(preferred[0]); i++)
+	{
+		if (vk_minimal_fill_path_supported(preferred[i]))
+			return preferred[i];
+	}
+
+	return VK_MINIMAL_FILL_SCALAR;
+}
+
+const char *vk_minimal_fill_format_name(enum vk_minimal_fill_format format)
+{
+	switch (format)
+	{
+		case VK_MINIMAL_FILL_8888: return "8888";
+		case VK_MINIMAL_FILL_565: return "565";
+		case VK_MINIMAL_FILL_4444: return "4444";
+		case VK_MINIMAL_FILL_565_AS_8888: return "565_as_8888";
+		case VK_MINIMAL_FILL_4444_AS_8888: return "4444_as_8888";
+		default: return "unknown";
+	}
+}
+
+uint32_t vk_minimal_fill_format_bpp(enum vk_minimal_fill_format format)
+{
+	switch (format)
+	{
+		case VK_MINIMAL_FILL_565:
+		case VK_MINIMAL_FILL_4444:
+		return sizeof(uint16_t);
+		default:
+		return sizeof(uint32_t);
+	}
+}
+
+uint32_t vk_minimal_fill_pack(enum vk_minimal_fill_format format, uint32_t color)
+{
+	const uint32_t a = color >> 24, r = (color >> 16) & 0xff, g = (color >> 8) & 0xff, b = color & 0xff;
+
+	switch (format)
+	{
+		case VK_MINIMAL_FILL_565:
+		return (r >> 3) << 11 | (g >> 2) << 5 | b >> 3;
+		case VK_MINIMAL_FILL_4444:
+		return (b >> 4) << 12 | (g >> 4) << 8 | (r >> 4) << 4 | a >> 4;
+		case VK_MINIMAL_FILL_565_AS_8888:
+		return expand_565(vk_minimal_fill_pack(VK_MINIMAL_FILL_565, color));
+		case VK_MINIMAL_FILL_4444_AS_8888:
+		return expand_4444(vk_minimal_fill_pack(VK_MINIMAL_FILL_4444, color));
+		default:
+		return color;
+	}
+}
+
+// The 16 bit layout behind a format, 8888 for the plain 32 bit one
+static enum vk_minimal_fill_format packed_format(enum vk_minimal_fill_format format)
+{
+	switch (format)
+	{
+		case VK_MINIMAL_FILL_565:
+		case VK_MINIMAL_FILL_565_AS_8888:
+		return VK_MINIMAL_FILL_565;
+		case VK_MINIMAL_FILL_4444:
+		case VK_MINIMAL_FILL_4444_AS_8888:
+		return VK_MINIMAL_FILL_4444;
+		default:
+		return VK_MINIMAL_FILL_8888;
+	}
+}
+
+static void build_rows(struct vk_minimal_fill *fill, uint32_t color)
+{
+	uint32_t x;
+
+	if (fill->format == VK_MINIMAL_FILL_8888)
+	{
+		uint32_t *line = fill->row_line, *plain = fill->row_plain;
+
+		for (x = 0; x < fill->width; x++)
+		{
+			line[x] = color;
+			plain[x] = (x % VK_MINIMAL_GRID_SPACING == 0) ? color : 0x0;
+		}
+	}
+	else
+	{
+		// Expanded rows are built in their 16 bit layout first, the same
+		// quantization as the blitted canvases
+		const uint16_t pixel = vk_minimal_fill_pack(packed_format(fill->format), color);
+		uint16_t *line = fill->row_packed ? fill->row_packed : fill->row_line;
+		uint16_t *plain = fill->row_packed ? fill->row_packed + fill->width : fill->row_plain;
+
+		for (x = 0; x < fill->width; x++)
+		{
+			line[x] = pixel;
+			plain[x] = (x % VK_MINIMAL_GRID_SPACING == 0) ? pixel : 0x0;
+		}
+
+		// Paid once per color rather than per frame
+		if (fill->row_packed)
+		{
+			fill->expand(fill->row_line, line, fill->width);
+			fill->expand(fill->row_plain, plain, fill->width);
+		}
+	}
+	fill->color = color;
+}
+
+void vk_minimal_fill_init(struct vk_minimal_fill *fill, enum vk_minimal_fill_path path, enum vk_minimal_fill_format format, uint32_t width)
+{
+	memset(fill, 0, sizeof(*fill));
+
+	if (path == VK_MINIMAL_FILL_AUTO)
+		path = select_path();
+	assert(vk_minimal_fill_path_supported(path));
+	assert(format < VK_MINIMAL_FILL_FORMAT_COUNT);
+
+	fill->path = path;
+	switch (path)
+	{
+#if VK_MINIMAL_FILL_X86
+		case VK_MINIMAL_FILL_SSE2: fill->stream = stream_sse2; break;
+		case VK_MINIMAL_FILL_AVX2: fill->stream = stream_avx2; break;
+#endif
+#if VK_MINIMAL_FILL_ARM
+		case VK_MINIMAL_FILL_NEON: fill->stream = stream_neon; break;
+#endif
+		default: fill->stream = stream_scalar; break;
+	}
+
+	fill->format = format;
+	if (packed_format(format) != VK_MINIMAL_FILL_8888)
+	{
+		const int is_565 = packed_format(format) == VK_MINIMAL_FILL_565;
+		switch (path)
+		{
+#if VK_MINIMAL_FILL_X86
+			case VK_MINIMAL_FILL_SSE2:
+			case VK_MINIMAL_FILL_AVX2:
+			fill->expand = is_565 ? expand_565_sse2 : expand_4444_sse2;
+			fill->pack = is_565 ? pack_565_sse2 : pack_4444_sse2;
+			break;
+#endif
+#if VK_MINIMAL_FILL_ARM
+			case VK_MINIMAL_FILL_NEON:
+			fill->expand = is_565 ? expand_565_neon : expand_4444_neon;
+			fill->pack = is_565 ? pack_565_neon : pack_4444_neon;
+			break;
+#endif
+			default:
+			fill->expand = is_565 ? expand_565_scalar : expand_4444_scalar;
+			fill->pack = is_565 ? pack_565_scalar : pack_4444_scalar;
+			break;
+		}
+	}
+
+	fill->width = width;
+	fill->bpp = vk_minimal_fill_format_bpp(format);
+	int res;
+	res = posix_memalign(&fill->row_line, 64, width * fill->bpp);
+	assert(res == 0);
+	res = posix_memalign(&fill->row_plain, 64, width * fill->bpp);
+	assert(res == 0);
+	if (fill->expand && fill->bpp == sizeof(uint32_t))
+	{
+		fill->row_packed = malloc(2 * width * sizeof(uint16_t));
+		assert(fill->row_packed);
+	}
+
+	build_rows(fill, 0x0);
+}
+
+void vk_minimal_fill_destroy(struct vk_minimal_fill *fill)
+{
+	free(fill->row_line);
+	free(fill->row_plain);
+	free(fill->row_packed);
+	memset(fill, 0, sizeof(*fill));
+}
+
+void vk_minimal_fill_grid_prepare(struct vk_minimal_fill *fill, uint32_t color)
+{
+	if (fill->color != color)
+		build_rows(fill, color);
+}
+
+void vk_minimal_fill_fence(const struct vk_minimal_fill *fill)
+{
+#if VK_MINIMAL_FILL_X86
+	// Order the non-temporal stores before the canvas is handed to the GPU
+	if (fill->path != VK_MINIMAL_FILL_SCALAR)
+		_mm_sfence();
+#else
+	(void)fill;
+#endif
+}
+
+const void *vk_minimal_fill_grid_row(const struct vk_minimal_fill *fill, uint32_t y)
+{
+	return y % VK_MINIMAL_GRID_SPACING == 0 ? fill->row_line : fill->row_plain;
+}
+
+void vk_minimal_fill_unpack(const struct vk_minimal_fill *fill, uint32_t *dst, const void *src, uint32_t count)
+{
+	if (fill->bpp == sizeof(uint16_t))
+		fill->expand(dst, src, count);
+	else
+		memcpy(dst, src, count * sizeof(uint32_t));
+}
+
+void vk_minimal_fill_store(const struct vk_minimal_fill *fill, void *dst, const uint32_t *src, uint32_t count)
+{
+	// Converted in chunks that stay in L1 on the way to the canvas
+	uint16_t packed[256];
+	uint32_t expanded[256];
+	uint8_t *d = dst;
+	uint32_t i, n;
+
+	if (fill->format == VK_MINIMAL_FILL_8888)
+	{
+		fill->stream(dst, src, count * sizeof(uint32_t));
+		return;
+	}
+
+	for (i = 0; i < count; i += n, d += n * fill->bpp)
+	{
+		n = count - i < 256 ? count - i : 256;
+		fill->pack(packed, src + i, n);
+		if (fill->bpp == sizeof(uint16_t))
+		{
+			fill->stream(d, packed, n * sizeof(uint16_t));
+		}
+		else
+		{
+			fill->expand(expanded, packed, n);
+			fill->stream(d, expanded, n * sizeof(uint32_t));
+		}
+	}
+}
+
+static void fill_rect(const struct vk_minimal_fill *fill, void *data, size_t row_pitch, const struct vk_minimal_rect *rect)
+{
+	const size_t bytes = (rect->x1 - rect->x0) * fill->bpp;
+	const size_t offset = rect->x0 * fill->bpp;
+	uint8_t *row = (uint8_t *)data + rect->y0 * row_pitch + offset;
+	uint32_t y, k;
+
+	// Track the position within the grid period instead of dividing per row
+	for (y = rect->y0, k = rect->y0 % VK_MINIMAL_GRID_SPACING; y < rect->y1; y++, row += row_pitch)
+	{
+		fill->stream(row, (const uint8_t *)(k == 0 ? fill->row_line : fill->row_plain) + offset, bytes);
+		if (++k == VK_MINIMAL_GRID_SPACING)
+			k = 0;
+	}
+}
+
+void vk_minimal_fill_grid_rect(const struct vk_minimal_fill *fill, void *data, size_t row_pitch, const struct vk_minimal_rect *rect)
+{
+	fill_rect(fill, data, row_pitch, rect);
+	vk_minimal_fill_fence(fill);
+}
+
+struct band_job {
+	const struct vk_minimal_fill *fill;
+	void *data;
+	size_t row_pitch;
+	const struct vk_minimal_rect *rects;
+	uint32_t count;
+};
+
+static void fill_band(void *arg, uint32_t band)
+{
+	struct band_job *job = arg;
+	const uint32_t y0 = band * VK_MINIMAL_FILL_BAND_ROWS;
+	const uint32_t y1 = y0 + VK_MINIMAL_FILL_BAND_ROWS;
+	uint32_t i;
+
+	for (i = 0; i < job->count; i++)
+	{
+		struct vk_minimal_rect r = job->rects[i];
+		if (r.y0 < y0)
+			r.y0 = y0;
+		if (r.y1 > y1)
+			r.y1 = y1;
+		if (r.y0 < r.y1)
+			fill_rect(job->fill, job->data, job->row_pitch, &r);
+	}
+	vk_minimal_fill_fence(job->fill);
+}
+
+void vk_minimal_fill_grid(const struct vk_minimal_fill *fill, struct vk_minimal_pool *pool, void *data, size_t row_pitch,
+                          const struct vk_minimal_rect *rects, uint32_t count)
+{
+	uint32_t i, height = 0;
+
+	if (!pool || pool->threads <= 1)
+	{
+		for (i = 0; i < count; i++)
+			fill_rect(fill, data, row_pitch, &rects[i]);
+		vk_minimal_fill_fence(fill);
+		return;
+	}
+
+	for (i = 0; i < count; i++)
+	{
+		if (rects[i].y1 > height)
+			height = rects[i].y1;
+	}
+
+	struct band_job job = {fill, data, row_pitch, rects, count};
+	vk_minimal_pool_run(pool, (height + VK_MINIMAL_FILL_BAND_ROWS - 1) / VK_MINIMAL_FILL_BAND_ROWS, fill_band, &job);
+}
+
+void vk_minimal_fill_grid_ref(enum vk_minimal_fill_format format, uint32_t color, void *data, size_t row_pitch,
+                              uint32_t width, uint32_t y0, uint32_t y1)
+{
+	const uint32_t pixel = vk_minimal_fill_pack(format, color);
+	const uint32_t background = vk_minimal_fill_pack(format, 0x0);
+	const uint32_t bpp = vk_minimal_fill_format_bpp(format);
+	uint8_t *row = (uint8_t *)data + y0 * row_pitch;
+	uint32_t x, y;
+
+	for (y = y0; y < y1; y++)
+	{
+		for (x = 0; x < width; x++)
+		{
+			uint32_t p = (x % VK_MINIMAL_GRID_SPACING == 0 || y % VK_MINIMAL_GRID_SPACING == 0) ? pixel : background;
+			if (bpp == sizeof(uint16_t))
+				((uint16_t *)row)[x] = p;
+			else
+				((uint32_t *)row)[x] = p;
+		}
+		row += row_pitch;
+	}
+}
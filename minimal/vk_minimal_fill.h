@@ -0,0 +1,116 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#ifndef VK_MINIMAL_FILL_H
+#define VK_MINIMAL_FILL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "vk_minimal_damage.h"
+#include "vk_minimal_pool.h"
+
+#define VK_MINIMAL_GRID_SPACING 100
+
+// Rows per pool task, small enough for idle threads to find work to steal
+#define VK_MINIMAL_FILL_BAND_ROWS 16
+
+enum vk_minimal_fill_path {
+	VK_MINIMAL_FILL_AUTO = 0,
+	VK_MINIMAL_FILL_SCALAR,
+	VK_MINIMAL_FILL_SSE2,
+	VK_MINIMAL_FILL_AVX2,
+	VK_MINIMAL_FILL_NEON,
+	VK_MINIMAL_FILL_PATH_COUNT
+};
+
+// Pixel layout of the canvas. Colors are always passed in as 0xAARRGGBB and
+// packed by the fill, the 32 bit layouts are taken as is whatever the channel
+// order of the canvas, which the gray grid doesn't notice.
+enum vk_minimal_fill_format {
+	VK_MINIMAL_FILL_8888 = 0,
+	// R5G6B5_UNORM_PACK16
+	VK_MINIMAL_FILL_565,
+	// B4G4R4A4_UNORM_PACK16
+	VK_MINIMAL_FILL_4444,
+	// Quantized to the 16 bit layout and expanded back to 32 bit, for 16 bit
+	// canvases the device can't convert
+	VK_MINIMAL_FILL_565_AS_8888,
+	VK_MINIMAL_FILL_4444_AS_8888,
+	VK_MINIMAL_FILL_FORMAT_COUNT
+};
+
+// The grid only has two kinds of rows, one that lies on a horizontal grid
+// line and one that only crosses the vertical lines. Both are built once per
+// color and then streamed into the canvas row by row.
+struct vk_minimal_fill {
+	enum vk_minimal_fill_path path;
+	enum vk_minimal_fill_format format;
+	void (*stream)(void *dst, const void *src, size_t bytes);
+	// Between 0xAARRGGBB and the 16 bit layout, NULL for 8888
+	void (*expand)(uint32_t *dst, const uint16_t *src, uint32_t count);
+	void (*pack)(uint16_t *dst, const uint32_t *src, uint32_t count);
+	uint32_t width;
+	// Bytes per pixel of the rows and the canvas
+	uint32_t bpp;
+	uint32_t color;
+	void *row_line;
+	void *row_plain;
+	// The 16 bit rows before they are expanded, NULL unless expanding
+	uint16_t *row_packed;
+};
+
+const char *vk_minimal_fill_path_name(enum vk_minimal_fill_path path);
+int vk_minimal_fill_path_supported(enum vk_minimal_fill_path path);
+const char *vk_minimal_fill_format_name(enum vk_minimal_fill_format format);
+uint32_t vk_minimal_fill_format_bpp(enum vk_minimal_fill_format format);
+// The 0xAARRGGBB color as it is stored in the canvas
+uint32_t vk_minimal_fill_pack(enum vk_minimal_fill_format format, uint32_t color);
+
+void vk_minimal_fill_init(struct vk_minimal_fill *fill, enum vk_minimal_fill_path path, enum vk_minimal_fill_format format, uint32_t width);
+void vk_minimal_fill_destroy(struct vk_minimal_fill *fill);
+
+void vk_minimal_fill_grid_prepare(struct vk_minimal_fill *fill, uint32_t color);
+void vk_minimal_fill_grid_rect(const struct vk_minimal_fill *fill, void *data, size_t row_pitch, const struct vk_minimal_rect *rect);
+
+// For drawing over the grid: the grid row in the canvas layout, converting a
+// span of it to 0xAARRGGBB and streaming a span of 0xAARRGGBB into the canvas
+// layout. The stores are ordered before the canvas is handed to the GPU by
+// vk_minimal_fill_fence() on the thread that made them.
+const void *vk_minimal_fill_grid_row(const struct vk_minimal_fill *fill, uint32_t y);
+void vk_minimal_fill_unpack(const struct vk_minimal_fill *fill, uint32_t *dst, const void *src, uint32_t count);
+void vk_minimal_fill_store(const struct vk_minimal_fill *fill, void *dst, const uint32_t *src, uint32_t count);
+void vk_minimal_fill_fence(const struct vk_minimal_fill *fill);
+
+// Splits the rectangles into bands of rows and fills them on the pool, pool may be NULL
+void vk_minimal_fill_grid(const struct vk_minimal_fill *fill, struct vk_minimal_pool *pool, void *data, size_t row_pitch,
+                          const struct vk_minimal_rect *rects, uint32_t count);
+
+// Straightforward per pixel version kept as the reference for the fast paths
+void vk_minimal_fill_grid_ref(enum vk_minimal_fill_format format, uint32_t color, void *data, size_t row_pitch,
+                              uint32_t width, uint32_t y0, uint32_t y1);
+
+#endif
@@ -0,0 +1,157 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#include "vk_minimal_pool.h"
+#include <assert.h>
+#include <string.h>
+#include <unistd.h>
+
+static void run_tasks(struct vk_minimal_pool *pool, uint32_t self)
+{
+	uint32_t i, task;
+
+	// Own range first, then walk the other ranges and steal what is left
+	for (i = 0; i < pool->threads; i++)
+	{
+		struct vk_minimal_pool_range *range = &pool->ranges[(self + i) % pool->threads];
+
+		while ((task = atomic_fetch_add_explicit(&range->next, 1, memory_order_relaxed)) < range->end)
+		{
+			pool->fn(pool->arg, task);
+		}
+	}
+}
+
+static void *worker_main(void *p)
+{
+	struct vk_minimal_pool_worker *worker = p;
+	struct vk_minimal_pool *pool = worker->pool;
+	uint32_t seen = 0;
+
+	while (1)
+	{
+		pthread_mutex_lock(&pool->lock);
+		while (pool->generation == seen && !pool->quit)
+			pthread_cond_wait(&pool->wake, &pool->lock);
+		if (pool->quit)
+		{
+			pthread_mutex_unlock(&pool->lock);
+			return NULL;
+		}
+		seen = pool->generation;
+		pthread_mutex_unlock(&pool->lock);
+
+		run_tasks(pool, worker->self);
+
+		pthread_mutex_lock(&pool->lock);
+		if (--pool->busy == 0)
+			pthread_cond_signal(&pool->done);
+		pthread_mutex_unlock(&pool->lock);
+	}
+}
+
+void vk_minimal_pool_init(struct vk_minimal_pool *pool, uint32_t threads)
+{
+	uint32_t i;
+	int res;
+
+	memset(pool, 0, sizeof(*pool));
+
+	if (threads == 0)
+	{
+		long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		threads = cpus > 0 ? cpus : 1;
+	}
+	if (threads > VK_MINIMAL_POOL_MAX_THREADS)
+		threads = VK_MINIMAL_POOL_MAX_THREADS;
+	pool->threads = threads;
+
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->wake, NULL);
+	pthread_cond_init(&pool->done, NULL);
+
+	for (i = 1; i < threads; i++)
+	{
+		pool->workers[i].pool = pool;
+		pool->workers[i].self = i;
+		res = pthread_create(&pool->workers[i].thread, NULL, worker_main, &pool->workers[i]);
+		assert(res == 0);
+	}
+}
+
+void vk_minimal_pool_destroy(struct vk_minimal_pool *pool)
+{
+	uint32_t i;
+
+	pthread_mutex_lock(&pool->lock);
+	pool->quit = 1;
+	pthread_cond_broadcast(&pool->wake);
+	pthread_mutex_unlock(&pool->lock);
+
+	for (i = 1; i < pool->threads; i++)
+	{
+		pthread_join(pool->workers[i].thread, NULL);
+	}
+
+	pthread_cond_destroy(&pool->done);
+	pthread_cond_destroy(&pool->wake);
+	pthread_mutex_destroy(&pool->lock);
+	pool->threads = 0;
+}
+
+void vk_minimal_pool_run(struct vk_minimal_pool *pool, uint32_t tasks, vk_minimal_task_fn fn, void *arg)
+{
+	uint32_t i;
+
+	if (pool->threads <= 1)
+	{
+		for (i = 0; i < tasks; i++)
+			fn(arg, i);
+		return;
+	}
+
+	// Contiguous ranges keep neighbouring tasks on the same thread
+	pthread_mutex_lock(&pool->lock);
+	pool->fn = fn;
+	pool->arg = arg;
+	for (i = 0; i < pool->threads; i++)
+	{
+		atomic_store_explicit(&pool->ranges[i].next, (uint64_t)tasks * i / pool->threads, memory_order_relaxed);
+		pool->ranges[i].end = (uint64_t)tasks * (i + 1) / pool->threads;
+	}
+	pool->busy = pool->threads - 1;
+	pool->generation++;
+	pthread_cond_broadcast(&pool->wake);
+	pthread_mutex_unlock(&pool->lock);
+
+	run_tasks(pool, 0);
+
+	pthread_mutex_lock(&pool->lock);
+	while (pool->busy > 0)
+		pthread_cond_wait(&pool->done, &pool->lock);
+	pthread_mutex_unlock(&pool->lock);
+}
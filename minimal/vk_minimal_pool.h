@@ -0,0 +1,78 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#ifndef VK_MINIMAL_POOL_H
+#define VK_MINIMAL_POOL_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+#define VK_MINIMAL_POOL_MAX_THREADS 64
+
+typedef void (*vk_minimal_task_fn)(void *arg, uint32_t task);
+
+// Range of task indices initially assigned to one thread. Tasks are claimed
+// with an atomic increment, both by the owner and by threads that ran out of
+// work and steal from it, so no task is ever run twice.
+struct vk_minimal_pool_range {
+	atomic_uint next;
+	uint32_t end;
+} __attribute__((aligned(64)));
+
+struct vk_minimal_pool_worker {
+	pthread_t thread;
+	struct vk_minimal_pool *pool;
+	uint32_t self;
+};
+
+// Persistent workers. The thread calling vk_minimal_pool_run() takes part as
+// thread 0 so a pool of one thread never leaves the caller.
+struct vk_minimal_pool {
+	uint32_t threads;
+	struct vk_minimal_pool_worker workers[VK_MINIMAL_POOL_MAX_THREADS];
+	struct vk_minimal_pool_range ranges[VK_MINIMAL_POOL_MAX_THREADS];
+
+	pthread_mutex_t lock;
+	pthread_cond_t wake;
+	pthread_cond_t done;
+	uint32_t generation;
+	uint32_t busy;
+	int quit;
+
+	vk_minimal_task_fn fn;
+	void *arg;
+};
+
+// threads == 0 uses one thread per online CPU
+void vk_minimal_pool_init(struct vk_minimal_pool *pool, uint32_t threads);
+void vk_minimal_pool_destroy(struct vk_minimal_pool *pool);
+
+// Runs fn(arg, 0..tasks-1) across the pool and returns once all have finished
+void vk_minimal_pool_run(struct vk_minimal_pool *pool, uint32_t tasks, vk_minimal_task_fn fn, void *arg);
+
+#endif
@@ -0,0 +1,220 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#include "vk_minimal_prof.h"
+#include <assert.h>
+#include <string.h>
+#include <time.h>
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+void vk_minimal_prof_init(struct vk_minimal_prof *prof, const struct vulkan_dlfcn_device *vkd, VkDevice device, float timestamp_period, uint32_t valid_bits, uint32_t slots)
+{
+	VkResult err;
+
+	assert(slots <= VK_MINIMAL_PROF_MAX_SLOTS);
+	memset(prof, 0, sizeof(*prof));
+	atomic_init(&prof->head, 0);
+	atomic_init(&prof->tail, 0);
+	atomic_init(&prof->dropped, 0);
+	prof->vkd = vkd;
+
+	if (valid_bits == 0)
+		return;
+
+	prof->timestamp_period = timestamp_period;
+	prof->timestamp_mask = valid_bits >= 64 ? ~0ull : (1ull << valid_bits) - 1;
+
+	// A begin and end timestamp for every frame slot
+	VkQueryPoolCreateInfo qpci;
+	memset(&qpci, 0, sizeof(qpci));
+	qpci.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	qpci.pNext = NULL;
+	qpci.flags = 0;
+	qpci.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	qpci.queryCount = 2 * slots;
+	qpci.pipelineStatistics = 0;
+
+	err = vkd->vkCreateQueryPool(device, &qpci, NULL, &prof->query_pool);
+	assert(err == VK_SUCCESS);
+}
+
+void vk_minimal_prof_destroy(struct vk_minimal_prof *prof, VkDevice device)
+{
+	if (prof->query_pool)
+		prof->vkd->vkDestroyQueryPool(device, prof->query_pool, NULL);
+	prof->query_pool = VK_NULL_HANDLE;
+}
+
+void vk_minimal_prof_begin(struct vk_minimal_prof *prof)
+{
+	prof->start = now_ns();
+}
+
+void vk_minimal_prof_phase(struct vk_minimal_prof *prof, uint32_t slot, enum vk_minimal_prof_phase phase)
+{
+	struct vk_minimal_prof_sample *sample = &prof->pending[slot];
+	uint64_t now = now_ns();
+
+	sample->cpu_ns[phase] += now - sample->mark;
+	sample->mark = now;
+}
+
+void vk_minimal_prof_mark(struct vk_minimal_prof *prof, uint32_t slot)
+{
+	prof->pending[slot].mark = now_ns();
+}
+
+void vk_minimal_prof_gpu_begin(struct vk_minimal_prof *prof, VkCommandBuffer cmd, uint32_t slot)
+{
+	if (!prof->query_pool)
+		return;
+
+	prof->vkd->vkCmdResetQueryPool(cmd, prof->query_pool, 2 * slot, 2);
+	prof->vkd->vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, prof->query_pool, 2 * slot);
+}
+
+void vk_minimal_prof_gpu_end(struct vk_minimal_prof *prof, VkCommandBuffer cmd, uint32_t slot)
+{
+	if (!prof->query_pool)
+		return;
+
+	prof->vkd->vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, prof->query_pool, 2 * slot + 1);
+}
+
+static void push(struct vk_minimal_prof *prof, const struct vk_minimal_prof_sample *sample)
+{
+	unsigned head = atomic_load_explicit(&prof->head, memory_order_relaxed);
+	unsigned tail = atomic_load_explicit(&prof->tail, memory_order_acquire);
+
+	if (head - tail >= VK_MINIMAL_PROF_RING_SIZE)
+	{
+		atomic_fetch_add_explicit(&prof->dropped, 1, memory_order_relaxed);
+		return;
+	}
+
+	prof->ring[head & (VK_MINIMAL_PROF_RING_SIZE - 1)] = *sample;
+	atomic_store_explicit(&prof->head, head + 1, memory_order_release);
+}
+
+void vk_minimal_prof_resolve(struct vk_minimal_prof *prof, VkDevice device, uint32_t slot)
+{
+	struct vk_minimal_prof_sample *sample = &prof->pending[slot];
+
+	if (prof->pending_valid[slot])
+	{
+		uint64_t ts[2];
+
+		// The fence of the slot has signaled so the results are available
+		if (prof->query_pool &&
+		    prof->vkd->vkGetQueryPoolResults(device, prof->query_pool, 2 * slot, 2, sizeof(ts), ts, sizeof(ts[0]), VK_QUERY_RESULT_64_BIT) == VK_SUCCESS)
+		{
+			uint64_t ticks = ((ts[1] & prof->timestamp_mask) - (ts[0] & prof->timestamp_mask)) & prof->timestamp_mask;
+			sample->gpu_ns = ticks * prof->timestamp_period;
+		}
+		push(prof, sample);
+	}
+
+	memset(sample, 0, sizeof(*sample));
+	sample->frame = prof->frame++;
+	sample->mark = prof->start;
+	prof->pending_valid[slot] = 0;
+}
+
+void vk_minimal_prof_submitted(struct vk_minimal_prof *prof, uint32_t slot)
+{
+	prof->pending_valid[slot] = 1;
+}
+
+uint32_t vk_minimal_prof_drain(struct vk_minimal_prof *prof, struct vk_minimal_prof_sample *out, uint32_t max)
+{
+	unsigned tail = atomic_load_explicit(&prof->tail, memory_order_relaxed);
+	unsigned head = atomic_load_explicit(&prof->head, memory_order_acquire);
+	uint32_t count = 0;
+
+	while (tail != head && count < max)
+	{
+		out[count++] = prof->ring[tail & (VK_MINIMAL_PROF_RING_SIZE - 1)];
+		tail++;
+	}
+	atomic_store_explicit(&prof->tail, tail, memory_order_release);
+
+	return count;
+}
+
+const char *vk_minimal_prof_phase_name(enum vk_minimal_prof_phase phase)
+{
+	static const char *names[VK_MINIMAL_PROF_PHASE_COUNT] = {
+		"wait",
+		"fill",
+		"acquire",
+		"record",
+		"submit",
+		"present"
+	};
+
+	return phase < VK_MINIMAL_PROF_PHASE_COUNT ? names[phase] : "unknown";
+}
+
+void vk_minimal_prof_write_csv(FILE *f, const struct vk_minimal_prof_sample *samples, uint32_t count, int header)
+{
+	uint32_t i, p;
+
+	if (header)
+	{
+		fprintf(f, "frame");
+		for (p = 0; p < VK_MINIMAL_PROF_PHASE_COUNT; p++)
+			fprintf(f, ",%s_ns", vk_minimal_prof_phase_name(p));
+		fprintf(f, ",gpu_copy_ns\n");
+	}
+
+	for (i = 0; i < count; i++)
+	{
+		fprintf(f, "%llu", (unsigned long long)samples[i].frame);
+		for (p = 0; p < VK_MINIMAL_PROF_PHASE_COUNT; p++)
+			fprintf(f, ",%llu", (unsigned long long)samples[i].cpu_ns[p]);
+		fprintf(f, ",%llu\n", (unsigned long long)samples[i].gpu_ns);
+	}
+}
+
+void vk_minimal_prof_write_json(FILE *f, const struct vk_minimal_prof_sample *samples, uint32_t count)
+{
+	uint32_t i, p;
+
+	for (i = 0; i < count; i++)
+	{
+		fprintf(f, "{\"frame\":%llu", (unsigned long long)samples[i].frame);
+		for (p = 0; p < VK_MINIMAL_PROF_PHASE_COUNT; p++)
+			fprintf(f, ",\"%s_ns\":%llu", vk_minimal_prof_phase_name(p), (unsigned long long)samples[i].cpu_ns[p]);
+		fprintf(f, ",\"gpu_copy_ns\":%llu}\n", (unsigned long long)samples[i].gpu_ns);
+	}
+}
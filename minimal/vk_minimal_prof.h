@@ -0,0 +1,132 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#ifndef VK_MINIMAL_PROF_H
+#define VK_MINIMAL_PROF_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "vulkan_dlfcn/vulkan_dlfcn.h"
+
+// Samples kept until drained, must be a power of two
+#define VK_MINIMAL_PROF_RING_SIZE 256
+// At least VK_MINIMAL_MAX_FRAMES_IN_FLIGHT
+#define VK_MINIMAL_PROF_MAX_SLOTS 4
+
+enum vk_minimal_prof_phase {
+	// Waiting for the frame slot to be released by the GPU
+	VK_MINIMAL_PROF_WAIT = 0,
+	// Producing the canvas contents and flushing them
+	VK_MINIMAL_PROF_FILL,
+	VK_MINIMAL_PROF_ACQUIRE,
+	VK_MINIMAL_PROF_RECORD,
+	VK_MINIMAL_PROF_SUBMIT,
+	VK_MINIMAL_PROF_PRESENT,
+	VK_MINIMAL_PROF_PHASE_COUNT
+};
+
+struct vk_minimal_prof_sample {
+	uint64_t frame;
+	uint64_t cpu_ns[VK_MINIMAL_PROF_PHASE_COUNT];
+	// Time the GPU spent on the copy into the swapchain image, 0 if unknown
+	uint64_t gpu_ns;
+
+	// Time the last phase ended, only used while the sample is being filled
+	uint64_t mark;
+};
+
+// Samples are completed once the GPU timestamps of their frame slot can be
+// read, which is the next time that slot is waited on. They are then pushed
+// into a single producer, single consumer ring so another thread can drain
+// them without taking a lock. Samples are dropped when the ring is full.
+struct vk_minimal_prof {
+	struct vk_minimal_prof_sample ring[VK_MINIMAL_PROF_RING_SIZE];
+	atomic_uint head;
+	atomic_uint tail;
+	atomic_uint dropped;
+
+	uint64_t frame;
+	uint64_t start;
+	const struct vulkan_dlfcn_device *vkd;
+	VkQueryPool query_pool;
+	double timestamp_period;
+	uint64_t timestamp_mask;
+	struct vk_minimal_prof_sample pending[VK_MINIMAL_PROF_MAX_SLOTS];
+	// Set once the frame of the pending sample was submitted, samples of
+	// dropped frames are never pushed
+	int pending_valid[VK_MINIMAL_PROF_MAX_SLOTS];
+};
+
+// Instrumentation in vk_minimal.c is only compiled in with VK_MINIMAL_PROFILE
+// defined. The context layout and the functions below do not depend on it.
+#ifdef VK_MINIMAL_PROFILE
+#define VK_MINIMAL_PROF_BEGIN(prof) vk_minimal_prof_begin(prof)
+#define VK_MINIMAL_PROF_PHASE(prof, slot, phase) vk_minimal_prof_phase(prof, slot, phase)
+#define VK_MINIMAL_PROF_MARK(prof, slot) vk_minimal_prof_mark(prof, slot)
+#define VK_MINIMAL_PROF_GPU_BEGIN(prof, cmd, slot) vk_minimal_prof_gpu_begin(prof, cmd, slot)
+#define VK_MINIMAL_PROF_GPU_END(prof, cmd, slot) vk_minimal_prof_gpu_end(prof, cmd, slot)
+#define VK_MINIMAL_PROF_RESOLVE(prof, device, slot) vk_minimal_prof_resolve(prof, device, slot)
+#define VK_MINIMAL_PROF_SUBMITTED(prof, slot) vk_minimal_prof_submitted(prof, slot)
+#else
+#define VK_MINIMAL_PROF_BEGIN(prof) ((void)0)
+#define VK_MINIMAL_PROF_PHASE(prof, slot, phase) ((void)0)
+#define VK_MINIMAL_PROF_MARK(prof, slot) ((void)0)
+#define VK_MINIMAL_PROF_GPU_BEGIN(prof, cmd, slot) ((void)0)
+#define VK_MINIMAL_PROF_GPU_END(prof, cmd, slot) ((void)0)
+#define VK_MINIMAL_PROF_RESOLVE(prof, device, slot) ((void)0)
+#define VK_MINIMAL_PROF_SUBMITTED(prof, slot) ((void)0)
+#endif
+
+// valid_bits is timestampValidBits of the queue family, 0 disables the GPU timestamps
+void vk_minimal_prof_init(struct vk_minimal_prof *prof, const struct vulkan_dlfcn_device *vkd, VkDevice device, float timestamp_period, uint32_t valid_bits, uint32_t slots);
+void vk_minimal_prof_destroy(struct vk_minimal_prof *prof, VkDevice device);
+
+// Called before waiting for the slot, the wait is the first phase
+void vk_minimal_prof_begin(struct vk_minimal_prof *prof);
+void vk_minimal_prof_phase(struct vk_minimal_prof *prof, uint32_t slot, enum vk_minimal_prof_phase phase);
+// Charges the time since the last phase to none, e.g. while the other
+// contexts of a batch are drawn
+void vk_minimal_prof_mark(struct vk_minimal_prof *prof, uint32_t slot);
+void vk_minimal_prof_gpu_begin(struct vk_minimal_prof *prof, VkCommandBuffer cmd, uint32_t slot);
+void vk_minimal_prof_gpu_end(struct vk_minimal_prof *prof, VkCommandBuffer cmd, uint32_t slot);
+// Called once the fence of the slot has signaled. Completes and pushes the
+// previous sample of the slot if its frame was submitted, and starts the one
+// for the new frame.
+void vk_minimal_prof_resolve(struct vk_minimal_prof *prof, VkDevice device, uint32_t slot);
+// The frame of the slot went out, its timestamps will be written
+void vk_minimal_prof_submitted(struct vk_minimal_prof *prof, uint32_t slot);
+
+// Moves up to max completed samples into out, may run on another thread
+uint32_t vk_minimal_prof_drain(struct vk_minimal_prof *prof, struct vk_minimal_prof_sample *out, uint32_t max);
+
+const char *vk_minimal_prof_phase_name(enum vk_minimal_prof_phase phase);
+void vk_minimal_prof_write_csv(FILE *f, const struct vk_minimal_prof_sample *samples, uint32_t count, int header);
+// Writes one JSON object per sample and line so files can be appended to
+void vk_minimal_prof_write_json(FILE *f, const struct vk_minimal_prof_sample *samples, uint32_t count);
+
+#endif
@@ -0,0 +1,241 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#include "vk_minimal_render.h"
+#include <assert.h>
+#include <sched.h>
+#include <string.h>
+#include <time.h>
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// The sender owns tail and the render thread head, each only reads the
+// other's index to tell whether the ring is full or empty
+static int queue_push(struct vk_minimal_render_queue *q, const struct vk_minimal_render_cmd *cmd)
+{
+	unsigned tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+
+	if (tail - atomic_load_explicit(&q->head, memory_order_acquire) == VK_MINIMAL_RENDER_QUEUE_SIZE)
+		return 0;
+	q->cmds[tail % VK_MINIMAL_RENDER_QUEUE_SIZE] = *cmd;
+	// Sequentially consistent for the check of sleeping that follows
+	atomic_store(&q->tail, tail + 1);
+	return 1;
+}
+
+static int queue_pop(struct vk_minimal_render_queue *q, struct vk_minimal_render_cmd *cmd)
+{
+	unsigned head = atomic_load_explicit(&q->head, memory_order_relaxed);
+
+	if (atomic_load(&q->tail) == head)
+		return 0;
+	*cmd = q->cmds[head % VK_MINIMAL_RENDER_QUEUE_SIZE];
+	atomic_store_explicit(&q->head, head + 1, memory_order_release);
+	return 1;
+}
+
+// Either the sender sees the flag and posts, or this sees its command
+static void wait_for_cmd(struct vk_minimal_render *r)
+{
+	atomic_store(&r->sleeping, 1);
+	if (atomic_load(&r->queue.tail) == atomic_load_explicit(&r->queue.head, memory_order_relaxed))
+	{
+		sem_wait(&r->wake);
+	}
+	else if (!atomic_exchange(&r->sleeping, 0))
+	{
+		// A sender took the flag already, consume its post
+		sem_wait(&r->wake);
+	}
+}
+
+static void record_latency(struct vk_minimal_render *r, uint64_t ns)
+{
+	atomic_store_explicit(&r->stats.latency_ns, ns, memory_order_relaxed);
+	if (ns > atomic_load_explicit(&r->stats.latency_max_ns, memory_order_relaxed))
+		atomic_store_explicit(&r->stats.latency_max_ns, ns, memory_order_relaxed);
+	atomic_fetch_add_explicit(&r->stats.latency_total_ns, ns, memory_order_relaxed);
+	atomic_fetch_add_explicit(&r->stats.latency_count, 1, memory_order_relaxed);
+}
+
+static void *render_main(void *p)
+{
+	struct vk_minimal_render *r = p;
+	struct vk_minimal_context *actx = r->actx;
+	struct vk_minimal_render_cmd cmd;
+	VkBool32 continuous = VK_TRUE;
+	int running = 1;
+	int initialized = 0;
+	int paused = 0;
+	int has_target = 0;
+	int redraw = 0;
+	// Sent time of the first command asking for a frame since the last one
+	uint64_t pending_ns = 0;
+
+	while (running)
+	{
+		while (queue_pop(&r->queue, &cmd))
+		{
+			switch (cmd.op)
+			{
+				case VK_MINIMAL_RENDER_SURFACE_CREATED:
+				if (!initialized)
+				{
+					actx->surface = cmd.surface;
+					vk_minimal_init(actx);
+					initialized = 1;
+				}
+				else
+				{
+					vk_minimal_surface_created(actx, cmd.surface);
+				}
+				has_target = 1;
+				redraw = 1;
+				break;
+
+				case VK_MINIMAL_RENDER_SURFACE_LOST:
+				if (has_target)
+					vk_minimal_surface_lost(actx);
+				has_target = 0;
+				break;
+
+				case VK_MINIMAL_RENDER_RESIZE:
+				if (initialized)
+					vk_minimal_resize(actx, cmd.extent.width, cmd.extent.height);
+				else
+					actx->swapchain.requested = cmd.extent;
+				redraw = 1;
+				break;
+
+				case VK_MINIMAL_RENDER_PAUSE:
+				paused = 1;
+				break;
+
+				case VK_MINIMAL_RENDER_RESUME:
+				paused = 0;
+				redraw = 1;
+				break;
+
+				case VK_MINIMAL_RENDER_PARAMS:
+				continuous = cmd.params.continuous;
+				if (cmd.params.present_policy != actx->present_policy)
+				{
+					actx->present_policy = cmd.params.present_policy;
+					if (has_target)
+						actx->swapchain.stale = VK_TRUE;
+				}
+				redraw = 1;
+				break;
+
+				case VK_MINIMAL_RENDER_REDRAW:
+				redraw = 1;
+				break;
+
+				case VK_MINIMAL_RENDER_QUIT:
+				if (initialized)
+					vk_minimal_destroy(actx);
+				running = 0;
+				break;
+			}
+
+			if (redraw && pending_ns == 0)
+				pending_ns = cmd.sent_ns;
+			if (cmd.sync)
+				sem_post(&r->done);
+			if (!running)
+				break;
+		}
+		if (!running)
+			break;
+
+		if (has_target && !paused && (continuous || redraw))
+		{
+			vk_minimal_draw(actx);
+			redraw = 0;
+			atomic_fetch_add_explicit(&r->stats.frames, 1, memory_order_relaxed);
+			if (pending_ns)
+			{
+				record_latency(r, now_ns() - pending_ns);
+				pending_ns = 0;
+			}
+		}
+		else
+		{
+			wait_for_cmd(r);
+		}
+	}
+
+	return NULL;
+}
+
+void vk_minimal_render_start(struct vk_minimal_render *r, struct vk_minimal_context *actx)
+{
+	int res;
+
+	memset(r, 0, sizeof(*r));
+	r->actx = actx;
+	sem_init(&r->wake, 0, 0);
+	sem_init(&r->done, 0, 0);
+
+	res = pthread_create(&r->thread, NULL, render_main, r);
+	assert(res == 0);
+}
+
+void vk_minimal_render_stop(struct vk_minimal_render *r)
+{
+	struct vk_minimal_render_cmd cmd;
+	memset(&cmd, 0, sizeof(cmd));
+	cmd.op = VK_MINIMAL_RENDER_QUIT;
+	vk_minimal_render_send(r, cmd);
+
+	pthread_join(r->thread, NULL);
+	sem_destroy(&r->done);
+	sem_destroy(&r->wake);
+}
+
+void vk_minimal_render_send(struct vk_minimal_render *r, struct vk_minimal_render_cmd cmd)
+{
+	cmd.sent_ns = now_ns();
+	while (!queue_push(&r->queue, &cmd))
+		sched_yield();
+
+	if (atomic_exchange(&r->sleeping, 0))
+		sem_post(&r->wake);
+}
+
+void vk_minimal_render_send_sync(struct vk_minimal_render *r, struct vk_minimal_render_cmd cmd)
+{
+	cmd.sync = 1;
+	vk_minimal_render_send(r, cmd);
+	while (sem_wait(&r->done) != 0)
+		;
+}
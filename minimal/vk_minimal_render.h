@@ -0,0 +1,121 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#ifndef VK_MINIMAL_RENDER_H
+#define VK_MINIMAL_RENDER_H
+
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+#include "vk_minimal.h"
+
+// Power of two
+#define VK_MINIMAL_RENDER_QUEUE_SIZE 64
+
+enum vk_minimal_render_op {
+	// Creates the device on the first surface, VK_NULL_HANDLE renders offscreen
+	VK_MINIMAL_RENDER_SURFACE_CREATED = 0,
+	// Destroys the swapchain, send it with vk_minimal_render_send_sync()
+	// before destroying the surface
+	VK_MINIMAL_RENDER_SURFACE_LOST,
+	VK_MINIMAL_RENDER_RESIZE,
+	// No frames are drawn while paused, the commands are still handled
+	VK_MINIMAL_RENDER_PAUSE,
+	VK_MINIMAL_RENDER_RESUME,
+	VK_MINIMAL_RENDER_PARAMS,
+	// Asks for one frame, e.g. after input or an expose, a no-op while
+	// continuous other than for the latency stats
+	VK_MINIMAL_RENDER_REDRAW,
+	// Sent by vk_minimal_render_stop()
+	VK_MINIMAL_RENDER_QUIT
+};
+
+struct vk_minimal_render_cmd {
+	enum vk_minimal_render_op op;
+	// Set by the send functions
+	uint64_t sent_ns;
+	int sync;
+	union {
+		VkSurfaceKHR surface;
+		VkExtent2D extent;
+		struct {
+			// Draws back to back, otherwise only on VK_MINIMAL_RENDER_REDRAW
+			VkBool32 continuous;
+			// The swapchain is recreated when it changes
+			enum vk_minimal_present_policy present_policy;
+		} params;
+	};
+};
+
+// Lock-free ring between exactly one sending thread and the render thread
+struct vk_minimal_render_queue {
+	atomic_uint head __attribute__((aligned(64)));
+	atomic_uint tail __attribute__((aligned(64)));
+	struct vk_minimal_render_cmd cmds[VK_MINIMAL_RENDER_QUEUE_SIZE];
+};
+
+// Owns the context from vk_minimal_render_start() until
+// vk_minimal_render_stop() returns, the context is not to be touched from
+// any other thread in between. The sending thread keeps the instance and
+// the surfaces.
+struct vk_minimal_render {
+	struct vk_minimal_context *actx;
+	pthread_t thread;
+	struct vk_minimal_render_queue queue;
+
+	// Posted when the render thread went to sleep on an empty queue, and
+	// when a synchronous command is done
+	atomic_int sleeping;
+	sem_t wake;
+	sem_t done;
+
+	// Written by the render thread, may be read from any thread
+	struct {
+		atomic_uint_fast64_t frames;
+		// From the first command sent since the previous frame until the
+		// next frame was queued for presentation
+		atomic_uint_fast64_t latency_ns;
+		atomic_uint_fast64_t latency_max_ns;
+		atomic_uint_fast64_t latency_total_ns;
+		atomic_uint_fast64_t latency_count;
+	} stats;
+};
+
+// The context has everything set that goes before vk_minimal_init(),
+// initialization happens on the render thread with the first surface
+void vk_minimal_render_start(struct vk_minimal_render *r, struct vk_minimal_context *actx);
+// Destroys what the render thread created and joins it
+void vk_minimal_render_stop(struct vk_minimal_render *r);
+
+// Only ever from one thread. Waits for room when the render thread falls
+// behind, the sync variant also for the command to be handled.
+void vk_minimal_render_send(struct vk_minimal_render *r, struct vk_minimal_render_cmd cmd);
+void vk_minimal_render_send_sync(struct vk_minimal_render *r, struct vk_minimal_render_cmd cmd);
+
+#endif
@@ -26,15 +26,46 @@ For more information, please refer to <http://unlicense.org>
 */
 
 #include <assert.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <xcb/xcb.h>
 
 #include "vulkan_dlfcn/vulkan_dlfcn.h"
 #include "vk_minimal.h"
+#include "vk_minimal_render.h"
 
 #define LOGI(...) ((void)printf(__VA_ARGS__))
 #define LOGW(...) ((void)printf(__VA_ARGS__))
 
+// When a new frame is drawn
+enum frame_pacing {
+	// The render thread draws back to back
+	PACING_CONTINUOUS,
+	// At most the given rate, each frame asked for by the event loop
+	PACING_CAPPED,
+	// Only when the window was exposed, resized or got input
+	PACING_ON_DAMAGE
+};
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static xcb_atom_t intern_atom(xcb_connection_t *connection, const char *name)
+{
+	xcb_intern_atom_reply_t *reply = xcb_intern_atom_reply(connection, xcb_intern_atom(connection, 0, strlen(name), name), NULL);
+	assert(reply);
+	xcb_atom_t atom = reply->atom;
+	free(reply);
+	return atom;
+}
+
 int main(int argc, char **argv)
 {
 	// Load libvulkan.so
@@ -43,6 +74,27 @@ int main(int argc, char **argv)
 	struct vk_minimal_context actx;
 	memset(&actx, 0, sizeof(actx));
 
+	// Optional arguments select the number of frames in flight, fill threads,
+	// upload mode, whether uploads stay on the graphics queue, the frame
+	// pacing, the frame rate for capped pacing and the canvas format
+	enum frame_pacing pacing = PACING_CONTINUOUS;
+	uint32_t fps = 60;
+	if (argc > 1)
+		actx.frames_in_flight = atoi(argv[1]);
+	if (argc > 2)
+		actx.fill_threads = atoi(argv[2]);
+	if (argc > 3)
+		actx.upload = atoi(argv[3]);
+	if (argc > 4)
+		actx.single_queue = atoi(argv[4]) != 0;
+	if (argc > 5)
+		pacing = atoi(argv[5]);
+	if (argc > 6)
+		fps = atoi(argv[6]);
+	if (argc > 7)
+		actx.canvas_format = atoi(argv[7]);
+	assert(pacing <= PACING_ON_DAMAGE && fps > 0);
+
 	xcb_connection_t *connection;
 	xcb_screen_t *screen;
 	xcb_window_t window;
@@ -73,6 +125,11 @@ int main(int argc, char **argv)
 	                  XCB_WINDOW_CLASS_INPUT_OUTPUT, screen->root_visual,
 	                  value_mask, value_list);
 
+	// Have the window manager send a message instead of killing the connection
+	xcb_atom_t wm_protocols = intern_atom(connection, "WM_PROTOCOLS");
+	xcb_atom_t wm_delete_window = intern_atom(connection, "WM_DELETE_WINDOW");
+	xcb_change_property(connection, XCB_PROP_MODE_REPLACE, window, wm_protocols, XCB_ATOM_ATOM, 32, 1, &wm_delete_window);
+
 	xcb_map_window(connection, window);
 
 	const uint32_t coords[] = {100, 100};
@@ -114,16 +171,150 @@ int main(int argc, char **argv)
 	asci.window = window;
 	asci.connection = connection;
 
-	err = vkCreateXcbSurfaceKHR(actx.instance, &asci, NULL, &actx.surface);
+	VkSurfaceKHR surface;
+	err = vkCreateXcbSurfaceKHR(actx.instance, &asci, NULL, &surface);
 	assert(err == VK_SUCCESS);
 
-	vk_minimal_init(&actx);
+	// From here on the context belongs to the render thread, this one only
+	// handles events and sends commands
+	const enum vk_minimal_upload upload = actx.upload;
+	struct vk_minimal_render render;
+	vk_minimal_render_start(&render, &actx);
+
+	struct vk_minimal_render_cmd cmd;
+	memset(&cmd, 0, sizeof(cmd));
+	cmd.op = VK_MINIMAL_RENDER_PARAMS;
+	cmd.params.continuous = pacing == PACING_CONTINUOUS;
+	cmd.params.present_policy = actx.present_policy;
+	vk_minimal_render_send(&render, cmd);
+
+	cmd.op = VK_MINIMAL_RENDER_SURFACE_CREATED;
+	cmd.surface = surface;
+	vk_minimal_render_send(&render, cmd);
+
+	const uint64_t period_ns = 1000000000ull / fps;
+	const int fd = xcb_get_file_descriptor(connection);
+	VkExtent2D extent = {0, 0};
+	uint64_t t0 = now_ns();
+	uint64_t next_ns = t0;
+	uint64_t frames0 = 0;
+	int running = 1;
+	int visible = 1;
 
-	while (1)
+	while (running)
 	{
-		vk_minimal_draw(&actx);
+		xcb_generic_event_t *event;
+		while ((event = xcb_poll_for_event(connection)))
+		{
+			memset(&cmd, 0, sizeof(cmd));
+			switch (event->response_type & ~0x80)
+			{
+				case XCB_EXPOSE:
+				if (((xcb_expose_event_t *)event)->count == 0)
+				{
+					cmd.op = VK_MINIMAL_RENDER_REDRAW;
+					vk_minimal_render_send(&render, cmd);
+				}
+				break;
+
+				case XCB_CONFIGURE_NOTIFY:
+				{
+					const xcb_configure_notify_event_t *cne = (const xcb_configure_notify_event_t *)event;
+					if (cne->width != extent.width || cne->height != extent.height)
+					{
+						extent.width = cne->width;
+						extent.height = cne->height;
+						cmd.op = VK_MINIMAL_RENDER_RESIZE;
+						cmd.extent = extent;
+						vk_minimal_render_send(&render, cmd);
+					}
+					break;
+				}
+
+				case XCB_MAP_NOTIFY:
+				visible = 1;
+				cmd.op = VK_MINIMAL_RENDER_RESUME;
+				vk_minimal_render_send(&render, cmd);
+				break;
+
+				case XCB_UNMAP_NOTIFY:
+				visible = 0;
+				cmd.op = VK_MINIMAL_RENDER_PAUSE;
+				vk_minimal_render_send(&render, cmd);
+				break;
+
+				case XCB_KEY_RELEASE:
+				// Stands in for input that changes what is drawn
+				cmd.op = VK_MINIMAL_RENDER_REDRAW;
+				vk_minimal_render_send(&render, cmd);
+				break;
+
+				case XCB_CLIENT_MESSAGE:
+				if (((xcb_client_message_event_t *)event)->data.data32[0] == wm_delete_window)
+					running = 0;
+				break;
+			}
+			free(event);
+		}
+		if (xcb_connection_has_error(connection))
+			running = 0;
+		if (!running)
+			break;
+
+		// The render thread draws continuously on its own, capped frames are
+		// asked for one at a time
+		uint64_t now = now_ns();
+		if (visible && pacing == PACING_CAPPED && now >= next_ns)
+		{
+			memset(&cmd, 0, sizeof(cmd));
+			cmd.op = VK_MINIMAL_RENDER_REDRAW;
+			vk_minimal_render_send(&render, cmd);
+
+			// Keep to the rate on average, but don't catch up after a stall
+			next_ns += period_ns;
+			if (next_ns < now)
+				next_ns = now + period_ns;
+		}
+
+		// Report throughput about once per second while drawing
+		if (now - t0 >= 1000000000ull)
+		{
+			uint64_t frames = atomic_load(&render.stats.frames);
+			uint64_t count = atomic_load(&render.stats.latency_count);
+			if (frames > frames0)
+			{
+				double secs = (now - t0) * 1e-9;
+				LOGI("%s: %.1f frames/s, input to present %.3f ms (avg %.3f ms, max %.3f ms)\n",
+				     vk_minimal_upload_name(upload), (frames - frames0) / secs,
+				     atomic_load(&render.stats.latency_ns) * 1e-6,
+				     count ? atomic_load(&render.stats.latency_total_ns) * 1e-6 / count : 0.0,
+				     atomic_load(&render.stats.latency_max_ns) * 1e-6);
+			}
+			frames0 = frames;
+			t0 = now;
+		}
+
+		// Sleep until the next event, the next capped frame or report
+		uint64_t wake_ns = t0 + 1000000000ull;
+		if (visible && pacing == PACING_CAPPED && next_ns < wake_ns)
+			wake_ns = next_ns;
+		int timeout = wake_ns > now ? (int)((wake_ns - now + 999999) / 1000000) : 0;
+
+		struct pollfd pfd;
+		pfd.fd = fd;
+		pfd.events = POLLIN;
+		pfd.revents = 0;
+		xcb_flush(connection);
+		poll(&pfd, 1, timeout);
 	}
 
+	// Joins the render thread, which destroys the swapchain and device first
+	vk_minimal_render_stop(&render);
+	vkDestroySurfaceKHR(actx.instance, surface, NULL);
+	vkDestroyInstance(actx.instance, NULL);
+	xcb_destroy_window(connection, window);
+	xcb_disconnect(connection);
+
 	return 0;
 }
 
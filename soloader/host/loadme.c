@@ -0,0 +1,87 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "soloader.h"
+
+// Smallest reloadable module, edit the message and rebuild while the host
+// runs. The frame count is in the state and carries over. The message comes
+// from an exported function so a reload that binds to the old copy shows.
+
+struct loadme {
+	unsigned frames;
+};
+
+const char *loadme_message(void)
+{
+	return "frame";
+}
+
+static void *create(void *app)
+{
+	(void)app;
+	return calloc(1, sizeof(struct loadme));
+}
+
+static void destroy(void *state)
+{
+	free(state);
+}
+
+static void load(void *state)
+{
+	struct loadme *lm = state;
+	printf("loaded at frame %u\n", lm->frames);
+}
+
+static int frame(void *state)
+{
+	struct loadme *lm = state;
+	const struct timespec ts = {0, 16000000};
+
+	if (lm->frames % 60 == 0)
+		printf("%s %u\n", loadme_message(), lm->frames);
+	lm->frames++;
+	nanosleep(&ts, NULL);
+	return 1;
+}
+
+static const struct soloader_module module = {
+	.version = SOLOADER_VERSION,
+	.create = create,
+	.destroy = destroy,
+	.load = load,
+	.frame = frame,
+};
+
+const struct soloader_module *soloader_get_module(void)
+{
+	return &module;
+}
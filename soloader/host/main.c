@@ -0,0 +1,67 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "soloader.h"
+
+// Runs a module the way the Android loader does, without a window. Frames
+// go on until the module's frame() returns 0, and rebuilding the module in
+// the meantime swaps it in.
+int main(int argc, char **argv)
+{
+	struct soloader loader;
+
+	if (argc < 2)
+	{
+		fprintf(stderr, "usage: %s <module.so> [copy dir]\n", argv[0]);
+		return 1;
+	}
+	if (!soloader_open(&loader, argv[1], argc > 2 ? argv[2] : "/tmp"))
+		return 1;
+	if (!loader.module)
+	{
+		fprintf(stderr, "%s has no soloader_get_module\n", argv[1]);
+		return 1;
+	}
+
+	void *state = loader.module->create(NULL);
+	if (loader.module->load)
+		loader.module->load(state);
+
+	while (loader.module->frame(state))
+	{
+		soloader_poll(&loader, state);
+	}
+
+	if (loader.module->unload)
+		loader.module->unload(state);
+	loader.module->destroy(state);
+	soloader_close(&loader);
+	return 0;
+}
@@ -28,7 +28,7 @@ LOCAL_PATH := $(call my-dir)
 include $(CLEAR_VARS)
 
 LOCAL_MODULE    := so-loader
-LOCAL_SRC_FILES := main.c
+LOCAL_SRC_FILES := main.c soloader.c
 LOCAL_LDLIBS    := -llog -landroid
 LOCAL_STATIC_LIBRARIES := android_native_app_glue
 
@@ -31,46 +31,88 @@ For more information, please refer to <http://unlicense.org>
 
 #include <android_native_app_glue.h>
 
+#include "soloader.h"
+
 typedef void (*fptr_t)(struct android_app*);
 
+struct host {
+	struct soloader loader;
+	void *state;
+};
+
+// The glue keeps calling these, they look the module up every time so
+// nothing points into a copy once it is closed
+static void handle_cmd(struct android_app* app, int32_t cmd)
+{
+	struct host *host = app->userData;
+	if (host->loader.module->app_cmd)
+		host->loader.module->app_cmd(host->state, cmd);
+}
+
+static int32_t handle_input(struct android_app* app, AInputEvent* event)
+{
+	struct host *host = app->userData;
+	if (host->loader.module->input)
+		return host->loader.module->input(host->state, event);
+	return 0;
+}
+
 void android_main(struct android_app* state)
 {
 	// Make sure glue isn't stripped.
 	app_dummy();
 
-	const char *path = state->activity->internalDataPath;
-	char dst_path[512];
-	snprintf(dst_path, sizeof(dst_path), "%s/libloadme.so", path);
+	struct host host;
+	if (!soloader_open(&host.loader, "/sdcard/Download/libloadme.so", state->activity->internalDataPath))
+		return;
 
-	FILE *src;
-	src = fopen("/sdcard/Download/libloadme.so", "r");
-	FILE *dst;
-	dst = fopen(dst_path, "w");
-	while (!feof(src))
+	// A module with its own android_main runs it, without reloads
+	if (!host.loader.module)
 	{
-		char byte;
-		fread(&byte, 1, 1, src);
-		fwrite(&byte, 1, 1, dst);
+		fptr_t am = dlsym(host.loader.handle, "android_main");
+		assert(am);
+		am(state);
+		return;
 	}
 
-	fclose(src);
-	fclose(dst);
+	host.state = host.loader.module->create(state);
+	if (host.loader.module->load)
+		host.loader.module->load(host.state);
+	state->userData = &host;
+	state->onAppCmd = handle_cmd;
+	state->onInputEvent = handle_input;
 
-	void *handle = dlopen(dst_path, RTLD_NOW | RTLD_GLOBAL);
-	if (!handle)
+	while (1)
 	{
-		const char *str = dlerror();
-		assert(str);
-		return;
-	}
+		int ident;
+		int events;
+		struct android_poll_source* source;
 
-	fptr_t am = dlsym(handle, "android_main");
-	if (!am)
-	{
-		const char *str = dlerror();
-		assert(str);
-		return;
+		while ((ident=ALooper_pollAll(0, NULL, &events, (void**)&source)) >= 0)
+		{
+			if (source != NULL)
+			{
+				source->process(state, source);
+			}
+
+			if (state->destroyRequested != 0)
+			{
+				break;
+			}
+		}
+
+		if (state->destroyRequested != 0 || !host.loader.module->frame(host.state))
+			break;
+
+		// The instance and device are in the state and stay, only the code
+		// changes between two frames
+		soloader_poll(&host.loader, host.state);
 	}
 
-	am(state);
+	if (host.loader.module->unload)
+		host.loader.module->unload(host.state);
+	host.loader.module->destroy(host.state);
+	state->onAppCmd = NULL;
+	state->onInputEvent = NULL;
+	soloader_close(&host.loader);
 }
@@ -0,0 +1,320 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#include "soloader.h"
+#include <assert.h>
+#include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if __ANDROID__
+
+#include <android/log.h>
+#define  LOG_TAG    "soloader"
+#define  LOGI(...)  __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
+#define  LOGW(...)  __android_log_print(ANDROID_LOG_WARN, LOG_TAG, __VA_ARGS__)
+
+#else
+
+#define  LOGI(...) printf("I:"__VA_ARGS__)
+#define  LOGW(...) printf("W:"__VA_ARGS__)
+
+#endif
+
+#define COPY_CHUNK (64*1024)
+
+// FNV-1a over the contents, 0 when the file can't be read
+static uint64_t hash_file(const char *path)
+{
+	static unsigned char buf[COPY_CHUNK];
+	uint64_t hash = 0xcbf29ce484222325ull;
+	ssize_t n, i;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return 0;
+	while ((n = read(fd, buf, sizeof(buf))) > 0)
+	{
+		for (i = 0; i < n; i++)
+		{
+			hash ^= buf[i];
+			hash *= 0x100000001b3ull;
+		}
+	}
+	close(fd);
+	return n < 0 ? 0 : hash;
+}
+
+static int write_all(int fd, const unsigned char *buf, ssize_t size)
+{
+	ssize_t n;
+
+	while (size > 0)
+	{
+		n = write(fd, buf, size);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return 0;
+		buf += n;
+		size -= n;
+	}
+	return 1;
+}
+
+// In the kernel where it can, sendfile() only writes to files from Linux
+// 2.6.33 on, what it left is copied in large chunks
+static int copy_file(const char *src, const char *dst)
+{
+	static unsigned char buf[COPY_CHUNK];
+	struct stat st;
+	off_t off = 0;
+	ssize_t n;
+	int in, out, ok = 1;
+
+	in = open(src, O_RDONLY);
+	if (in < 0)
+		return 0;
+	if (fstat(in, &st) != 0)
+	{
+		close(in);
+		return 0;
+	}
+	out = open(dst, O_WRONLY | O_CREAT | O_TRUNC, 0700);
+	if (out < 0)
+	{
+		close(in);
+		return 0;
+	}
+
+	while (off < st.st_size && (n = sendfile(out, in, &off, st.st_size - off)) > 0)
+		;
+
+	if (off < st.st_size)
+	{
+		// sendfile() leaves the file offset alone
+		lseek(in, off, SEEK_SET);
+		while (ok && (n = read(in, buf, sizeof(buf))) > 0)
+			ok = write_all(out, buf, n);
+		ok = ok && n == 0;
+	}
+
+	close(in);
+	if (close(out) != 0)
+		ok = 0;
+	return ok;
+}
+
+static void copy_path(const struct soloader *l, uint32_t generation, char *path, size_t size)
+{
+	size_t len = strlen(l->src_name);
+
+	// libloadme.so becomes libloadme.<generation>.so
+	if (len > 3 && strcmp(l->src_name + len - 3, ".so") == 0)
+		len -= 3;
+	snprintf(path, size, "%s/%.*s.%u.so", l->dir, (int)len, l->src_name, generation);
+}
+
+static int open_copy(const char *path, void **handle, const struct soloader_module **module)
+{
+	*module = NULL;
+	// Local, as with the previous copy still loaded globally the new one's
+	// calls to its own exported functions would bind to the old code
+	*handle = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+	if (!*handle)
+	{
+		LOGW("dlopen %s: %s\n", path, dlerror());
+		return 0;
+	}
+
+	soloader_get_module_t get_module = (soloader_get_module_t)dlsym(*handle, "soloader_get_module");
+	if (get_module)
+	{
+		*module = get_module();
+		if (!*module || (*module)->version != SOLOADER_VERSION)
+		{
+			LOGW("%s: module version %u, expected %u\n", path, *module ? (*module)->version : 0, SOLOADER_VERSION);
+			dlclose(*handle);
+			return 0;
+		}
+	}
+	else if (!dlsym(*handle, "android_main"))
+	{
+		LOGW("%s: neither soloader_get_module nor android_main\n", path);
+		dlclose(*handle);
+		return 0;
+	}
+	return 1;
+}
+
+int soloader_open(struct soloader *l, const char *src_path, const char *dir)
+{
+	const char *slash;
+
+	memset(l, 0, sizeof(*l));
+	l->inotify_fd = -1;
+	snprintf(l->src_path, sizeof(l->src_path), "%s", src_path);
+	snprintf(l->dir, sizeof(l->dir), "%s", dir);
+	slash = strrchr(src_path, '/');
+	snprintf(l->src_name, sizeof(l->src_name), "%s", slash ? slash + 1 : src_path);
+
+	l->hash = hash_file(l->src_path);
+	if (!l->hash)
+	{
+		LOGW("Can't read %s\n", l->src_path);
+		return 0;
+	}
+
+	// Most launches load what the last one left, reading it back is cheaper
+	// than writing it again
+	copy_path(l, 0, l->path, sizeof(l->path));
+	if (hash_file(l->path) != l->hash)
+	{
+		if (!copy_file(l->src_path, l->path))
+		{
+			LOGW("Can't copy %s to %s\n", l->src_path, l->path);
+			return 0;
+		}
+		LOGI("Copied %s to %s\n", l->src_path, l->path);
+	}
+	if (!open_copy(l->path, &l->handle, &l->module))
+		return 0;
+
+	// Only a module the loader drives can be swapped between frames
+	if (l->module)
+	{
+		char src_dir[512];
+		snprintf(src_dir, sizeof(src_dir), "%.*s", slash ? (int)(slash - src_path) : 1, slash ? src_path : ".");
+
+		l->inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		if (l->inotify_fd < 0 || inotify_add_watch(l->inotify_fd, src_dir, IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+		{
+			LOGW("Can't watch %s, no reloads: %s\n", src_dir, strerror(errno));
+			if (l->inotify_fd >= 0)
+				close(l->inotify_fd);
+			l->inotify_fd = -1;
+		}
+	}
+	return 1;
+}
+
+// Whether any of the pending events is about the source
+static int source_written(struct soloader *l)
+{
+	char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+	const struct inotify_event *ev;
+	ssize_t n, i;
+	int written = 0;
+
+	while ((n = read(l->inotify_fd, buf, sizeof(buf))) > 0)
+	{
+		for (i = 0; i < n; i += sizeof(*ev) + ev->len)
+		{
+			ev = (const struct inotify_event *)(buf + i);
+			if (ev->len && strcmp(ev->name, l->src_name) == 0)
+				written = 1;
+		}
+	}
+	return written;
+}
+
+int soloader_poll(struct soloader *l, void *state)
+{
+	char path[sizeof(l->path)];
+	const struct soloader_module *module;
+	void *handle;
+	uint64_t hash;
+
+	if (l->inotify_fd < 0 || !source_written(l))
+		return 0;
+
+	// Writes that didn't change anything, e.g. the same build pushed again
+	hash = hash_file(l->src_path);
+	if (!hash || hash == l->hash)
+		return 0;
+
+	copy_path(l, l->generation + 1, path, sizeof(path));
+	if (!copy_file(l->src_path, path))
+	{
+		LOGW("Can't copy %s to %s\n", l->src_path, path);
+		return 0;
+	}
+	// The old copy keeps running when the new one is broken
+	if (!open_copy(path, &handle, &module))
+	{
+		unlink(path);
+		return 0;
+	}
+	if (!module)
+	{
+		LOGW("%s: only exports android_main, can't be swapped in\n", path);
+		dlclose(handle);
+		unlink(path);
+		return 0;
+	}
+
+	if (l->module->unload)
+		l->module->unload(state);
+	if (module->load)
+		module->load(state);
+	dlclose(l->handle);
+	unlink(l->path);
+
+	l->handle = handle;
+	l->module = module;
+	l->hash = hash;
+	l->generation++;
+	snprintf(l->path, sizeof(l->path), "%s", path);
+	LOGI("Reloaded %s as %s\n", l->src_path, l->path);
+	return 1;
+}
+
+void soloader_close(struct soloader *l)
+{
+	char path[sizeof(l->path)];
+
+	if (l->inotify_fd >= 0)
+		close(l->inotify_fd);
+	if (l->handle)
+		dlclose(l->handle);
+
+	// Leaves the latest copy where the next launch looks for it
+	if (l->generation != 0)
+	{
+		copy_path(l, 0, path, sizeof(path));
+		rename(l->path, path);
+	}
+	memset(l, 0, sizeof(*l));
+	l->inotify_fd = -1;
+}
@@ -0,0 +1,93 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org>
+*/
+
+#ifndef SOLOADER_H
+#define SOLOADER_H
+
+#include <stdint.h>
+
+#define SOLOADER_VERSION 1
+
+// What a reloadable module hands the loader, returned by the exported
+// soloader_get_module(). A module exporting android_main instead is started
+// the old way, once and without reloads.
+//
+// The state returned by create() outlives every copy of the module, so the
+// Vulkan instance, device and everything else in it survive a reload. The
+// module's own globals start over with each copy, e.g. vulkan_dlfcn_init()
+// runs again in load().
+struct soloader_module {
+	uint32_t version;
+
+	// Once per process, app is the android_app on Android and NULL on the host
+	void *(*create)(void *app);
+	void (*destroy)(void *state);
+
+	// Around a swap, the old copy's unload() runs before the new copy's
+	// load(). Anything that runs module code on its own, e.g. threads, is
+	// stopped in unload() and started again in load(). load() also runs
+	// right after create(), and unload() right before destroy().
+	void (*unload)(void *state);
+	void (*load)(void *state);
+
+	// One frame between events, 0 ends the app
+	int (*frame)(void *state);
+
+	// APP_CMD_* and input events on Android, may be NULL
+	void (*app_cmd)(void *state, int32_t cmd);
+	int32_t (*input)(void *state, void *event);
+};
+
+typedef const struct soloader_module *(*soloader_get_module_t)(void);
+
+struct soloader {
+	char src_path[512];
+	char src_name[256];
+	char dir[512];
+
+	// Copy that is loaded, numbered by generation as a copy can't be opened
+	// again under the same path
+	char path[600];
+	uint32_t generation;
+	uint64_t hash;
+	void *handle;
+	// NULL for a module that only exports android_main
+	const struct soloader_module *module;
+
+	// Close writes and renames into the source's directory, -1 without
+	int inotify_fd;
+};
+
+// Copies src_path into dir, where the loader may create files, unless the
+// copy there has the same contents, and opens it. Returns 0 on failure.
+int soloader_open(struct soloader *l, const char *src_path, const char *dir);
+// Between frames, swaps in a new copy when the source has new contents.
+// Returns 1 when it did, the old copy stays on any failure.
+int soloader_poll(struct soloader *l, void *state);
+void soloader_close(struct soloader *l);
+
+#endif
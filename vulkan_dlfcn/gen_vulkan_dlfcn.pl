@@ -29,14 +29,61 @@
 use strict;
 use warnings;
 
+# With no argument every function is listed, for vulkan_dlfcn.def. With
+# 'instance' or 'device' only the functions that dispatch on that level are
+# listed, going by the type of the first parameter, for the dispatch tables in
+# vulkan_dlfcn_instance.def and vulkan_dlfcn_device.def. With 'proto' every
+# function is listed with its return type, parameters and arguments, for the
+# VULKAN_DLFCN_LAZY thunks in vulkan_dlfcn_proto.def.
+my $table = shift // 'all';
+my %levels = (
+	'instance' => qr/^(VkInstance|VkPhysicalDevice)$/,
+	'device' => qr/^(VkDevice|VkQueue|VkCommandBuffer)$/,
+);
+die "Unknown table '$table'" unless $table eq 'all' or $table eq 'proto' or exists $levels{$table};
+
 my $filename = '/usr/include/vulkan/vulkan.h';
 open(my $fh, '<:encoding(UTF-8)', $filename)
 	or die "Could not open file '$filename' $!";
 
+my $name;
+my $ret;
+my @params;
 while (my $row = <$fh>) {
 	chomp $row;
-	if ($row =~ /PFN_([a-zA-Z0-9]+)/) {
-		print "DEF_VK_FCN($1)\n";
+	if ($table eq 'proto') {
+		if ($row =~ /^VKAPI_ATTR (.+) VKAPI_CALL (vk[a-zA-Z0-9]+)\($/) {
+			($ret, $name, @params) = ($1, $2);
+		} elsif (defined $name) {
+			my $done = $row =~ s/\);$//;
+			$row =~ s/^\s+|,?\s*$//g;
+			$row =~ s/\s+/ /g;
+			push @params, $row;
+			if ($done) {
+				my $args = join(', ', map { /([a-zA-Z0-9]+)(\[\d+\])?$/; $1 } @params);
+				my $list = join(', ', @params);
+				if ($ret eq 'void') {
+					print "DEF_VK_PROTO_VOID($name, ($list), ($args))\n";
+				} else {
+					print "DEF_VK_PROTO($ret, $name, ($list), ($args))\n";
+				}
+				undef $name;
+			}
+		}
+	} elsif ($table eq 'all') {
+		if ($row =~ /PFN_([a-zA-Z0-9]+)/) {
+			print "DEF_VK_FCN($1)\n";
+		}
+	} elsif ($row =~ /VKAPI_CALL (vk[a-zA-Z0-9]+)\($/) {
+		$name = $1;
+	} elsif (defined $name) {
+		# vkGetDeviceProcAddr is what fills the device table so it goes in the
+		# instance one, vkGetInstanceProcAddr stays a global
+		if ($name eq 'vkGetDeviceProcAddr') {
+			print "DEF_VK_FCN($name)\n" if $table eq 'instance';
+		} elsif ($row =~ /^\s*(?:const\s+)?([a-zA-Z0-9]+)/ and $1 =~ $levels{$table}) {
+			print "DEF_VK_FCN($name)\n";
+		}
+		undef $name;
 	}
 }
-
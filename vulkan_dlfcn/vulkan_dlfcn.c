@@ -27,6 +27,7 @@ For more information, please refer to <http://unlicense.org>
 
 #include "vulkan_dlfcn.h"
 #include <dlfcn.h>
+#include <stdlib.h>
 
 #if __ANDROID__
 
@@ -47,24 +48,83 @@ For more information, please refer to <http://unlicense.org>
 
 static void *vulkan_so = NULL;
 
+#ifdef VULKAN_DLFCN_LAZY
+
+// Every pointer starts out at a thunk that looks the symbol up on its first
+// call, replaces itself with what it found and forwards the call. Only the
+// functions that are actually called get resolved, and since the pointers
+// are never NULL a missing symbol is fatal on the first call instead.
+static void *resolve(const char *name)
+{
+	void *sym = dlsym(vulkan_so, name);
+	if (!sym)
+	{
+		LOGE("Vulkan symbol '%s' is not available: %s\n", name, dlerror());
+		abort();
+	}
+	return sym;
+}
+
+// Racing threads resolve the same symbol and store the same value
+#define DEF_VK_PROTO(ret, x, params, args) \
+	static VKAPI_ATTR ret VKAPI_CALL x##_thunk params { \
+		PFN_##x fn = (PFN_##x)resolve(#x); \
+		__atomic_store_n(&x, fn, __ATOMIC_RELEASE); \
+		return fn args; \
+	}
+#define DEF_VK_PROTO_VOID(x, params, args) \
+	static VKAPI_ATTR void VKAPI_CALL x##_thunk params { \
+		PFN_##x fn = (PFN_##x)resolve(#x); \
+		__atomic_store_n(&x, fn, __ATOMIC_RELEASE); \
+		fn args; \
+	}
+#include "vulkan_dlfcn_proto.def"
+#undef DEF_VK_PROTO
+#undef DEF_VK_PROTO_VOID
+
+#define DEF_VK_FCN(x) PFN_##x x = x##_thunk;
+#include "vulkan_dlfcn.def"
+#undef DEF_VK_FCN
+
+#else
+
 #define DEF_VK_FCN(x) PFN_##x x = NULL;
 #include "vulkan_dlfcn.def"
 #undef DEF_VK_FCN
 
+#endif
 
 void vulkan_dlfcn_init(void)
 {
 	vulkan_so = dlopen("libvulkan.so", RTLD_NOW | RTLD_GLOBAL);
+	// Machines without the development package only have the versioned name
+	if (!vulkan_so)
+		vulkan_so = dlopen("libvulkan.so.1", RTLD_NOW | RTLD_GLOBAL);
 	if (!vulkan_so)
 	{
 		LOGE("Vulkan not available: %s\n", dlerror());
 	}
 
+#ifndef VULKAN_DLFCN_LAZY
 #define DEF_VK_FCN(x) \
 	if (!(x = (PFN_##x)dlsym(vulkan_so, #x))) { \
 		LOGE("Vulkan symbol '%s' is not available: %s\n", #x, dlerror()); \
 	}
 #include "vulkan_dlfcn.def"
 #undef DEF_VK_FCN
+#endif
+}
+
+void vulkan_dlfcn_instance_init(struct vulkan_dlfcn_instance *vki, VkInstance instance)
+{
+#define DEF_VK_FCN(x) vki->x = (PFN_##x)vkGetInstanceProcAddr(instance, #x);
+#include "vulkan_dlfcn_instance.def"
+#undef DEF_VK_FCN
 }
 
+void vulkan_dlfcn_device_init(struct vulkan_dlfcn_device *vkd, const struct vulkan_dlfcn_instance *vki, VkDevice device)
+{
+#define DEF_VK_FCN(x) vkd->x = (PFN_##x)vki->vkGetDeviceProcAddr(device, #x);
+#include "vulkan_dlfcn_device.def"
+#undef DEF_VK_FCN
+}
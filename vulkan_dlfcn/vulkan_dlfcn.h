@@ -31,15 +31,39 @@ For more information, please refer to <http://unlicense.org>
 #define VK_NO_PROTOTYPES
 #if __ANDROID__
 #define VK_USE_PLATFORM_ANDROID_KHR
-#else
+#elif !defined(VULKAN_DLFCN_HEADLESS)
 #define VK_USE_PLATFORM_XCB_KHR
 #endif
 #include <vulkan/vulkan.h>
 
-#define DEF_VK_FCN(x) extern PFN_##x x;
+// Hidden, as once libvulkan.so is loaded globally, e.g. by the previous copy
+// of a reloaded module, an exported pointer would bind to the function of
+// the same name in there instead of to the variable here
+#define DEF_VK_FCN(x) extern __attribute__((visibility("hidden"))) PFN_##x x;
 #include "vulkan_dlfcn.def"
 #undef DEF_VK_FCN
 
+// Dispatch tables filled through vkGetInstanceProcAddr and vkGetDeviceProcAddr.
+// Calling through them skips the loader trampolines behind the globals above,
+// and every instance and device gets a table of its own. Functions from
+// extensions that were not enabled are left NULL.
+struct vulkan_dlfcn_instance {
+#define DEF_VK_FCN(x) PFN_##x x;
+#include "vulkan_dlfcn_instance.def"
+#undef DEF_VK_FCN
+};
+
+struct vulkan_dlfcn_device {
+#define DEF_VK_FCN(x) PFN_##x x;
+#include "vulkan_dlfcn_device.def"
+#undef DEF_VK_FCN
+};
+
+// Loads libvulkan.so and looks up every global above, or with
+// VULKAN_DLFCN_LAZY defined only loads it and leaves each lookup to the
+// first call of that function
 void vulkan_dlfcn_init(void);
+void vulkan_dlfcn_instance_init(struct vulkan_dlfcn_instance *vki, VkInstance instance);
+void vulkan_dlfcn_device_init(struct vulkan_dlfcn_device *vkd, const struct vulkan_dlfcn_instance *vki, VkDevice device);
 
 #endif